@@ -0,0 +1,163 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Memory arenas for the bulk allocation of many small objects
+ */
+
+#ifndef SHARK_ARENA_H_
+#define SHARK_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace shark {
+
+/**
+ * A bump-pointer memory arena.
+ *
+ * Memory is handed out sequentially from large chunks, so objects allocated
+ * one after the other are contiguous in memory. Individual allocations are
+ * never released; instead, all memory is released at once when the arena is
+ * destroyed.
+ *
+ * Arenas are not thread-safe. Code allocating from several threads should use
+ * a separate arena on each of them.
+ */
+class Arena {
+
+public:
+
+	/// The default size of the chunks memory is handed out from
+	static constexpr std::size_t DEFAULT_CHUNK_SIZE = 4 * 1024 * 1024;
+
+	/**
+	 * Creates a new, empty arena.
+	 *
+	 * @param chunk_size The size of the chunks memory is handed out from
+	 */
+	explicit Arena(std::size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+	// Memory handed out by an arena belongs to it
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	/**
+	 * Allocates @p size bytes aligned to @p alignment. Sizes larger than the
+	 * chunk size are satisfied with a chunk of their own.
+	 *
+	 * @param size The number of bytes to allocate
+	 * @param alignment The alignment of the allocated memory
+	 * @return A pointer to the allocated memory
+	 */
+	void *allocate(std::size_t size, std::size_t alignment);
+
+	/// @return The total amount of memory held by this arena
+	std::size_t capacity() const
+	{
+		return total_capacity;
+	}
+
+private:
+	std::size_t chunk_size;
+	std::vector<std::unique_ptr<char[]>> chunks;
+	char *current;
+	std::size_t remaining;
+	std::size_t total_capacity;
+
+	char *new_chunk(std::size_t size);
+};
+
+/// A shared pointer to an Arena
+using ArenaPtr = std::shared_ptr<Arena>;
+
+/**
+ * A C++11 allocator that hands out memory from an Arena, and never releases
+ * it. Each copy of the allocator keeps the arena alive; in particular, objects
+ * created with std::allocate_shared keep a copy of it next to their reference
+ * counts. The arena is therefore released in bulk after the last of its
+ * objects is destroyed, and never before.
+ */
+template <typename T>
+class arena_allocator {
+
+public:
+
+	using value_type = T;
+
+	explicit arena_allocator(ArenaPtr arena) :
+		arena(std::move(arena))
+	{
+	}
+
+	template <typename U>
+	arena_allocator(const arena_allocator<U> &other) :
+		arena(other.arena)
+	{
+	}
+
+	T *allocate(std::size_t n)
+	{
+		return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T *, std::size_t)
+	{
+		// memory is released together with the arena
+	}
+
+	ArenaPtr arena;
+};
+
+template <typename T, typename U>
+bool operator==(const arena_allocator<T> &lhs, const arena_allocator<U> &rhs)
+{
+	return lhs.arena == rhs.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const arena_allocator<T> &lhs, const arena_allocator<U> &rhs)
+{
+	return !(lhs == rhs);
+}
+
+/**
+ * Like std::make_shared, but allocating the new object (and its reference
+ * counts) from @p arena. If @p arena is empty std::make_shared is used.
+ *
+ * @param arena The arena to allocate the object from
+ * @param args The arguments to construct the object with
+ * @return A shared pointer to the new object
+ */
+template <typename T, typename ... Args>
+std::shared_ptr<T> make_arena_shared(const ArenaPtr &arena, Args && ... args)
+{
+	if (!arena) {
+		return std::make_shared<T>(std::forward<Args>(args)...);
+	}
+	return std::allocate_shared<T>(arena_allocator<T>(arena), std::forward<Args>(args)...);
+}
+
+}  // namespace shark
+
+#endif // SHARK_ARENA_H_
@@ -0,0 +1,181 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Simple binary serialisation buffers, and atomic writing of binary files
+ */
+
+#ifndef SHARK_BINARY_BUFFER_H_
+#define SHARK_BINARY_BUFFER_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "exceptions.h"
+#include "mixins.h"
+
+namespace shark {
+
+/// Appends values in their native binary representation to a buffer
+class buffer_writer {
+
+public:
+
+	template <typename T>
+	void write(const T &value)
+	{
+		static_assert(std::is_arithmetic<T>::value, "only arithmetic types can be written");
+		auto bytes = reinterpret_cast<const char *>(&value);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+	}
+
+	void write(const xyz<float> &value)
+	{
+		write(value.x);
+		write(value.y);
+		write(value.z);
+	}
+
+	void write(const std::string &value)
+	{
+		write(std::uint64_t(value.size()));
+		buffer.insert(buffer.end(), value.begin(), value.end());
+	}
+
+	template <typename T>
+	void write(const std::vector<T> &values)
+	{
+		write(std::uint64_t(values.size()));
+		for (auto &value: values) {
+			write(value);
+		}
+	}
+
+	const std::vector<char> &data() const
+	{
+		return buffer;
+	}
+
+private:
+	std::vector<char> buffer;
+};
+
+/// Reads back the values written by a buffer_writer
+class buffer_reader {
+
+public:
+
+	explicit buffer_reader(std::vector<char> buffer) :
+		buffer(std::move(buffer)), position(0)
+	{
+	}
+
+	template <typename T>
+	T read()
+	{
+		static_assert(std::is_arithmetic<T>::value, "only arithmetic types can be read");
+		T value;
+		std::memcpy(&value, advance(sizeof(T)), sizeof(T));
+		return value;
+	}
+
+	void read(xyz<float> &value)
+	{
+		value.x = read<float>();
+		value.y = read<float>();
+		value.z = read<float>();
+	}
+
+	template <typename T>
+	void read(std::vector<T> &values)
+	{
+		values.resize(read<std::uint64_t>());
+		for (auto &value: values) {
+			value = read<T>();
+		}
+	}
+
+	std::string read_string()
+	{
+		auto size = read<std::uint64_t>();
+		auto start = advance(size);
+		return std::string(start, start + size);
+	}
+
+	bool finished() const
+	{
+		return position == buffer.size();
+	}
+
+private:
+	std::vector<char> buffer;
+	std::size_t position;
+
+	const char *advance(std::size_t n)
+	{
+		if (n > buffer.size() - position) {
+			throw invalid_data("binary data is truncated");
+		}
+		auto start = buffer.data() + position;
+		position += n;
+		return start;
+	}
+};
+
+/// 64-bit FNV-1a, which unlike std::hash is stable across implementations
+inline
+std::uint64_t fnv1a(const std::string &s)
+{
+	std::uint64_t hash = 0xcbf29ce484222325;
+	for (unsigned char c: s) {
+		hash ^= c;
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+/**
+ * Reads the whole contents of a binary file.
+ *
+ * @param filename The name of the file
+ * @param contents Where the contents of the file are stored
+ * @return Whether the file could be opened
+ */
+bool read_binary_file(const std::string &filename, std::vector<char> &contents);
+
+/**
+ * Writes @p data into @p filename. Data is written under a temporary name
+ * first and then moved into place, so readers never see a partially written
+ * file.
+ *
+ * @param filename The name of the file
+ * @param data The data to write
+ * @return Whether the file could be written
+ */
+bool write_binary_file(const std::string &filename, const std::vector<char> &data);
+
+}  // namespace shark
+
+#endif // SHARK_BINARY_BUFFER_H_
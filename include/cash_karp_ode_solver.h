@@ -0,0 +1,536 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Header-only, fixed-size Cash-Karp ODE solvers
+ */
+
+#ifndef SHARK_CASH_KARP_ODE_SOLVER_H_
+#define SHARK_CASH_KARP_ODE_SOLVER_H_
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+#include "exceptions.h"
+#include "logging.h"
+
+namespace shark {
+
+namespace detail {
+
+/// Coefficients of the Cash-Karp method, as in Numerical Recipes
+struct cash_karp_tableau {
+	static constexpr double a2 = 1.0 / 5.0;
+	static constexpr double a3 = 0.3;
+	static constexpr double a4 = 3.0 / 5.0;
+	static constexpr double a5 = 1.0;
+	static constexpr double a6 = 7.0 / 8.0;
+	static constexpr double b21 = 1.0 / 5.0;
+	static constexpr double b31 = 3.0 / 40.0;
+	static constexpr double b32 = 9.0 / 40.0;
+	static constexpr double b41 = 0.3;
+	static constexpr double b42 = -0.9;
+	static constexpr double b43 = 1.2;
+	static constexpr double b51 = -11.0 / 54.0;
+	static constexpr double b52 = 2.5;
+	static constexpr double b53 = -70.0 / 27.0;
+	static constexpr double b54 = 35.0 / 27.0;
+	static constexpr double b61 = 1631.0 / 55296.0;
+	static constexpr double b62 = 175.0 / 512.0;
+	static constexpr double b63 = 575.0 / 13824.0;
+	static constexpr double b64 = 44275.0 / 110592.0;
+	static constexpr double b65 = 253.0 / 4096.0;
+	static constexpr double c1 = 37.0 / 378.0;
+	static constexpr double c3 = 250.0 / 621.0;
+	static constexpr double c4 = 125.0 / 594.0;
+	static constexpr double c6 = 512.0 / 1771.0;
+	static constexpr double ec1 = 37.0 / 378.0 - 2825.0 / 27648.0;
+	static constexpr double ec3 = 250.0 / 621.0 - 18575.0 / 48384.0;
+	static constexpr double ec4 = 125.0 / 594.0 - 13525.0 / 55296.0;
+	static constexpr double ec5 = -277.0 / 14336.0;
+	static constexpr double ec6 = 512.0 / 1771.0 - 1.0 / 4.0;
+
+	static constexpr double safety = 0.9;
+	static constexpr double order = 5;
+
+	/// The factor by which to decrease a step size that gave an error ratio of @p rmax > 1.1
+	static double decrease_factor(double rmax)
+	{
+		double r = safety / std::pow(rmax, 1. / order);
+		return r > 0.2 ? r : 0.2;
+	}
+
+	/// The factor by which to increase a step size that gave an error ratio of @p rmax < 0.5
+	static double increase_factor(double rmax)
+	{
+		double r = safety / std::pow(rmax, 1. / (order + 1));
+		return std::min(5., std::max(1., r));
+	}
+};
+
+/// Logged when the step size cannot be decreased any further
+constexpr const char *STEP_TOO_SMALL_WARNING = "ODE: step size decreases below machine precision. Integration stops before the end of the time step, with the desired accuracy not reached.";
+
+}  // namespace detail
+
+/**
+ * An adaptive, embedded Runge-Kutta Cash-Karp (4, 5) ODE solver for systems
+ * whose dimension is known at compile time.
+ *
+ * This solver follows the same algorithm used by GSL's odeiv2 driver when
+ * using the ``gsl_odeiv2_step_rkck`` stepper together with a standard
+ * ``y``-based relative error control (i.e., what ODESolver does), so both
+ * should produce results that are equal up to rounding differences.
+ * In particular, if a step's error is still too big once its size cannot be
+ * decreased any further (i.e., decreasing it would not change ``t``), the
+ * integration stops there with a warning, leaving the values of the last
+ * accepted step in ``y``, exactly like ODESolver does.
+ * Contrary to ODESolver though, the state lives in a ``std::array``, no memory
+ * is allocated on the heap, and the evaluator is a template parameter,
+ * allowing the compiler to inline it into the stages of the integration.
+ *
+ * @tparam N The dimension of the ODE system
+ * @tparam Evaluator A callable with signature
+ *  ``int(double t, const std::array<double, N> &y, std::array<double, N> &f)``
+ *  that evaluates the derivatives @p f of the system at @p t and @p y, and
+ *  returns 0 on success.
+ */
+template <std::size_t N, typename Evaluator>
+class CashKarpODESolver {
+
+public:
+
+	using state_type = std::array<double, N>;
+
+	/**
+	 * Creates a new CashKarpODESolver
+	 *
+	 * @param evaluator The function that evaluates the ODE system
+	 * @param precision The relative precision to use for the adaptive step sizes.
+	 */
+	CashKarpODESolver(Evaluator evaluator, double precision) :
+		evaluator(std::move(evaluator)),
+		precision(precision),
+		steps(0),
+		rejected_steps(0)
+	{
+	}
+
+	/**
+	 * Evolves the ODE system from 0 to ``delta_t``
+	 *
+	 * @param y The values of the system at ``t = 0``. After returning the array
+	 *  contains the values at ``delta_t``.
+	 * @param delta_t The amount of time the system is evolved for
+	 */
+	void evolve(state_type &y, double delta_t)
+	{
+		double t = 0;
+		const double t1 = delta_t;
+		double h = delta_t;
+		steps = 0;
+		rejected_steps = 0;
+
+		state_type k1, yerr, ynew;
+		while (t1 - t > 0) {
+
+			evaluate(t, y, k1);
+
+			double tnew, hnext;
+			while (true) {
+
+				bool final_step = (h > t1 - t);
+				if (final_step) {
+					h = t1 - t;
+				}
+
+				step(t, h, y, k1, ynew, yerr);
+				tnew = final_step ? t1 : t + h;
+
+				// Standard control: all error is relative to the new values of y
+				double rmax = DBL_MIN;
+				for (std::size_t i = 0; i != N; i++) {
+					double r = std::abs(yerr[i]) / std::abs(precision * std::abs(ynew[i]));
+					rmax = (r > rmax) ? r : rmax;
+				}
+
+				if (rmax > 1.1) {
+					// Error is too big, try again with a smaller step size unless
+					// we are already at machine precision. As in GSL, this is
+					// checked against the time the step would have reached
+					double hnew = detail::cash_karp_tableau::decrease_factor(rmax) * h;
+					if (hnew < h && tnew + hnew != tnew) {
+						h = hnew;
+						rejected_steps++;
+						continue;
+					}
+					// Like GSL, give up and keep the values of the last accepted step
+					LOG(warning) << detail::STEP_TOO_SMALL_WARNING;
+					return;
+				}
+
+				hnext = h;
+				if (rmax < 0.5) {
+					hnext = h * detail::cash_karp_tableau::increase_factor(rmax);
+				}
+				break;
+			}
+
+			t = tnew;
+			h = hnext;
+			y = ynew;
+			steps++;
+		}
+	}
+
+	/**
+	 * Returns the number of steps taken by the last call to evolve.
+	 *
+	 * @return The number of steps taken to evolve the ODE system.
+	 */
+	std::size_t num_evaluations() const
+	{
+		return steps;
+	}
+
+	/**
+	 * Returns the number of steps rejected by the last call to evolve
+	 * because their error was too big.
+	 *
+	 * @return The number of rejected steps.
+	 */
+	std::size_t num_rejected_steps() const
+	{
+		return rejected_steps;
+	}
+
+private:
+	Evaluator evaluator;
+	double precision;
+	std::size_t steps;
+	std::size_t rejected_steps;
+
+	void evaluate(double t, const state_type &y, state_type &f)
+	{
+		if (evaluator(t, y, f) != 0) {
+			throw math_error("Error while solving ODE system: user function signaled an error");
+		}
+	}
+
+	/// Single Cash-Karp step of size @p h
+	void step(double t, double h, const state_type &y, const state_type &k1, state_type &ynew, state_type &yerr)
+	{
+		using ck = detail::cash_karp_tableau;
+		state_type ytmp, k2, k3, k4, k5, k6;
+
+		for (std::size_t i = 0; i != N; i++) {
+			ytmp[i] = y[i] + ck::b21 * h * k1[i];
+		}
+		evaluate(t + ck::a2 * h, ytmp, k2);
+
+		for (std::size_t i = 0; i != N; i++) {
+			ytmp[i] = y[i] + h * (ck::b31 * k1[i] + ck::b32 * k2[i]);
+		}
+		evaluate(t + ck::a3 * h, ytmp, k3);
+
+		for (std::size_t i = 0; i != N; i++) {
+			ytmp[i] = y[i] + h * (ck::b41 * k1[i] + ck::b42 * k2[i] + ck::b43 * k3[i]);
+		}
+		evaluate(t + ck::a4 * h, ytmp, k4);
+
+		for (std::size_t i = 0; i != N; i++) {
+			ytmp[i] = y[i] + h * (ck::b51 * k1[i] + ck::b52 * k2[i] + ck::b53 * k3[i] + ck::b54 * k4[i]);
+		}
+		evaluate(t + ck::a5 * h, ytmp, k5);
+
+		for (std::size_t i = 0; i != N; i++) {
+			ytmp[i] = y[i] + h * (ck::b61 * k1[i] + ck::b62 * k2[i] + ck::b63 * k3[i] + ck::b64 * k4[i] + ck::b65 * k5[i]);
+		}
+		evaluate(t + ck::a6 * h, ytmp, k6);
+
+		for (std::size_t i = 0; i != N; i++) {
+			ynew[i] = y[i] + h * (ck::c1 * k1[i] + ck::c3 * k3[i] + ck::c4 * k4[i] + ck::c6 * k6[i]);
+			yerr[i] = h * (ck::ec1 * k1[i] + ck::ec3 * k3[i] + ck::ec4 * k4[i] + ck::ec5 * k5[i] + ck::ec6 * k6[i]);
+		}
+	}
+
+};
+
+/**
+ * Convenience function to create a CashKarpODESolver deducing the evaluator type
+ */
+template <std::size_t N, typename Evaluator>
+CashKarpODESolver<N, Evaluator> make_cash_karp_ode_solver(Evaluator evaluator, double precision)
+{
+	return CashKarpODESolver<N, Evaluator>(std::move(evaluator), precision);
+}
+
+/**
+ * A version of CashKarpODESolver that integrates up to @p W independent ODE
+ * systems of dimension @p N in lockstep.
+ *
+ * The systems' values are stored as structure-of-arrays, with one array of
+ * @p W lanes per component of the system. Each lane has its own time, step size
+ * and error control, and lanes that have reached the end of the integration, or
+ * whose last step was rejected, are masked out until all lanes are finished.
+ * The arithmetic of each Runge-Kutta stage is therefore performed across all
+ * lanes at once and can be vectorised by the compiler, and the evaluator is
+ * called once per stage for all lanes, so it can vectorise the ODE systems
+ * themselves too. Each lane goes through exactly the same sequence of steps
+ * that CashKarpODESolver would follow for the same system, and lanes whose
+ * step size cannot be decreased any further stop early in the same way.
+ *
+ * @tparam N The dimension of the ODE systems
+ * @tparam W The maximum number of systems integrated together
+ * @tparam Evaluator A callable with signature
+ *  ``int(const std::array<bool, W> &active, std::size_t n_lanes, const std::array<double, W> &t,
+ *  const std::array<std::array<double, W>, N> &y, std::array<std::array<double, W>, N> &f)``
+ *  that evaluates the derivatives @p f of the systems in the first @p n_lanes
+ *  lanes at their own @p t and @p y, and returns 0 on success. Only lanes set in
+ *  @p active need to be evaluated, the values of @p f in the rest are ignored.
+ */
+template <std::size_t N, std::size_t W, typename Evaluator>
+class BatchedCashKarpODESolver {
+
+public:
+
+	using lanes_type = std::array<double, W>;
+	using batch_type = std::array<lanes_type, N>;
+
+	/**
+	 * Creates a new BatchedCashKarpODESolver
+	 *
+	 * @param evaluator The function that evaluates the ODE systems
+	 * @param precision The relative precision to use for the adaptive step sizes.
+	 */
+	BatchedCashKarpODESolver(Evaluator evaluator, double precision) :
+		evaluator(std::move(evaluator)),
+		precision(precision),
+		steps(),
+		rejected_steps()
+	{
+	}
+
+	/**
+	 * Evolves the ODE systems in the first @p n_lanes lanes of @p y from 0 to ``delta_t``
+	 *
+	 * @param y The values of the systems at ``t = 0``, indexed by ``[component][lane]``.
+	 *  After returning the first @p n_lanes lanes contain the values at ``delta_t``.
+	 * @param n_lanes The number of lanes of @p y that are in use, at most @p W
+	 * @param delta_t The amount of time the systems are evolved for
+	 */
+	void evolve(batch_type &y, std::size_t n_lanes, double delta_t)
+	{
+		const double t1 = delta_t;
+		lanes_type t {}, h {}, hnext {};
+		std::array<bool, W> active {}, needs_k1 {}, final_step {};
+		for (std::size_t l = 0; l != n_lanes; l++) {
+			h[l] = delta_t;
+			active[l] = needs_k1[l] = (t1 - t[l] > 0);
+		}
+		steps.fill(0);
+		rejected_steps.fill(0);
+
+		batch_type k1 {}, yerr {}, ynew {};
+		while (std::find(active.begin(), active.end(), true) != active.end()) {
+
+			// Lanes whose last step was rejected reuse their derivatives
+			std::array<bool, W> k1_lanes {};
+			for (std::size_t l = 0; l != n_lanes; l++) {
+				k1_lanes[l] = active[l] && needs_k1[l];
+			}
+			if (std::find(k1_lanes.begin(), k1_lanes.end(), true) != k1_lanes.end()) {
+				evaluate(k1_lanes, n_lanes, t, y, k1);
+			}
+
+			for (std::size_t l = 0; l != n_lanes; l++) {
+				final_step[l] = (h[l] > t1 - t[l]);
+				if (active[l] && final_step[l]) {
+					h[l] = t1 - t[l];
+				}
+			}
+
+			step(active, n_lanes, t, h, y, k1, ynew, yerr);
+
+			for (std::size_t l = 0; l != n_lanes; l++) {
+				if (!active[l]) {
+					continue;
+				}
+
+				// Standard control: all error is relative to the new values of y
+				double rmax = DBL_MIN;
+				for (std::size_t i = 0; i != N; i++) {
+					double r = std::abs(yerr[i][l]) / std::abs(precision * std::abs(ynew[i][l]));
+					rmax = (r > rmax) ? r : rmax;
+				}
+
+				double tnew = final_step[l] ? t1 : t[l] + h[l];
+				if (rmax > 1.1) {
+					// Error is too big, try again with a smaller step size
+					// unless we are already at machine precision
+					double hnew = detail::cash_karp_tableau::decrease_factor(rmax) * h[l];
+					if (hnew < h[l] && tnew + hnew != tnew) {
+						h[l] = hnew;
+						needs_k1[l] = false;
+						rejected_steps[l]++;
+						continue;
+					}
+					// Like GSL, give up on this lane and keep the values of its last accepted step
+					LOG(warning) << detail::STEP_TOO_SMALL_WARNING;
+					active[l] = false;
+					continue;
+				}
+
+				hnext[l] = h[l];
+				if (rmax < 0.5) {
+					hnext[l] = h[l] * detail::cash_karp_tableau::increase_factor(rmax);
+				}
+				t[l] = tnew;
+				h[l] = hnext[l];
+				accept(l, y, ynew);
+				needs_k1[l] = true;
+				active[l] = (t1 - t[l] > 0);
+			}
+		}
+	}
+
+	/**
+	 * Returns the number of steps taken by the last call to evolve on the given lane.
+	 *
+	 * @param lane The lane of interest
+	 * @return The number of steps taken to evolve the ODE system in @p lane.
+	 */
+	std::size_t num_evaluations(std::size_t lane) const
+	{
+		return steps[lane];
+	}
+
+	/**
+	 * Returns the number of steps rejected by the last call to evolve on the given lane.
+	 *
+	 * @param lane The lane of interest
+	 * @return The number of rejected steps in @p lane.
+	 */
+	std::size_t num_rejected_steps(std::size_t lane) const
+	{
+		return rejected_steps[lane];
+	}
+
+private:
+	Evaluator evaluator;
+	double precision;
+	std::array<std::size_t, W> steps;
+	std::array<std::size_t, W> rejected_steps;
+
+	void evaluate(const std::array<bool, W> &active, std::size_t n_lanes, const lanes_type &t, const batch_type &y, batch_type &f)
+	{
+		if (evaluator(active, n_lanes, t, y, f) != 0) {
+			throw math_error("Error while solving ODE system: user function signaled an error");
+		}
+	}
+
+	void accept(std::size_t lane, batch_type &y, const batch_type &ynew)
+	{
+		for (std::size_t i = 0; i != N; i++) {
+			y[i][lane] = ynew[i][lane];
+		}
+		steps[lane]++;
+	}
+
+	void evaluate_stage(const std::array<bool, W> &active, std::size_t n_lanes, const lanes_type &t, const lanes_type &h, double a, const batch_type &y, batch_type &f)
+	{
+		lanes_type t_stage;
+		for (std::size_t l = 0; l != W; l++) {
+			t_stage[l] = t[l] + a * h[l];
+		}
+		evaluate(active, n_lanes, t_stage, y, f);
+	}
+
+	/// Single Cash-Karp step on all lanes, each with its own size @p h.
+	/// Inactive lanes are computed too, but are not evaluated and their
+	/// results are ignored.
+	void step(const std::array<bool, W> &active, std::size_t n_lanes, const lanes_type &t, const lanes_type &h,
+	          const batch_type &y, const batch_type &k1, batch_type &ynew, batch_type &yerr)
+	{
+		using ck = detail::cash_karp_tableau;
+		batch_type ytmp, k2 {}, k3 {}, k4 {}, k5 {}, k6 {};
+
+		for (std::size_t i = 0; i != N; i++) {
+			for (std::size_t l = 0; l != W; l++) {
+				ytmp[i][l] = y[i][l] + ck::b21 * h[l] * k1[i][l];
+			}
+		}
+		evaluate_stage(active, n_lanes, t, h, ck::a2, ytmp, k2);
+
+		for (std::size_t i = 0; i != N; i++) {
+			for (std::size_t l = 0; l != W; l++) {
+				ytmp[i][l] = y[i][l] + h[l] * (ck::b31 * k1[i][l] + ck::b32 * k2[i][l]);
+			}
+		}
+		evaluate_stage(active, n_lanes, t, h, ck::a3, ytmp, k3);
+
+		for (std::size_t i = 0; i != N; i++) {
+			for (std::size_t l = 0; l != W; l++) {
+				ytmp[i][l] = y[i][l] + h[l] * (ck::b41 * k1[i][l] + ck::b42 * k2[i][l] + ck::b43 * k3[i][l]);
+			}
+		}
+		evaluate_stage(active, n_lanes, t, h, ck::a4, ytmp, k4);
+
+		for (std::size_t i = 0; i != N; i++) {
+			for (std::size_t l = 0; l != W; l++) {
+				ytmp[i][l] = y[i][l] + h[l] * (ck::b51 * k1[i][l] + ck::b52 * k2[i][l] + ck::b53 * k3[i][l] + ck::b54 * k4[i][l]);
+			}
+		}
+		evaluate_stage(active, n_lanes, t, h, ck::a5, ytmp, k5);
+
+		for (std::size_t i = 0; i != N; i++) {
+			for (std::size_t l = 0; l != W; l++) {
+				ytmp[i][l] = y[i][l] + h[l] * (ck::b61 * k1[i][l] + ck::b62 * k2[i][l] + ck::b63 * k3[i][l] + ck::b64 * k4[i][l] + ck::b65 * k5[i][l]);
+			}
+		}
+		evaluate_stage(active, n_lanes, t, h, ck::a6, ytmp, k6);
+
+		for (std::size_t i = 0; i != N; i++) {
+			for (std::size_t l = 0; l != W; l++) {
+				ynew[i][l] = y[i][l] + h[l] * (ck::c1 * k1[i][l] + ck::c3 * k3[i][l] + ck::c4 * k4[i][l] + ck::c6 * k6[i][l]);
+				yerr[i][l] = h[l] * (ck::ec1 * k1[i][l] + ck::ec3 * k3[i][l] + ck::ec4 * k4[i][l] + ck::ec5 * k5[i][l] + ck::ec6 * k6[i][l]);
+			}
+		}
+	}
+
+};
+
+/**
+ * Convenience function to create a BatchedCashKarpODESolver deducing the evaluator type
+ */
+template <std::size_t N, std::size_t W, typename Evaluator>
+BatchedCashKarpODESolver<N, W, Evaluator> make_batched_cash_karp_ode_solver(Evaluator evaluator, double precision)
+{
+	return BatchedCashKarpODESolver<N, W, Evaluator>(std::move(evaluator), precision);
+}
+
+}  // namespace shark
+
+#endif // SHARK_CASH_KARP_ODE_SOLVER_H_
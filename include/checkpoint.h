@@ -0,0 +1,129 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Header file for the Checkpoint class
+ */
+
+#ifndef SHARK_CHECKPOINT_H_
+#define SHARK_CHECKPOINT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "components.h"
+#include "execution.h"
+#include "options.h"
+
+namespace shark {
+
+/**
+ * Checkpoints of the full state of an evolution, from which it can be resumed.
+ *
+ * A checkpoint is taken between snapshots, and consists of two files. The
+ * first one holds the structure of the merger trees, which doesn't change
+ * during the evolution and is therefore written only once. The second one
+ * holds the evolving state: the gas and galaxies of all halos that are yet to
+ * be evolved, and the global baryon budget. Random numbers are drawn from
+ * counter-based streams keyed by the execution seed and object IDs, so they
+ * carry no state of their own.
+ *
+ * Like in TreeCache, files are named after a key describing all the inputs of
+ * the evolution, and files with a different key are never loaded.
+ */
+class Checkpoint {
+
+public:
+
+	/// The version of the on-disk format, increased on every layout change
+	static constexpr std::uint32_t VERSION = 2;
+
+	/// A job that writes a checkpoint into disk
+	using writing_job = std::function<void()>;
+
+	/**
+	 * Creates a new Checkpoint.
+	 *
+	 * @param directory The directory where checkpoint files are stored
+	 * @param key A description of the inputs of the evolution
+	 */
+	Checkpoint(const std::string &directory, std::string key);
+
+	/**
+	 * Loads the latest checkpoint taken for our key, if any.
+	 *
+	 * @param trees Where the merger trees, with their gas and galaxies, are restored
+	 * @param AllBaryons Where the global baryon budget is restored
+	 * @return The snapshot from which the evolution continues, or -1 if no
+	 * checkpoint is available
+	 */
+	int load(std::vector<MergerTreePtr> &trees, TotalBaryon &AllBaryons);
+
+	/**
+	 * Captures the state of the evolution right before @p snapshot is evolved.
+	 * Only halos at @p snapshot or later are captured, since earlier ones are
+	 * not evolved anymore.
+	 *
+	 * @param snapshot The next snapshot to be evolved
+	 * @param trees The merger trees being evolved
+	 * @param AllBaryons The global baryon budget up to @p snapshot
+	 * @return A self-contained job that writes the checkpoint into disk
+	 */
+	writing_job prepare_save(int snapshot, const std::vector<MergerTreePtr> &trees, const TotalBaryon &AllBaryons);
+
+	/// @return The name of the file where the structure of the merger trees is stored
+	const std::string &get_trees_filename() const
+	{
+		return trees_filename;
+	}
+
+	/// @return The name of the file where the evolving state is stored
+	const std::string &get_state_filename() const
+	{
+		return state_filename;
+	}
+
+private:
+	std::string key;
+	std::string trees_filename;
+	std::string state_filename;
+
+	// Shared with the writing jobs, which might outlive us
+	std::shared_ptr<std::atomic<bool>> trees_saved;
+};
+
+/**
+ * Builds the key identifying the evolution carried out with @p options.
+ *
+ * @param options All the options of the run
+ * @param exec_params The execution parameters of the run
+ * @param tree_key The key identifying the merger trees of the run
+ * @return A description of all the inputs of the evolution
+ */
+std::string make_checkpoint_key(const Options &options, const ExecutionParameters &exec_params, const std::string &tree_key);
+
+}  // namespace shark
+
+#endif // SHARK_CHECKPOINT_H_
@@ -167,6 +167,19 @@ struct InteractionItem{
 
 };
 
+/**
+ * Molecular and atomic gas masses of the disk and bulge of a galaxy,
+ * and specific angular momentum of the molecular and atomic gas in the disk.
+ */
+struct MolecularGas {
+	double m_mol;
+	double m_atom;
+	double m_mol_b;
+	double m_atom_b;
+	double j_mol;
+	double j_atom;
+};
+
 /**
  * A basic galaxy.
  *
@@ -236,6 +249,9 @@ public:
 	//save interactions of this galaxy during this snapshot.
 	InteractionItem interaction;
 
+	//save molecular and atomic gas content, calculated at the end of each snapshot's evolution.
+	MolecularGas molecular_gas {0, 0, 0, 0, 0, 0};
+
 	/**
 	 * tmerge: dynamical friction timescale, which is defined only if galaxy is satellite.
 	 * concentration_type2: concentration of the subhalo this galaxy was before becoming type 2 (only relevant for type 2 galaxies).
@@ -374,12 +390,14 @@ public:
 
 /**
  * This structure keeps track of the properties of the halo gas, which are necessary to implement a more sophisticated cooling model.
+ *
+ * integral: running integral of T * M / tcool * dt over the history of the halo gas,
+ *           with T the virial temperature, M the (comoving) hot gas mass, tcool the cooling time and dt the time step.
+ *           It is accumulated one time step at a time, so the history itself doesn't need to be kept.
+ * rheat: largest heating radius reached by the halo gas.
  */
 struct CoolingSubhaloTracking {
-	std::vector<double> deltat;
-	std::vector<double> temp;
-	std::vector<double> mass;
-	std::vector<double> tcooling;
+	double integral {0};
 	double rheat {0};
 };
 
@@ -511,7 +529,9 @@ public:
 	float infall_t = 0;
 
 	/**
-	 * cooling_subhalo_tracking: saves que information of the virial temperature, total halo gas and cooling time history.
+	 * cooling_subhalo_tracking: saves the running integral of Tvir * Mhot / tcool * dt
+	 * used to compute the time available for cooling, and the largest heating
+	 * radius reached so far.
 	 */
 	CoolingSubhaloTracking cooling_subhalo_tracking;
 
@@ -620,6 +640,12 @@ public:
 	 */
 	void check_satellite_subhalo_galaxy_composition() const;
 
+	/**
+	 * Removes all galaxies and empties all baryonic reservoirs of this
+	 * Subhalo, leaving it as it was right after the merger trees were built.
+	 */
+	void reset_baryons();
+
 private:
 	void do_check_satellite_subhalo_galaxy_composition() const;
 	void do_check_central_subhalo_galaxy_composition() const;
@@ -681,12 +707,21 @@ public:
 	}
 
 	/**
-	 * Returns a new vector containing pointers to all subhalos contained in
-	 * this halo (i.e., the central and satellite subhalos).
+	 * Returns all subhalos contained in this halo (i.e., the central and
+	 * satellite subhalos), ordered by mass in decreasing order.
+	 *
+	 * The ordering is maintained by add_subhalo and remove_subhalo, so calling
+	 * this method is cheap. The returned reference is invalidated when
+	 * subhalos are added to or removed from this halo, so code modifying the
+	 * halo while iterating must iterate over a copy.
 	 *
 	 * @return A vector with all subhalos
 	 */
-	std::vector<SubhaloPtr> all_subhalos() const;
+	const std::vector<SubhaloPtr> &all_subhalos() const
+	{
+		assert(ordered_subhalos.size() == subhalo_count());
+		return ordered_subhalos;
+	}
 
 	/**
 	 * Removes @a subhalo from this Halo. If the subhalo is not part of this
@@ -696,6 +731,14 @@ public:
 	 */
 	void remove_subhalo(const SubhaloPtr &subhalo);
 
+	/**
+	 * Rebuilds the mass-ordered list of subhalos returned by all_subhalos.
+	 * This needs to be called only after central_subhalo or satellite_subhalos
+	 * are directly modified in a way that changes the set of subhalos in this
+	 * halo, or after the masses of its subhalos change.
+	 */
+	void update_subhalo_order();
+
 	/**
 	 * @return The main progenitor of this halo
 	 */
@@ -763,6 +806,16 @@ public:
 	 */
 	double total_baryon_mass() const;
 
+	/**
+	 * Like Subhalo::reset_baryons, but for this Halo and all its subhalos.
+	 */
+	void reset_baryons();
+
+private:
+
+	/// All subhalos, ordered by mass in decreasing order
+	std::vector<SubhaloPtr> ordered_subhalos;
+
 };
 
 template <typename T>
@@ -788,6 +841,12 @@ std::basic_ostream<T> &operator<<(std::basic_ostream<T> &stream, const HaloPtr &
  *
  * A merger tree contains halos, which are indexed by snapshot,
  * and an ID to identify it.
+ *
+ * Halos are stored contiguously, sorted by snapshot (and in the order in
+ * which they were added within each snapshot), together with the offset at
+ * which the halos of each snapshot start. Halos added in non-decreasing
+ * snapshot order keep this index up to date; otherwise index_halos needs
+ * to be called before halos are looked up again.
  */
 class MergerTree : public Identifiable<std::int32_t> {
 public:
@@ -795,30 +854,113 @@ public:
 	using Identifiable::Identifiable;
 
 	/**
-	 * All halos contained in this merger tree, indexed by snapshot number
+	 * A contiguous range of halos of this merger tree
 	 */
-	std::map<int, std::vector<HaloPtr>> halos;
+	class halo_range {
+	public:
+		using iterator = std::vector<HaloPtr>::iterator;
 
-	void add_halo(const HaloPtr &halo) {
-		halos[halo->snapshot].push_back(halo);
+		halo_range(iterator first, iterator last) :
+			first(first), last(last)
+		{
+		}
+
+		iterator begin() const { return first; }
+		iterator end() const { return last; }
+		std::size_t size() const { return last - first; }
+		bool empty() const { return first == last; }
+		HaloPtr &operator[](std::size_t i) const { return first[i]; }
+
+	private:
+		iterator first;
+		iterator last;
+	};
+
+	/**
+	 * Adds @p halo to this merger tree
+	 *
+	 * @param halo The halo to add
+	 */
+	void add_halo(const HaloPtr &halo);
+
+	/**
+	 * Sorts the halos of this merger tree by snapshot and indexes them,
+	 * if they were not added in snapshot order.
+	 */
+	void index_halos();
+
+	/**
+	 * @return The halos of this merger tree at @p snapshot
+	 * @throws invalid_data if halos were added out of snapshot order and
+	 * index_halos has not been called since
+	 */
+	halo_range halos_at(int snapshot)
+	{
+		ensure_indexed();
+		if (halos.empty() || snapshot < first_snapshot || snapshot > last_snapshot()) {
+			return halo_range(halos.end(), halos.end());
+		}
+		auto idx = snapshot - first_snapshot;
+		return halo_range(halos.begin() + snapshot_offsets[idx], halos.begin() + snapshot_offsets[idx + 1]);
 	}
 
-	std::vector<HaloPtr> &halos_at(int snapshot)
+	/**
+	 * @return The halos of this merger tree at @p snapshot or later
+	 */
+	halo_range halos_since(int snapshot)
 	{
-		auto it = halos.find(snapshot);
-		if (it == halos.end()) {
-			return NONE;
+		ensure_indexed();
+		if (halos.empty() || snapshot <= first_snapshot) {
+			return all_halos();
 		}
-		return it->second;
+		if (snapshot > last_snapshot()) {
+			return halo_range(halos.end(), halos.end());
+		}
+		return halo_range(halos.begin() + snapshot_offsets[snapshot - first_snapshot], halos.end());
+	}
+
+	/**
+	 * @return All halos of this merger tree, sorted by snapshot
+	 */
+	halo_range all_halos()
+	{
+		ensure_indexed();
+		return halo_range(halos.begin(), halos.end());
 	}
 
-	std::vector<HaloPtr> &halos_at_last_snapshot()
+	halo_range halos_at_last_snapshot()
 	{
-		return halos.rbegin()->second;
+		return halos_at(last_snapshot());
 	}
 
+	/**
+	 * Breaks the links between the halos and subhalos of this merger tree,
+	 * and between them and the tree itself. These links form reference cycles,
+	 * so this must be called for the memory of the tree to be freed once it
+	 * is not needed anymore. The tree must not be used afterwards.
+	 */
+	void release();
+
 private:
-	static std::vector<HaloPtr> NONE;
+
+	/// All halos, sorted by snapshot when indexed
+	std::vector<HaloPtr> halos;
+
+	/// Where the halos of each snapshot start, plus the total number of halos
+	std::vector<std::uint32_t> snapshot_offsets;
+
+	/// The snapshot of the first entry of snapshot_offsets
+	int first_snapshot = 0;
+
+	/// Whether halos are sorted, and snapshot_offsets describes them
+	bool indexed = true;
+
+	int last_snapshot() const
+	{
+		return first_snapshot + int(snapshot_offsets.size()) - 2;
+	}
+
+	void ensure_indexed() const;
 };
 
 /**
@@ -24,8 +24,8 @@
 #ifndef INCLUDE_DARK_MATTER_HALOS_H_
 #define INCLUDE_DARK_MATTER_HALOS_H_
 
+#include <cstdint>
 #include <memory>
-#include <random>
 #include <string>
 #include <utility>
 #include <vector>
@@ -38,6 +38,7 @@
 #include "cosmology.h"
 #include "simulation.h"
 #include "execution.h"
+#include "philox_engine.h"
 
 namespace shark {
 
@@ -99,7 +100,7 @@ public:
 
 	double halo_virial_velocity (double mvir, double redshift);
 
-	float halo_lambda (xyz<float> L, float m, double z, double npart);
+	float halo_lambda (const Subhalo &subhalo, float m, double z, double npart);
 
 	double disk_size_theory (Subhalo &subhalo, double z);
 
@@ -121,18 +122,22 @@ public:
 	double v2disk (double x, double m, double c, double r);
 	double v2bulge (double x, double m, double c, double r);
 
-	void generate_random_orbits(xyz<float> &pos, xyz<float> &v, xyz<float> &L, double total_am, const HaloPtr &halo);
+	/**
+	 * Assigns a random position, velocity and angular momentum to a type 2
+	 * galaxy orbiting in @p halo. The random numbers are drawn from a stream
+	 * identified by the halo and galaxy IDs, so they don't depend on the order
+	 * in which galaxies are visited.
+	 */
+	void generate_random_orbits(xyz<float> &pos, xyz<float> &v, xyz<float> &L, double total_am, const HaloPtr &halo, const Galaxy &galaxy);
 
 protected:
 	DarkMatterHaloParameters params;
 	CosmologyPtr cosmology;
 	SimulationParameters sim_params;
-	std::default_random_engine generator;
-	std::lognormal_distribution<double> distribution;
-	std::uniform_real_distribution<float> flat_distribution;
+	std::uint32_t seed;
 
 private:
-	xyz<float> random_point_in_sphere(float r);
+	xyz<float> random_point_in_sphere(float r, philox_engine &generator);
 };
 
 /// Type used by users to keep track o
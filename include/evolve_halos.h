@@ -49,8 +49,8 @@ namespace shark {
  */
 void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int snapshot, TotalBaryon &AllBaryons);
 
-void track_total_baryons(Cosmology &cosmology, ExecutionParameters execparams, SimulationParameters simulation_params, const std::vector<HaloPtr> &halos,
-		TotalBaryon &AllBaryons, int snapshot, const molgas_per_galaxy &molgas, double deltat);
+void track_total_baryons(const SnapshotTimes &snapshot_times, ExecutionParameters execparams, const std::vector<HaloPtr> &halos,
+		TotalBaryon &AllBaryons, int snapshot, double deltat);
 
 }  // namespace shark
 
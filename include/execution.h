@@ -39,6 +39,17 @@ class ExecutionParameters {
 public:
 	explicit ExecutionParameters(const Options &options);
 
+	/**
+	 * The solvers that can be used to integrate the ODE systems of the physical model
+	 */
+	enum ode_solver_t {
+		GSL_RKCK = 0, //!< GSL's odeiv2 driver with its Cash-Karp stepper
+		BUILTIN_RKCK  //!< shark's own, fixed-size Cash-Karp solver
+	};
+
+	/// The maximum number of ODE systems the builtin solver integrates together
+	static constexpr unsigned int MAX_ODE_BATCH_SIZE = 8;
+
 	std::set<int> output_snapshots;
 	Options::file_format_t output_format = Options::HDF5;
 	std::string output_directory;
@@ -47,8 +58,8 @@ public:
 	std::vector<unsigned int> simulation_batches;
 	std::time_t starting_time = std::time(nullptr);
 
-	bool output_snapshot(int snapshot);
-	int last_output_snapshot();
+	bool output_snapshot(int snapshot) const;
+	int last_output_snapshot() const;
 
 	bool skip_missing_descendants = true;
 	bool warn_on_missing_descendants = true;
@@ -62,7 +73,81 @@ public:
 	bool output_sf_histories = false;
 	std::vector<int> snapshots_sf_histories;
 
+	/**
+	 * Parameters of the ODE integration:
+	 * ode_solver_precision: relative precision of the adaptive step size control.
+	 * ode_solver: the solver used to integrate the ODE systems.
+	 * ode_batch_size: number of halos whose galaxies are integrated together by the builtin solver.
+	 */
 	float ode_solver_precision = 0;
+	ode_solver_t ode_solver = GSL_RKCK;
+	unsigned int ode_batch_size = 1;
+
+	/**
+	 * Parameters of the output process:
+	 * async_output: whether output files are written in a background thread while galaxies keep evolving.
+	 * output_queue_length: maximum number of output snapshots waiting to be written at any given time.
+	 */
+	bool async_output = true;
+	unsigned int output_queue_length = 1;
+
+	/**
+	 * Directory where fully built merger trees are cached across runs.
+	 * If empty (the default) trees are always read and built from scratch.
+	 */
+	std::string tree_cache_directory;
+
+	/**
+	 * Parameters of checkpointing:
+	 * checkpoint_directory: directory where checkpoints of the evolution are written, and from which it is resumed. If empty (the default) no checkpoints are taken.
+	 * checkpoint_interval: number of snapshots between consecutive checkpoints.
+	 */
+	std::string checkpoint_directory;
+	unsigned int checkpoint_interval = 10;
+
+	/**
+	 * Number of simulation batches that are read, evolved and written together
+	 * before moving to the next ones. If 0 (the default) all batches are
+	 * evolved together.
+	 */
+	unsigned int stream_batches = 0;
+
+	/**
+	 * Whether the cost of evolving each galaxy (ODE evaluations, rejected
+	 * steps, star formation integration intervals and wall time) is recorded
+	 * and written into a galaxy_costs_<snapshot>.hdf5 file for each snapshot
+	 * under a profiling_<batch directory> directory in the model output directory.
+	 */
+	bool profile_galaxies = false;
+
+	/**
+	 * Whether machine-readable metrics about the execution (timings, counts,
+	 * ODE statistics and memory usage) are appended as JSON lines to a
+	 * metrics_<batch directory>.jsonl file under the model output directory.
+	 */
+	bool write_metrics = true;
+
+	/**
+	 * Parameters of tracing:
+	 * trace: whether what each thread does over time is recorded and written into a trace_<batch directory>.json trace-event file under the model output directory.
+	 * trace_buffer_size: maximum number of events kept per thread; older events are dropped.
+	 */
+	bool trace = false;
+	unsigned int trace_buffer_size = 65536;
+
+	/**
+	 * Splits the simulation batches into the groups that are evolved together.
+	 *
+	 * @return The groups of batches, in order. There is a single group with
+	 * all batches unless streaming is enabled.
+	 */
+	std::vector<std::vector<unsigned int>> batch_groups() const;
+
+	/**
+	 * @return The name of the directory, under each snapshot output
+	 * directory, where outputs for the simulation batches are written
+	 */
+	std::string batch_directory() const;
 };
 
 } // namespace shark
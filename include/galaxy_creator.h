@@ -24,6 +24,7 @@
 #ifndef SHARK_GALAXY_CREATOR_H_
 #define SHARK_GALAXY_CREATOR_H_
 
+#include "arena.h"
 #include "cosmology.h"
 #include "components.h"
 #include "dark_matter_halos.h"
@@ -39,7 +40,7 @@ public:
 	void create_galaxies(const std::vector<MergerTreePtr> &merger_trees, TotalBaryon &AllBaryons);
 
 private:
-	bool create_galaxies(const HaloPtr &halo, double z, Galaxy::id_t ID);
+	bool create_galaxies(const HaloPtr &halo, double z, Galaxy::id_t ID, const ArenaPtr &arena);
 
 	CosmologyPtr cosmology;
 	GasCoolingParameters cool_params;
@@ -24,8 +24,8 @@
 #ifndef INCLUDE_GALAXY_MERGERS_H_
 #define INCLUDE_GALAXY_MERGERS_H_
 
+#include <cstdint>
 #include <memory>
-#include <random>
 #include <vector>
 
 #include "agn_feedback.h"
@@ -36,6 +36,7 @@
 #include "physical_model.h"
 #include "simulation.h"
 #include "execution.h"
+#include "philox_engine.h"
 
 namespace shark {
 
@@ -81,6 +82,7 @@ public:
 			CosmologyPtr cosmology,
 			const ExecutionParameters &execparams,
 			SimulationParameters simparams,
+			SnapshotTimesPtr snapshot_times,
 			DarkMatterHalosPtr darkmatterhalo,
 			std::shared_ptr<BasicPhysicalModel> physicalmodel,
 			AGNFeedbackPtr agnfeedback);
@@ -91,7 +93,11 @@ public:
 
 	double merging_timescale_mass(double mp, double ms);
 
-	double merging_timescale_orbital();
+	/**
+	 * Draws the orbital factor of the merging timescale of @p galaxy, a
+	 * satellite of @p secondary, from a stream identified by their IDs.
+	 */
+	double merging_timescale_orbital(const Subhalo &secondary, const Galaxy &galaxy);
 
 	/**
 	 * Calculates the dynamical friction timescale for the subhalo secondary to merge into the subhalo primary,
@@ -144,12 +150,12 @@ private:
 	GalaxyMergerParameters parameters;
 	std::shared_ptr<Cosmology> cosmology;
 	SimulationParameters simparams;
+	SnapshotTimesPtr snapshot_times;
 	DarkMatterHalosPtr darkmatterhalo;
 	std::shared_ptr<BasicPhysicalModel> physicalmodel;
 	AGNFeedbackPtr agnfeedback;
 
-	std::default_random_engine generator;
-	std::lognormal_distribution<double> distribution;
+	std::uint32_t seed;
 
 };
 
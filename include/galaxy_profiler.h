@@ -0,0 +1,107 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Per-galaxy profiling of the cost of evolving galaxies
+ */
+
+#ifndef SHARK_GALAXY_PROFILER_H_
+#define SHARK_GALAXY_PROFILER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "components.h"
+#include "timer.h"
+
+namespace shark {
+
+/**
+ * The cost of integrating the ODE system of a single galaxy over a snapshot,
+ * together with the properties the galaxy had before the integration.
+ */
+struct galaxy_cost {
+	Galaxy::id_t galaxy_id;
+	Subhalo::id_t subhalo_id;
+	Halo::id_t halo_id;
+	Galaxy::galaxy_type_t galaxy_type;
+	bool starburst;
+	float mstars;
+	float mgas;
+	float mhot;
+	float mvir_subhalo;
+	std::uint32_t ode_evaluations;
+	std::uint32_t rejected_steps;
+	std::uint32_t integration_intervals;
+	Timer::duration wall_time;
+};
+
+/**
+ * A histogram with logarithmically-spaced bins. Values that are not positive
+ * have no logarithm and are counted separately.
+ */
+struct log_histogram {
+	/// The edges of the bins; there is one more edge than bins
+	std::vector<double> bin_edges;
+	/// The number of values falling in each bin
+	std::vector<std::uint64_t> counts;
+	/// The number of values that were zero or negative
+	std::uint64_t non_positive = 0;
+};
+
+/**
+ * Builds a histogram of @p values with @p bins_per_decade bins per decade.
+ * Bin edges are aligned to powers of ten, and cover all positive values.
+ *
+ * @param values The values to bin
+ * @param bins_per_decade The number of bins in each decade
+ * @return The histogram of @p values
+ */
+log_histogram make_log_histogram(const std::vector<double> &values, unsigned int bins_per_decade);
+
+/**
+ * Returns the share of the sum of @p values accounted for by the largest
+ * @p fraction of them (rounded up to at least one value).
+ *
+ * @param values The values, which should not be negative
+ * @param fraction The fraction of largest values to consider, in (0, 1]
+ * @return The share of the total, or 0 if the total is 0
+ */
+double top_share(std::vector<double> values, double fraction);
+
+/**
+ * Writes the costs measured while evolving galaxies up to @p snapshot into
+ * the HDF5 file @p filename, together with histograms of the costs, and logs
+ * how concentrated the costs were.
+ *
+ * @param filename The name of the HDF5 file to write. Its directory is
+ *  created if it doesn't exist yet.
+ * @param snapshot The snapshot galaxies were evolved up to
+ * @param redshift The redshift of @p snapshot
+ * @param costs The costs to write, in any order
+ */
+void write_galaxy_costs(const std::string &filename, int snapshot, double redshift, std::vector<galaxy_cost> costs);
+
+}  // namespace shark
+
+#endif // SHARK_GALAXY_PROFILER_H_
@@ -26,11 +26,18 @@
 #ifndef SHARK_GALAXY_WRITER_H_
 #define SHARK_GALAXY_WRITER_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <fstream>
+#include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -38,24 +45,85 @@
 #include "cosmology.h"
 #include "dark_matter_halos.h"
 #include "execution.h"
-#include "hdf5/writer.h"
+#include "hdf5/deferred_writer.h"
 #include "simulation.h"
 #include "star_formation.h"
+#include "timer.h"
+#include "tracer.h"
 
 namespace shark {
 
+/**
+ * Base class for all galaxy writers.
+ *
+ * Writing happens in two stages. First, all the information that needs to be
+ * written is copied out of the halos, subhalos and galaxies into a
+ * self-contained writing job. Then the job is executed, actually putting the
+ * data on disk. The first stage always happens on the calling thread; if
+ * asynchronous output is enabled, the second stage happens on a background
+ * thread, so the evolution of the next snapshot can continue in the meanwhile.
+ */
 class GalaxyWriter {
 
 public:
 
+	/// A self-contained unit of work that writes one output snapshot into disk
+	using writing_job = std::function<void()>;
+
 	GalaxyWriter(ExecutionParameters exec_params,
 			CosmologicalParameters cosmo_params,
 			CosmologyPtr cosmology,
 			DarkMatterHalosPtr darkmatterhalo,
-			SimulationParameters sim_params);
-	virtual ~GalaxyWriter() = default;
+			SimulationParameters sim_params,
+			SnapshotTimesPtr snapshot_times);
+	virtual ~GalaxyWriter();
+
+	/**
+	 * Writes the contents of @p halos as the galaxies of @p snapshot.
+	 *
+	 * All the required information is copied out of the halos before this
+	 * method returns, so they can be freely modified afterwards even if the
+	 * actual writing into disk has not finished yet.
+	 *
+	 * @param snapshot The snapshot being written
+	 * @param halos The halos to write
+	 * @param AllBaryons The global baryon budget up to this snapshot
+	 */
+	void write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons);
+
+	/**
+	 * Runs @p job after all outputs written so far, in the background if
+	 * asynchronous output is enabled.
+	 *
+	 * @param job A self-contained job that writes something else into disk
+	 */
+	void schedule(writing_job &&job);
+
+	/**
+	 * Waits until all pending writing jobs have finished. If any of them failed
+	 * its error is re-thrown here.
+	 */
+	void finish();
+
+	/**
+	 * @return The total time spent so far running writing jobs, either in
+	 * the background or on the calling thread
+	 */
+	Timer::duration get_writing_time() const
+	{
+		return writing_time;
+	}
 
-	virtual void write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal) = 0;
+	/**
+	 * Records writing jobs into the writer lane of @p tracer from now on.
+	 * Must be called before any job is scheduled.
+	 *
+	 * @param tracer The tracer to record writing jobs into
+	 */
+	void set_tracer(TracerPtr tracer)
+	{
+		this->tracer = std::move(tracer);
+	}
 
 	void track_total_baryons(int snapshot, const std::vector<HaloPtr> &halos);
 
@@ -66,31 +134,59 @@ protected:
 	CosmologyPtr cosmology;
 	DarkMatterHalosPtr darkmatterhalo;
 	SimulationParameters sim_params;
+	SnapshotTimesPtr snapshot_times;
 
 	std::string get_output_directory(int snapshot);
+
+	/**
+	 * Collects all the information needed to write @p snapshot, and returns a
+	 * job that writes it into disk. The job must not depend on @p halos or any
+	 * of the other given objects anymore, since they will keep evolving.
+	 */
+	virtual writing_job prepare_write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons) = 0;
+
+private:
+
+	std::thread writing_thread;
+	std::mutex jobs_mutex;
+	std::condition_variable jobs_changed;
+	std::deque<writing_job> pending_jobs;
+	bool job_in_progress = false;
+	bool stopping = false;
+	std::exception_ptr writing_error;
+	std::atomic<Timer::duration> writing_time {0};
+	TracerPtr tracer;
+
+	void enqueue(writing_job &&job);
+	void writing_loop();
+	void rethrow_writing_error(std::unique_lock<std::mutex> &lock);
 };
 
 class HDF5GalaxyWriter : public GalaxyWriter {
 
 public:
 	using GalaxyWriter::GalaxyWriter;
-	void write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal) override;
+
+protected:
+	writing_job prepare_write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons) override;
 
 private:
-	void write_header (hdf5::Writer &file, int snapshot);
-	void write_galaxies (hdf5::Writer &file, int snapshot, const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal);
-	void write_global_properties (hdf5::Writer &file, int snapshot, TotalBaryon &AllBaryons);
-	void write_histories (int snapshot, const std::vector<HaloPtr> &halos);
+	void write_header (hdf5::DeferredWriter &file, int snapshot);
+	void write_galaxies (hdf5::DeferredWriter &file, int snapshot, const std::vector<HaloPtr> &halos);
+	void write_global_properties (hdf5::DeferredWriter &file, int snapshot, TotalBaryon &AllBaryons);
+	std::shared_ptr<hdf5::DeferredWriter> write_histories (int snapshot, const std::vector<HaloPtr> &halos);
 };
 
 class ASCIIGalaxyWriter : public GalaxyWriter {
 
 public:
 	using GalaxyWriter::GalaxyWriter;
-	void write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal) override;
+
+protected:
+	writing_job prepare_write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons) override;
 
 private:
-	void write_galaxy(const GalaxyPtr &galaxy, const SubhaloPtr &subhalo, int snapshot, std::ofstream &f, const molgas_per_galaxy &molgas_per_gal);
+	void write_galaxy(const GalaxyPtr &galaxy, const SubhaloPtr &subhalo, int snapshot, std::ostream &f);
 
 };
 
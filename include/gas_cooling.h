@@ -125,7 +125,7 @@ private:
 	DarkMatterHalosPtr darkmatterhalos;
 	ReincorporationPtr reincorporation;
 	EnvironmentPtr environment;
-	Interpolator cooling_lambda_interpolator;
+	GridInterpolator cooling_lambda_interpolator;
 
 };
 
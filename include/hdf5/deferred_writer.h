@@ -0,0 +1,104 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Header file for the hdf5::DeferredWriter class
+ */
+
+#ifndef SHARK_HDF5_DEFERRED_WRITER_H_
+#define SHARK_HDF5_DEFERRED_WRITER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hdf5/writer.h"
+
+namespace shark {
+
+namespace hdf5 {
+
+/**
+ * An object with the same writing interface as Writer, but that only records
+ * the datasets and attributes it is given. These are then written into the
+ * HDF5 file all at once when write() is called.
+ *
+ * Values are kept by value, so once recorded they are not affected by further
+ * modifications of the objects they were taken from. Together with the fact
+ * that the file itself is only opened by write(), this makes it possible to
+ * freeze data at one point in time and write it later on from another thread.
+ */
+class DeferredWriter {
+
+public:
+
+	/**
+	 * Constructs a new DeferredWriter object.
+	 *
+	 * @param filename The name of the HDF5 file that will eventually be written
+	 */
+	explicit DeferredWriter(std::string filename) :
+		filename(std::move(filename))
+	{
+	}
+
+	template<typename T>
+	void write_attribute(const std::string &name, T value) {
+		auto val = std::make_shared<T>(std::move(value));
+		operations.emplace_back([name, val](Writer &writer) {
+			writer.write_attribute(name, *val);
+		});
+	}
+
+	template<typename T>
+	void write_dataset(const std::string &name, T value, const std::string &comment = std::string()) {
+		auto val = std::make_shared<T>(std::move(value));
+		operations.emplace_back([name, val, comment](Writer &writer) {
+			writer.write_dataset(name, *val, comment);
+		});
+	}
+
+	/// Opens the underlying file and writes all recorded attributes and datasets
+	void write() const {
+		Writer writer(filename);
+		for (auto &operation: operations) {
+			operation(writer);
+		}
+	}
+
+	/// @return The name of the HDF5 file that will eventually be written
+	const std::string &get_filename() const {
+		return filename;
+	}
+
+private:
+	std::string filename;
+	std::vector<std::function<void(Writer &)>> operations;
+
+};
+
+}  // namespace hdf5
+
+}  // namespace shark
+
+#endif // SHARK_HDF5_DEFERRED_WRITER_H_
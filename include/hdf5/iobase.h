@@ -26,6 +26,8 @@
 #ifndef INCLUDE_HDF5_IOBASE_H_
 #define INCLUDE_HDF5_IOBASE_H_
 
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -52,7 +54,14 @@ namespace shark {
 namespace hdf5 {
 
 /**
- * Base class for objects handling HDF5 I/O
+ * Base class for objects handling HDF5 I/O.
+ *
+ * The HDF5 library is not necessarily built to be thread-safe, but files are
+ * read and written from different threads (e.g., while outputs are written in
+ * the background). Every operation on an IOBase object, including opening and
+ * closing its file, therefore holds a process-wide lock for its duration,
+ * so only one thread calls into the library at any given time. Objects of
+ * the HDF5 C++ API (groups, datasets, etc.) must not outlive these operations.
  */
 class IOBase {
 
@@ -71,6 +80,9 @@ public:
 	 */
 	IOBase(const std::string &filename, unsigned int flags);
 
+	IOBase(IOBase &&) = default;
+	IOBase &operator=(IOBase &&) = default;
+
 	/**
 	 * Closes the file and destroys this class
 	 */
@@ -104,11 +116,14 @@ protected:
 	H5::DataSpace get_2d_dataspace(const H5::DataSet &dataset) const;
 	hsize_t get_1d_dimsize(const H5::DataSpace &space) const;
 
-	H5::H5File hdf5_file;
+	/// Returns a lock that must be held while calling into the HDF5 library
+	static std::unique_lock<std::recursive_mutex> lock_library();
+
+	// Only created, used and destroyed while holding the library lock
+	std::unique_ptr<H5::H5File> hdf5_file;
 
 private:
 
-	bool opened {true};
 	H5::DataSpace get_nd_dataspace(const H5::DataSet &dataset, unsigned int expected_ndims) const;
 };
 
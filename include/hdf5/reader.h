@@ -55,6 +55,7 @@ public:
 
 	template<typename T>
 	const T read_attribute(const std::string &name) const {
+		auto lock = lock_library();
 		std::string attr_name;
 		H5::Attribute attr = get_attribute(name);
 		H5::DataType type = attr.getDataType();
@@ -66,16 +67,19 @@ public:
 
 	template<typename T>
 	T read_dataset(const std::string &name) const {
+		auto lock = lock_library();
 		return _read_dataset<T>(get_dataset(name));
 	}
 
 	template<typename T>
 	std::vector<T> read_dataset_v(const std::string &name) const {
+		auto lock = lock_library();
 		return _read_dataset_v<T>(get_dataset(name));
 	}
 
 	template<typename T>
 	std::vector<T> read_dataset_v_2(const std::string &name) const {
+		auto lock = lock_library();
 		return _read_dataset_v_2<T>(get_dataset(name));
 	}
 
@@ -219,6 +219,8 @@ public:
 			return;
 		}
 
+		auto lock = lock_library();
+
 		// C-style function call; DataSet.setComment works only in hdf5>=1.8.11
 		H5Oset_comment(dataset.getId(), comment.c_str());
 
@@ -246,6 +248,8 @@ public:
 		auto &attr_name = parts.back();
 		check_attr_name(attr_name);
 
+		auto lock = lock_library();
+
 		// Get the corresponding group/dataset and write the attribute there
 		try {
 			auto group = ensure_group(path);
@@ -261,6 +265,7 @@ public:
 
 	template<typename T>
 	void write_dataset(const std::string &name, const T &value, const std::string &comment = NO_COMMENT) {
+		auto lock = lock_library();
 		H5::DataSpace dataSpace(H5S_SCALAR);
 		H5::DataType dataType = _datatype<T>(value);
 		auto dataset = ensure_dataset(tokenize(name, "/"), dataType, dataSpace);
@@ -270,6 +275,7 @@ public:
 
 	template<typename T>
 	void write_dataset(const std::string &name, const std::vector<T> &values, const std::string &comment = NO_COMMENT) {
+		auto lock = lock_library();
 		const hsize_t size = values.size();
 		H5::DataSpace dataSpace(1, &size);
 		H5::DataType dataType = _datatype<T>(values);
@@ -283,6 +289,7 @@ public:
 		if (values.empty()) {
 			return;
 		}
+		auto lock = lock_library();
 		const hsize_t sizes[] = {values.size(), values[0].size()};
 		H5::DataSpace dataSpace(2, sizes);
 		H5::DataType dataType = _datatype<T>(values);
@@ -26,8 +26,14 @@
 #ifndef SHARK_INTEGRATOR_H_
 #define SHARK_INTEGRATOR_H_
 
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
 #include <memory>
+#include <vector>
 
+#include <gsl/gsl_errno.h>
 #include <gsl/gsl_integration.h>
 
 #include "utils.h"
@@ -46,6 +52,10 @@ public:
 
 	using func_t = double (*)(double x, void *);
 
+	/// A function evaluating N integrands at once, storing their values at `x` in its last argument
+	template <std::size_t N>
+	using vector_func_t = void (*)(double x, void *, std::array<double, N> &);
+
 	///
 	/// Creates a new Integrator that will integrate using at most
 	/// `max_intervals` intervals internally.
@@ -63,6 +73,17 @@ public:
 	///
 	double integrate(func_t f, void *params, double from, double to, double epsabs, double epsrel);
 
+	///
+	/// Integrates the N functions evaluated by `f` with parameters `params`
+	/// between `from` and `to`, evaluating them all at once on each abscissa.
+	/// Like integrate, this uses an adaptive 15 point Gauss-Kronrod rule,
+	/// with the difference that intervals are subdivided until the errors of
+	/// all integrals satisfy the given tolerances. Errors are reported
+	/// through the GSL error handler.
+	///
+	template <std::size_t N>
+	std::array<double, N> integrate(vector_func_t<N> f, void *params, double from, double to, double epsabs, double epsrel);
+
 	///
 	/// Returns the number of internal intervals used during all integrations
 	/// so far, or since the last call to reset_num_intervals.
@@ -82,8 +103,174 @@ private:
 	std::size_t num_intervals;
 
 	void init_gsl_objects();
+
+	template <std::size_t N>
+	struct vector_interval {
+		double from;
+		double to;
+		std::array<double, N> result;
+		std::array<double, N> abserr;
+		/// The largest error relative to the tolerances, used to order intervals
+		double relative_error;
+	};
+
+	template <std::size_t N>
+	static vector_interval<N> gauss_kronrod_15(vector_func_t<N> f, void *params, double from, double to);
 };
 
+template <std::size_t N>
+std::array<double, N> Integrator::integrate(vector_func_t<N> f, void *params, double from, double to, double epsabs, double epsrel)
+{
+	std::vector<vector_interval<N>> intervals {gauss_kronrod_15(f, params, from, to)};
+	std::array<double, N> area = intervals[0].result;
+	std::array<double, N> errsum = intervals[0].abserr;
+
+	// Intervals are kept in a max-heap ordered by their largest error relative
+	// to the tolerances. These depend on the current area, so the heap is built
+	// again when they drift by more than a factor of 2 since it was last built
+	std::array<double, N> heap_tolerance;
+	bool heap_built = false;
+	auto set_relative_error = [&](vector_interval<N> &interval) {
+		interval.relative_error = 0;
+		for (std::size_t i = 0; i != N; i++) {
+			interval.relative_error = std::max(interval.relative_error, interval.abserr[i] / heap_tolerance[i]);
+		}
+	};
+	auto smaller_error = [](const vector_interval<N> &a, const vector_interval<N> &b) {
+		return a.relative_error < b.relative_error;
+	};
+
+	while (true) {
+		std::array<double, N> tolerance;
+		for (std::size_t i = 0; i != N; i++) {
+			tolerance[i] = std::max(epsabs, epsrel * std::abs(area[i]));
+		}
+
+		bool converged = true;
+		for (std::size_t i = 0; i != N; i++) {
+			converged = converged && (errsum[i] <= tolerance[i] || errsum[i] == 0);
+		}
+		if (converged) {
+			break;
+		}
+		if (intervals.size() >= max_intervals) {
+			num_intervals += intervals.size();
+			::gsl_error("number of iterations was insufficient", __FILE__, __LINE__, GSL_EMAXITER);
+			return area;
+		}
+
+		bool drifted = !heap_built;
+		for (std::size_t i = 0; i != N && !drifted; i++) {
+			drifted = tolerance[i] > 2 * heap_tolerance[i] || 2 * tolerance[i] < heap_tolerance[i];
+		}
+		if (drifted) {
+			heap_tolerance = tolerance;
+			for (auto &interval: intervals) {
+				set_relative_error(interval);
+			}
+			std::make_heap(intervals.begin(), intervals.end(), smaller_error);
+			heap_built = true;
+		}
+
+		// Bisect the interval contributing the most to the error
+		const auto &worst = intervals.front();
+		double mid = 0.5 * (worst.from + worst.to);
+		if (!(worst.from < mid && mid < worst.to)) {
+			num_intervals += intervals.size();
+			::gsl_error("cannot reach tolerance because of roundoff error", __FILE__, __LINE__, GSL_EROUND);
+			return area;
+		}
+
+		auto lower = gauss_kronrod_15(f, params, worst.from, mid);
+		auto upper = gauss_kronrod_15(f, params, mid, worst.to);
+		for (std::size_t i = 0; i != N; i++) {
+			area[i] += lower.result[i] + upper.result[i] - worst.result[i];
+			errsum[i] += lower.abserr[i] + upper.abserr[i] - worst.abserr[i];
+		}
+		std::pop_heap(intervals.begin(), intervals.end(), smaller_error);
+		intervals.pop_back();
+		for (auto interval: {lower, upper}) {
+			set_relative_error(interval);
+			intervals.push_back(interval);
+			std::push_heap(intervals.begin(), intervals.end(), smaller_error);
+		}
+	}
+
+	num_intervals += intervals.size();
+	return area;
+}
+
+template <std::size_t N>
+Integrator::vector_interval<N> Integrator::gauss_kronrod_15(vector_func_t<N> f, void *params, double from, double to)
+{
+	// Same abscissae, weights and error estimation as GSL's gsl_integration_qk15
+	static constexpr double xgk[8] = {
+		0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+		0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+		0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+		0.207784955007898467600689403773245, 0.000000000000000000000000000000000
+	};
+	static constexpr double wg[4] = {
+		0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+		0.381830050505118944950369775488975, 0.417959183673469387755102040816327
+	};
+	static constexpr double wgk[8] = {
+		0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+		0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+		0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+		0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+	};
+
+	const double center = 0.5 * (from + to);
+	const double half_length = 0.5 * (to - from);
+	const double abs_half_length = std::abs(half_length);
+
+	std::array<double, N> f_center;
+	std::array<std::array<double, N>, 7> fv1, fv2;
+	f(center, params, f_center);
+	for (std::size_t j = 0; j != 7; j++) {
+		double abscissa = half_length * xgk[j];
+		f(center - abscissa, params, fv1[j]);
+		f(center + abscissa, params, fv2[j]);
+	}
+
+	vector_interval<N> interval {from, to, {}, {}, 0};
+	for (std::size_t i = 0; i != N; i++) {
+		double result_gauss = f_center[i] * wg[3];
+		double result_kronrod = f_center[i] * wgk[7];
+		double result_abs = std::abs(result_kronrod);
+		for (std::size_t j = 0; j != 7; j++) {
+			double fsum = fv1[j][i] + fv2[j][i];
+			if (j % 2 == 1) {
+				result_gauss += wg[j / 2] * fsum;
+			}
+			result_kronrod += wgk[j] * fsum;
+			result_abs += wgk[j] * (std::abs(fv1[j][i]) + std::abs(fv2[j][i]));
+		}
+
+		double mean = result_kronrod * 0.5;
+		double result_asc = wgk[7] * std::abs(f_center[i] - mean);
+		for (std::size_t j = 0; j != 7; j++) {
+			result_asc += wgk[j] * (std::abs(fv1[j][i] - mean) + std::abs(fv2[j][i] - mean));
+		}
+
+		double err = std::abs((result_kronrod - result_gauss) * half_length);
+		result_abs *= abs_half_length;
+		result_asc *= abs_half_length;
+		if (result_asc != 0 && err != 0) {
+			double scale = std::pow(200 * err / result_asc, 1.5);
+			err = scale < 1 ? result_asc * scale : result_asc;
+		}
+		if (result_abs > DBL_MIN / (50 * DBL_EPSILON)) {
+			err = std::max(err, 50 * DBL_EPSILON * result_abs);
+		}
+
+		interval.result[i] = result_kronrod * half_length;
+		interval.abserr[i] = err;
+	}
+	return interval;
+}
+
 }  // namespace shark
 
 #endif // SHARK_INTEGRATOR_H_
\ No newline at end of file
@@ -24,6 +24,9 @@
 #ifndef SHARK_INTERPOLATION_H_
 #define SHARK_INTERPOLATION_H_
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -71,6 +74,87 @@ private:
 	const gsl_interp2d_type *to_gsl(InterpolatorType type) const;
 };
 
+/**
+ * A bilinear interpolator over a rectilinear (i.e., possibly irregular) grid.
+ *
+ * It gives the same results as a BILINEAR Interpolator, but finds the grid cell
+ * containing a point in constant time and keeps no mutable state, so a single
+ * object can be used concurrently from many threads. To locate cells, each
+ * axis is divided into uniform buckets no wider than its narrowest cell. The
+ * cell containing a value is then either the one where its bucket starts, or
+ * the next one. Once located, points are interpolated with a branch-free
+ * bilinear kernel.
+ */
+class GridInterpolator {
+
+public:
+
+	/**
+	 * Creates a new GridInterpolator.
+	 *
+	 * @param xvals The grid points along the x axis, in increasing order
+	 * @param yvals The grid points along the y axis, in increasing order
+	 * @param zvals The values at the grid points, with z(x_i, y_j) at position
+	 * j * xvals.size() + i, like for Interpolator
+	 */
+	GridInterpolator(std::vector<double> xvals, std::vector<double> yvals, std::vector<double> zvals);
+
+	/**
+	 * Interpolates the grid at (@p x, @p y). Values outside the grid are
+	 * clamped to its boundaries.
+	 */
+	double get(double x, double y) const
+	{
+		std::size_t i, j;
+		double t, u;
+		x_axis.locate(x, i, t);
+		y_axis.locate(y, j, u);
+		const double *z0 = &z[j * x_axis.size() + i];
+		const double *z1 = z0 + x_axis.size();
+		return (1 - t) * (1 - u) * z0[0] + t * (1 - u) * z0[1] + (1 - t) * u * z1[0] + t * u * z1[1];
+	}
+
+private:
+
+	/// One of the axes of the grid
+	class axis {
+
+	public:
+		explicit axis(std::vector<double> nodes);
+
+		std::size_t size() const
+		{
+			return nodes.size();
+		}
+
+		/**
+		 * Finds the cell containing @p v (clamped to the range of the axis),
+		 * and the relative position of @p v within that cell.
+		 */
+		void locate(double v, std::size_t &cell, double &t) const
+		{
+			v = std::max(nodes.front(), std::min(v, nodes.back()));
+			auto bucket = std::min(std::size_t((v - nodes.front()) * inv_bucket_width), bucket_cells.size() - 1);
+			cell = bucket_cells[bucket];
+			cell += std::size_t(v >= cell_ends[cell]);
+			t = (v - nodes[cell]) * inv_cell_widths[cell];
+		}
+
+	private:
+		std::vector<double> nodes;
+		/// The end of each cell, except for the last one, which never ends
+		std::vector<double> cell_ends;
+		std::vector<double> inv_cell_widths;
+		/// The cell where each bucket starts
+		std::vector<std::uint32_t> bucket_cells;
+		double inv_bucket_width;
+	};
+
+	axis x_axis;
+	axis y_axis;
+	std::vector<double> z;
+};
+
 }  // namespace shark
 
 #endif // SHARK_INTERPOLATION_H_
\ No newline at end of file
@@ -46,6 +46,9 @@ public:
 
 	const std::vector<HaloPtr> read_halos(std::vector<unsigned int> batches);
 
+	/// @return The name of the file containing the trees of batch @p batch
+	const std::string get_filename(int batch) const;
+
 private:
 	std::string prefix;
 	DarkMatterHalosPtr dark_matter_halos;
@@ -54,7 +57,6 @@ private:
 
 	const std::vector<HaloPtr> read_halos(unsigned int batch);
 	const std::vector<SubhaloPtr> read_subhalos(unsigned int batch);
-	const std::string get_filename(int batch);
 	const std::vector<Subhalo> read_subhalos_batch(int batch);
 
 
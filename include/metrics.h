@@ -0,0 +1,154 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Machine-readable metrics about the execution of shark
+ */
+
+#ifndef SHARK_METRICS_H_
+#define SHARK_METRICS_H_
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace shark {
+
+/**
+ * A metrics record, which is written as a single JSON object. Fields are
+ * written in the order in which they are added, and can be numbers, booleans,
+ * strings, vectors of those, or other (nested) records.
+ */
+class metrics_record {
+
+public:
+
+	/**
+	 * Adds a numeric field to this record. Non-finite floating-point values
+	 * are written as @p null.
+	 *
+	 * @param name The name of the field
+	 * @param value The value of the field
+	 * @return This record
+	 */
+	template <typename T>
+	typename std::enable_if<std::is_arithmetic<T>::value, metrics_record &>::type
+	add(const std::string &name, T value)
+	{
+		start_field(name);
+		write_value(value);
+		return *this;
+	}
+
+	/// Adds a string field to this record
+	metrics_record &add(const std::string &name, const std::string &value);
+
+	/// Adds a string field to this record
+	metrics_record &add(const std::string &name, const char *value)
+	{
+		return add(name, std::string(value));
+	}
+
+	/// Adds a nested record as a field of this record
+	metrics_record &add(const std::string &name, const metrics_record &value);
+
+	/// Adds an array of numbers as a field of this record
+	template <typename T>
+	metrics_record &add(const std::string &name, const std::vector<T> &values)
+	{
+		start_field(name);
+		fields << '[';
+		for (std::size_t i = 0; i != values.size(); i++) {
+			if (i > 0) {
+				fields << ',';
+			}
+			write_value(values[i]);
+		}
+		fields << ']';
+		return *this;
+	}
+
+	/// @return The JSON representation of this record
+	std::string str() const;
+
+private:
+	std::ostringstream fields;
+
+	void start_field(const std::string &name);
+	void write_value(bool value);
+	void write_value(double value);
+	void write_value(const metrics_record &value);
+
+	template <typename T>
+	typename std::enable_if<std::is_integral<T>::value>::type
+	write_value(T value)
+	{
+		fields << value;
+	}
+};
+
+/**
+ * A thread-safe sink of metrics records, which are appended as JSON lines
+ * (one record per line) to a file.
+ *
+ * Records are flushed as soon as they are written, so the file can be
+ * inspected while shark runs, and is complete up to the last record even if
+ * shark stops abruptly.
+ */
+class MetricsWriter {
+
+public:
+
+	/**
+	 * Creates a new MetricsWriter. Records are appended to any previous
+	 * contents of the file, so several runs can share it.
+	 *
+	 * @param filename The name of the file to write, whose directory is
+	 * created if it doesn't exist yet
+	 */
+	explicit MetricsWriter(const std::string &filename);
+
+	/// Appends @p record to the file
+	void write(const metrics_record &record);
+
+	/// @return The name of the file where records are written
+	const std::string &get_filename() const
+	{
+		return filename;
+	}
+
+private:
+	std::string filename;
+	std::ofstream f;
+	std::mutex mutex;
+};
+
+/// Type used by the rest of the code to handle MetricsWriter instances
+using MetricsWriterPtr = std::shared_ptr<MetricsWriter>;
+
+}  // namespace shark
+
+#endif // SHARK_METRICS_H_
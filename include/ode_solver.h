@@ -26,6 +26,7 @@
 #ifndef SHARK_ODE_SOLVER_H_
 #define SHARK_ODE_SOLVER_H_
 
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -74,12 +75,25 @@ public:
 	/**
 	 * Evolves the ODE system from 0 to ``delta_t``
 	 *
+	 * If a step's error is still too big once its size cannot be decreased
+	 * any further, GSL gives up; a warning is then logged, and the
+	 * integration stops early with the values of the last accepted step.
+	 *
 	 * @param y The values of the system at ``t = 0``. After returning the vector
 	 *  contains the values at ``delta_t``.
 	 * @param delta_t The amount of time the system is evolved for
 	 */
 	void evolve(std::vector<double> &y, double delta_t);
 
+	/**
+	 * Like evolve(std::vector<double> &, double), but for fixed-size arrays
+	 */
+	template <std::size_t N>
+	void evolve(std::array<double, N> &y, double delta_t)
+	{
+		evolve(y.data(), delta_t);
+	}
+
 	/**
 	 * Returns the number of times that the internal ODE system has been
 	 * evaluated so far.
@@ -88,9 +102,19 @@ public:
 	 */
 	std::size_t num_evaluations();
 
+	/**
+	 * Returns the number of steps rejected by the last call to evolve
+	 * because their error was too big.
+	 *
+	 * @return The number of rejected steps.
+	 */
+	std::size_t num_rejected_steps();
+
 private:
 	std::unique_ptr<gsl_odeiv2_system> ode_system;
 	std::unique_ptr<gsl_odeiv2_driver, gsl_odeiv2_driver_deleter> driver;
+
+	void evolve(double y[], double delta_t);
 };
 
 }  // namespace shark
@@ -101,6 +101,18 @@ public:
 		}
 	}
 
+	/// Returns all options in group `group` (i.e., those named ``group.*``)
+	///
+	/// @param group The name of the option group
+	/// @return The full names and values of the options in the group
+	options_t get_group(const std::string &group) const;
+
+	/// @return The full names and values of all options
+	const options_t &get_all() const
+	{
+		return options;
+	}
+
 	/// Parses `optspec` into its `name` and `value` components. It does so by
 	/// looking at an equals ("=") sign and interpreting the left-hand side string
 	/// as an option name and the right-hand side string as a value
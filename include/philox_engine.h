@@ -0,0 +1,148 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Header-only, counter-based Philox4x32-10 random number engine
+ */
+
+#ifndef INCLUDE_PHILOX_ENGINE_H_
+#define INCLUDE_PHILOX_ENGINE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace shark {
+
+/**
+ * The different uses shark has for random numbers. Each of them is used as
+ * part of the key of a philox_engine, and therefore gives an independent
+ * family of streams.
+ */
+enum random_stream_t : std::uint32_t {
+	HALO_LAMBDA = 0,   //!< Random spin parameters of subhalos
+	GALAXY_ORBITS,     //!< Random positions and velocities of type 2 galaxies
+	MERGING_TIMESCALE  //!< Random orbital factors of satellite merging timescales
+};
+
+namespace detail {
+
+inline
+void philox_mulhilo(std::uint32_t a, std::uint32_t b, std::uint32_t &hi, std::uint32_t &lo)
+{
+	std::uint64_t product = std::uint64_t(a) * b;
+	hi = std::uint32_t(product >> 32);
+	lo = std::uint32_t(product);
+}
+
+}  // namespace detail
+
+/**
+ * The Philox4x32-10 bijection of Salmon et al. (2011), which encrypts
+ * a 128-bit counter with a 64-bit key.
+ *
+ * @param counter The counter to encrypt
+ * @param key The key to encrypt the counter with
+ * @return Four, statistically independent, random 32-bit integers
+ */
+inline
+std::array<std::uint32_t, 4> philox4x32_10(std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key)
+{
+	for (int round = 0; round != 10; round++) {
+		if (round > 0) {
+			key[0] += 0x9E3779B9;
+			key[1] += 0xBB67AE85;
+		}
+		std::uint32_t hi0, lo0, hi1, lo1;
+		detail::philox_mulhilo(0xD2511F53, counter[0], hi0, lo0);
+		detail::philox_mulhilo(0xCD9E8D57, counter[2], hi1, lo1);
+		counter = {hi1 ^ counter[1] ^ key[0], lo1, hi0 ^ counter[3] ^ key[1], lo0};
+	}
+	return counter;
+}
+
+/**
+ * A counter-based random number engine.
+ *
+ * The n-th number drawn from an engine is a pure function of the seed, stream,
+ * ID and sub-ID the engine was constructed with, and of n itself. Engines are
+ * therefore cheap to construct locally wherever random numbers are needed for
+ * a given object (e.g., a subhalo or a galaxy), and the numbers drawn for the
+ * object don't depend on the order in which objects are visited, nor on the
+ * number of threads visiting them.
+ *
+ * This class satisfies the UniformRandomBitGenerator C++11 concept, so it can
+ * be used with any of the distributions from the @p std namespace, or with
+ * nfw_distribution.
+ */
+class philox_engine {
+
+public:
+
+	using result_type = std::uint32_t;
+
+	/**
+	 * Constructs a new engine.
+	 *
+	 * @param seed The global seed of the execution
+	 * @param stream The use the random numbers will be given
+	 * @param id The ID of the object the random numbers are drawn for
+	 * @param sub_id A secondary ID, for when @p id alone is not unique
+	 */
+	philox_engine(std::uint32_t seed, random_stream_t stream, std::uint64_t id, std::uint32_t sub_id = 0) :
+		key {{seed, stream}},
+		counter {{std::uint32_t(id), std::uint32_t(id >> 32), sub_id, 0}},
+		buffer(),
+		position(buffer.size())
+	{
+	}
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return 0xFFFFFFFF; }
+
+	result_type operator()()
+	{
+		if (position == buffer.size()) {
+			buffer = philox4x32_10(counter, key);
+			counter[3]++;
+			position = 0;
+		}
+		return buffer[position++];
+	}
+
+	void discard(unsigned long long n)
+	{
+		for (; n != 0; n--) {
+			(*this)();
+		}
+	}
+
+private:
+	std::array<std::uint32_t, 2> key;
+	std::array<std::uint32_t, 4> counter;
+	std::array<std::uint32_t, 4> buffer;
+	std::size_t position;
+
+};
+
+}  // namespace shark
+
+#endif // INCLUDE_PHILOX_ENGINE_H_
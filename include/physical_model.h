@@ -26,19 +26,25 @@
 #ifndef SHARK_SYSTEM_H_
 #define SHARK_SYSTEM_H_
 
+#include <array>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include <gsl/gsl_odeiv2.h>
 #include "agn_feedback.h"
 #include "components.h"
+#include "execution.h"
+#include "galaxy_profiler.h"
 #include "gas_cooling.h"
 #include "numerical_constants.h"
 #include "ode_solver.h"
 #include "recycling.h"
 #include "stellar_feedback.h"
 #include "star_formation.h"
+#include "timer.h"
 
 namespace shark {
 
@@ -47,6 +53,12 @@ class PhysicalModel {
 
 public:
 
+	/// The values of the ODE system integrated by this model
+	using ode_state = std::array<double, NC>;
+
+	/// The values of a batch of ODE systems, indexed by ``[component][lane]``
+	using ode_batch_state = std::array<std::array<double, ExecutionParameters::MAX_ODE_BATCH_SIZE>, NC>;
+
 	/**
 	 * The set of parameters passed down to the ODESolver. It includes the
 	 * physical model itself, the galaxy and subhalo being evolved on each call,
@@ -64,6 +76,7 @@ public:
 	 * mBHacc: BH accretion rate in the case of starbursts.
 	 * mBH: supermassive black hole mass.
 	 * burst: whether this is a starburst or not.
+	 * integration_intervals: star formation integration intervals used so far.
 	 */
 	struct solver_params {
 		PhysicalModel<NC> &model;
@@ -78,17 +91,32 @@ public:
 		double vgal;
 		double mBHacc;
 		double mBH;
+		std::size_t integration_intervals;
+	};
+
+	/// The cost of integrating the ODE system of a galaxy
+	struct ode_cost {
+		std::size_t evaluations;
+		std::size_t rejected_steps;
 	};
 
+	/// The costs of integrating a batch of ODE systems, indexed by lane
+	using ode_batch_cost = std::array<ode_cost, ExecutionParameters::MAX_ODE_BATCH_SIZE>;
+
 	PhysicalModel(
-			double ode_solver_precision,
+			const ExecutionParameters &exec_params,
 			ODESolver::ode_evaluator evaluator,
 			GasCooling gas_cooling) :
-		params {*this, false, 0., 0., 0., 0., 0., 0., 0., 0., 0., 0.},
-		starburst_params {*this, true, 0., 0., 0., 0., 0., 0., 0., 0., 0., 0.},
+		ode_solver_precision(exec_params.ode_solver_precision),
+		ode_solver_type(exec_params.ode_solver),
+		ode_batch_size(exec_params.ode_batch_size),
+		profile_galaxies(exec_params.profile_galaxies),
+		params {*this, false, 0., 0., 0., 0., 0., 0., 0., 0., 0., 0., 0},
+		starburst_params {*this, true, 0., 0., 0., 0., 0., 0., 0., 0., 0., 0., 0},
+		batch_params(ExecutionParameters::MAX_ODE_BATCH_SIZE, params),
 		ode_solver(evaluator, NC, ode_solver_precision, &params),
 		starburst_ode_solver(evaluator, NC, ode_solver_precision, &starburst_params),
-		ode_values(NC), starburst_ode_values(NC),
+		ode_values(), starburst_ode_values(),
 		gas_cooling(std::move(gas_cooling)),
 		galaxy_ode_evaluations(0),
 		galaxy_starburst_ode_evaluations(0)
@@ -100,51 +128,262 @@ public:
 
 	void evolve_galaxy(Subhalo &subhalo, Galaxy &galaxy, double z, double delta_t)
 	{
-		/**
-		 * Parameters that are needed as input in the ode_solver:
-		 * mcoolrate: gas cooling rate onto galaxy [Msun/Gyr/h]
-		 * rgas: half-gas mass radius of the disk [Mpc/h]
-		 * vgal: disk velocity at rgas [km/s]
-		 * rstar: half-stellar mass radius of the disk [Mpc/h]
-		 * vsubh: virial velocity of the host subhalo [km/s]
-		 * jcold_halo: specific angular momentum of the cooling gas [Msun/h Mpc/h km/s]
-		 * mBHacc: BH accretion rate due to starbursts; \equiv 0 in the case of star formation in disks.
-		 * mBH: supermassive black hole mass.
-		 * burst: boolean parameter indicating if this is a starburst or not.
-		 */
+		if (!profile_galaxies) {
+			do_evolve_galaxy(subhalo, galaxy, z, delta_t);
+			return;
+		}
+
+		Timer t;
+		auto cost = begin_galaxy_cost(subhalo, galaxy, false);
+		auto solver_cost = do_evolve_galaxy(subhalo, galaxy, z, delta_t);
+		end_galaxy_cost(cost, solver_cost, params, t.get());
+	}
+
+	/**
+	 * Evolves all the galaxies hosted by @p halos.
+	 *
+	 * Galaxies hosted by the same halo are coupled to each other through their
+	 * subhalos, so they are evolved one after the other, in the same order in
+	 * which evolve_galaxy would be called on them. Galaxies from different halos
+	 * on the other hand are independent, so up to ``execution.ode_batch_size``
+	 * halos are evolved at the same time, one galaxy of each, integrating their
+	 * ODE systems in lockstep with the builtin batched solver.
+	 *
+	 * @param halos The halos whose galaxies will be evolved
+	 * @param z The redshift at the beginning of the evolution
+	 * @param delta_t The amount of time to evolve the galaxies for
+	 */
+	void evolve_galaxies(const MergerTree::halo_range &halos, double z, double delta_t)
+	{
+		using galaxy_ref = std::pair<Subhalo *, Galaxy *>;
+
+		// Each lane is assigned one halo at a time, and walks through its galaxies
+		struct lane_t {
+			std::vector<galaxy_ref> galaxies;
+			std::size_t next;
+		};
+		std::vector<lane_t> lanes(ode_batch_size);
+		auto next_halo = halos.begin();
+
+		ode_batch_state batch_values {};
+		std::array<std::size_t, ExecutionParameters::MAX_ODE_BATCH_SIZE> batch_lanes;
+		std::array<galaxy_cost, ExecutionParameters::MAX_ODE_BATCH_SIZE> batch_costs;
+		ode_state y;
+
+		while (true) {
+
+			// Batches are only timed when profiling
+			Timer::clock::time_point batch_start;
+			if (profile_galaxies) {
+				batch_start = Timer::clock::now();
+			}
+
+			// Gather the next galaxy of each lane into the batch
+			std::size_t n_lanes = 0;
+			for (std::size_t l = 0; l != lanes.size(); l++) {
+				auto &lane = lanes[l];
+				while (lane.next == lane.galaxies.size() && next_halo != halos.end()) {
+					lane.galaxies.clear();
+					lane.next = 0;
+					for (auto &subhalo: (*next_halo)->all_subhalos()) {
+						for (auto &galaxy: subhalo->galaxies) {
+							lane.galaxies.emplace_back(subhalo.get(), galaxy.get());
+						}
+					}
+					next_halo++;
+				}
+				if (lane.next == lane.galaxies.size()) {
+					continue;
+				}
+
+				auto &subhalo = *lane.galaxies[lane.next].first;
+				auto &galaxy = *lane.galaxies[lane.next].second;
+				if (profile_galaxies) {
+					batch_costs[n_lanes] = begin_galaxy_cost(subhalo, galaxy, false);
+				}
+				set_params(batch_params[n_lanes], subhalo, galaxy, z, delta_t);
+				from_galaxy(y, subhalo, galaxy);
+				for (std::size_t i = 0; i != NC; i++) {
+					batch_values[i][n_lanes] = y[i];
+				}
+				batch_lanes[n_lanes++] = l;
+			}
+
+			if (n_lanes == 0) {
+				break;
+			}
+
+			auto solver_costs = evolve_builtin_batch(batch_values, n_lanes, batch_params, delta_t);
+			for (std::size_t b = 0; b != n_lanes; b++) {
+				galaxy_ode_evaluations += solver_costs[b].evaluations;
+			}
+
+			// Scatter the results back
+			for (std::size_t b = 0; b != n_lanes; b++) {
+				auto &lane = lanes[batch_lanes[b]];
+				for (std::size_t i = 0; i != NC; i++) {
+					y[i] = batch_values[i][b];
+				}
+				auto &galaxy_ref = lane.galaxies[lane.next++];
+				to_galaxy(y, *galaxy_ref.first, *galaxy_ref.second, delta_t);
+			}
+
+			// Galaxies integrated together share the time of the batch evenly
+			if (profile_galaxies) {
+				auto batch_time = std::chrono::duration_cast<std::chrono::nanoseconds>(Timer::clock::now() - batch_start).count();
+				auto wall_time = batch_time / Timer::duration(n_lanes);
+				for (std::size_t b = 0; b != n_lanes; b++) {
+					end_galaxy_cost(batch_costs[b], solver_costs[b], batch_params[b], wall_time);
+				}
+			}
+		}
+	}
+
+	void evolve_galaxy_starburst(Subhalo &subhalo, Galaxy &galaxy, double z, double delta_t, bool from_galaxy_merger)
+	{
+		if (!profile_galaxies) {
+			do_evolve_galaxy_starburst(subhalo, galaxy, z, delta_t, from_galaxy_merger);
+			return;
+		}
+
+		Timer t;
+		auto cost = begin_galaxy_cost(subhalo, galaxy, true);
+		auto solver_cost = do_evolve_galaxy_starburst(subhalo, galaxy, z, delta_t, from_galaxy_merger);
+		end_galaxy_cost(cost, solver_cost, starburst_params, t.get());
+	}
+
+	virtual void from_galaxy(ode_state &y, const Subhalo &subhalo, const Galaxy &galaxy) = 0;
+	virtual void to_galaxy(const ode_state &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t) = 0;
+
+	virtual void from_galaxy_starburst(ode_state &y, const Subhalo &subhalo, const Galaxy &galaxy) = 0;
+	virtual void to_galaxy_starburst(const ode_state &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t, bool from_galaxy_merger) = 0;
+
+	std::size_t get_galaxy_ode_evaluations() {
+		return galaxy_ode_evaluations;
+	}
+
+	std::size_t get_galaxy_starburst_ode_evaluations() {
+		return galaxy_starburst_ode_evaluations;
+	}
+
+	virtual void reset_ode_evaluations() {
+		galaxy_ode_evaluations = 0;
+		galaxy_starburst_ode_evaluations = 0;
+	}
+
+	/**
+	 * Returns the costs recorded since the last call to this method, if
+	 * ``execution.profile_galaxies`` is enabled, and forgets about them.
+	 *
+	 * @return The cost of each galaxy integration, in the order they happened
+	 */
+	std::vector<galaxy_cost> take_galaxy_costs() {
+		std::vector<galaxy_cost> costs;
+		costs.swap(galaxy_costs);
+		return costs;
+	}
+
+protected:
+
+	/**
+	 * Evolves @p y for @p delta_t using shark's builtin ODE solver, which
+	 * needs to know the concrete evaluator of the ODE system at compile time.
+	 *
+	 * @return The cost of the integration
+	 */
+	virtual ode_cost evolve_builtin(ode_state &y, solver_params &params, double delta_t) = 0;
+
+	/**
+	 * Like evolve_builtin, but evolves the first @p n_lanes ODE systems of @p y
+	 * together, each with the corresponding element of @p params.
+	 *
+	 * @return The cost of the integration of each lane
+	 */
+	virtual ode_batch_cost evolve_builtin_batch(ode_batch_state &y, std::size_t n_lanes, std::vector<solver_params> &params, double delta_t) = 0;
+
+	double ode_solver_precision;
+
+private:
+	ExecutionParameters::ode_solver_t ode_solver_type;
+	unsigned int ode_batch_size;
+	bool profile_galaxies;
+	std::vector<galaxy_cost> galaxy_costs;
+	solver_params params;
+	solver_params starburst_params;
+	std::vector<solver_params> batch_params;
+	ODESolver ode_solver;
+	ODESolver starburst_ode_solver;
+	ode_state ode_values;
+	ode_state starburst_ode_values;
+	GasCooling gas_cooling;
+	std::size_t galaxy_ode_evaluations;
+	std::size_t galaxy_starburst_ode_evaluations;
 
+	/**
+	 * Sets the parameters needed to evolve the disk of @p galaxy in @p galaxy_params.
+	 *
+	 * Parameters that are needed as input in the ode_solver:
+	 * mcoolrate: gas cooling rate onto galaxy [Msun/Gyr/h]
+	 * rgas: half-gas mass radius of the disk [Mpc/h]
+	 * vgal: disk velocity at rgas [km/s]
+	 * rstar: half-stellar mass radius of the disk [Mpc/h]
+	 * vsubh: virial velocity of the host subhalo [km/s]
+	 * jcold_halo: specific angular momentum of the cooling gas [Msun/h Mpc/h km/s]
+	 * mBHacc: BH accretion rate due to starbursts; \equiv 0 in the case of star formation in disks.
+	 * mBH: supermassive black hole mass.
+	 * burst: boolean parameter indicating if this is a starburst or not.
+	 */
+	void set_params(solver_params &galaxy_params, Subhalo &subhalo, Galaxy &galaxy, double z, double delta_t)
+	{
 		// Define cooling rate only in the case galaxy is central.
-		params.mcoolrate = 0;
+		galaxy_params.mcoolrate = 0;
 		if (galaxy.galaxy_type == Galaxy::CENTRAL) {
-			params.mcoolrate = gas_cooling.cooling_rate(subhalo, galaxy, z, delta_t);
+			galaxy_params.mcoolrate = gas_cooling.cooling_rate(subhalo, galaxy, z, delta_t);
 		}
 
-		params.rgas = galaxy.disk_gas.rscale; //gas scale radius.
-		params.vgal = galaxy.disk_gas.sAM / galaxy.disk_gas.rscale * constants::EAGLEJconv;
+		galaxy_params.rgas = galaxy.disk_gas.rscale; //gas scale radius.
+		galaxy_params.vgal = galaxy.disk_gas.sAM / galaxy.disk_gas.rscale * constants::EAGLEJconv;
 
 		// Catch cases where gas disk doesn't exist yet.
-		if (params.rgas <= 0) {
+		if (galaxy_params.rgas <= 0) {
 			//In this case assign a scalelength due to the cooling gas.
-			params.rgas = subhalo.cold_halo_gas.sAM / galaxy.vmax * constants::EAGLEJconv;
-			params.vgal = galaxy.vmax;
+			galaxy_params.rgas = subhalo.cold_halo_gas.sAM / galaxy.vmax * constants::EAGLEJconv;
+			galaxy_params.vgal = galaxy.vmax;
 		}
 
-		params.rstar      = galaxy.disk_stars.rscale; //stellar scale radius.
-		params.vsubh      = subhalo.Vvir;
-		params.jcold_halo = subhalo.cold_halo_gas.sAM;
-		params.delta_t = delta_t;
-		params.mBH = galaxy.smbh.mass;
-		params.redshift = z;
+		galaxy_params.rstar      = galaxy.disk_stars.rscale; //stellar scale radius.
+		galaxy_params.vsubh      = subhalo.Vvir;
+		galaxy_params.jcold_halo = subhalo.cold_halo_gas.sAM;
+		galaxy_params.delta_t = delta_t;
+		galaxy_params.mBH = galaxy.smbh.mass;
+		galaxy_params.redshift = z;
+		galaxy_params.integration_intervals = 0;
+	}
+
+	ode_cost evolve(ODESolver &solver, ode_state &y, solver_params &params, double delta_t)
+	{
+		if (ode_solver_type == ExecutionParameters::BUILTIN_RKCK) {
+			return evolve_builtin(y, params, delta_t);
+		}
+		solver.evolve(y, delta_t);
+		return {solver.num_evaluations(), solver.num_rejected_steps()};
+	}
+
+	/// Integrates the ODE system of @p galaxy
+	ode_cost do_evolve_galaxy(Subhalo &subhalo, Galaxy &galaxy, double z, double delta_t)
+	{
+		set_params(params, subhalo, galaxy, z, delta_t);
 
 		from_galaxy(ode_values, subhalo, galaxy);
-		ode_solver.evolve(ode_values, delta_t);
-		galaxy_ode_evaluations += ode_solver.num_evaluations();
+		auto solver_cost = evolve(ode_solver, ode_values, params, delta_t);
+		galaxy_ode_evaluations += solver_cost.evaluations;
 		to_galaxy(ode_values, subhalo, galaxy, delta_t);
+		return solver_cost;
 	}
 
-	void evolve_galaxy_starburst(Subhalo &subhalo, Galaxy &galaxy, double z, double delta_t, bool from_galaxy_merger)
+	/// Integrates the starburst ODE system of @p galaxy
+	ode_cost do_evolve_galaxy_starburst(Subhalo &subhalo, Galaxy &galaxy, double z, double delta_t, bool from_galaxy_merger)
 	{
-
 		/**
 		 * Parameters that are needed as input in the ode_solver:
 		 * mcoolrate: gas cooling rate onto galaxy [Msun/Gyr/h]. In the case of starbursts, this is \equiv 0
@@ -166,47 +405,45 @@ public:
 		starburst_params.mBH = galaxy.smbh.mass;
 		starburst_params.delta_t = delta_t;
 		starburst_params.redshift = z;
+		starburst_params.integration_intervals = 0;
 
 		from_galaxy_starburst(starburst_ode_values, subhalo, galaxy);
-		starburst_ode_solver.evolve(starburst_ode_values, delta_t);
-		galaxy_starburst_ode_evaluations += starburst_ode_solver.num_evaluations();
+		auto solver_cost = evolve(starburst_ode_solver, starburst_ode_values, starburst_params, delta_t);
+		galaxy_starburst_ode_evaluations += solver_cost.evaluations;
 		to_galaxy_starburst(starburst_ode_values, subhalo, galaxy, delta_t, from_galaxy_merger);
+		return solver_cost;
 	}
 
-	virtual void from_galaxy(std::vector<double> &y, const Subhalo &subhalo, const Galaxy &galaxy) = 0;
-	virtual void to_galaxy(const std::vector<double> &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t) = 0;
-
-	virtual void from_galaxy_starburst(std::vector<double> &y, const Subhalo &subhalo, const Galaxy &galaxy) = 0;
-	virtual void to_galaxy_starburst(const std::vector<double> &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t, bool from_galaxy_merger) = 0;
-
-	std::size_t get_galaxy_ode_evaluations() {
-		return galaxy_ode_evaluations;
-	}
-
-	std::size_t get_galaxy_starburst_ode_evaluations() {
-		return galaxy_starburst_ode_evaluations;
+	/// Starts recording the cost of integrating @p galaxy
+	galaxy_cost begin_galaxy_cost(const Subhalo &subhalo, Galaxy &galaxy, bool starburst)
+	{
+		galaxy_cost cost {};
+		cost.galaxy_id = galaxy.id;
+		cost.subhalo_id = subhalo.id;
+		cost.halo_id = subhalo.host_halo ? subhalo.host_halo->id : subhalo.haloID;
+		cost.galaxy_type = galaxy.galaxy_type;
+		cost.starburst = starburst;
+		cost.mstars = float(galaxy.stellar_mass());
+		cost.mgas = float(galaxy.gas_mass());
+		cost.mhot = subhalo.hot_halo_gas.mass;
+		cost.mvir_subhalo = subhalo.Mvir;
+		return cost;
 	}
 
-	virtual void reset_ode_evaluations() {
-		galaxy_ode_evaluations = 0;
-		galaxy_starburst_ode_evaluations = 0;
+	/// Completes @p cost with the outcome of the integration, and records it
+	void end_galaxy_cost(galaxy_cost &cost, const ode_cost &solver_cost, const solver_params &params, Timer::duration wall_time)
+	{
+		cost.ode_evaluations = std::uint32_t(solver_cost.evaluations);
+		cost.rejected_steps = std::uint32_t(solver_cost.rejected_steps);
+		cost.integration_intervals = std::uint32_t(params.integration_intervals);
+		cost.wall_time = wall_time;
+		galaxy_costs.push_back(cost);
 	}
-
-private:
-	solver_params params;
-	solver_params starburst_params;
-	ODESolver ode_solver;
-	ODESolver starburst_ode_solver;
-	std::vector<double> ode_values;
-	std::vector<double> starburst_ode_values;
-	GasCooling gas_cooling;
-	std::size_t galaxy_ode_evaluations;
-	std::size_t galaxy_starburst_ode_evaluations;
 };
 
 class BasicPhysicalModel : public PhysicalModel<19> {
 public:
-	BasicPhysicalModel(double ode_solver_precision,
+	BasicPhysicalModel(const ExecutionParameters &exec_params,
 			GasCooling gas_cooling,
 			StellarFeedback stellar_feedback,
 			StarFormation star_formation,
@@ -215,11 +452,11 @@ public:
 			GasCoolingParameters gas_cooling_parameters,
 			AGNFeedbackParameters agn_parameters);
 
-	void from_galaxy(std::vector<double> &y, const Subhalo &subhalo, const Galaxy &galaxy) override;
-	void to_galaxy(const std::vector<double> &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t) override;
+	void from_galaxy(ode_state &y, const Subhalo &subhalo, const Galaxy &galaxy) override;
+	void to_galaxy(const ode_state &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t) override;
 
-	void from_galaxy_starburst(std::vector<double> &y, const Subhalo &subhalo, const Galaxy &galaxy) override;
-	void to_galaxy_starburst(const std::vector<double> &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t, bool from_galaxy_merger) override;
+	void from_galaxy_starburst(ode_state &y, const Subhalo &subhalo, const Galaxy &galaxy) override;
+	void to_galaxy_starburst(const ode_state &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t, bool from_galaxy_merger) override;
 
 	AGNFeedback agn_feedback;
 	StellarFeedback stellar_feedback;
@@ -238,6 +475,10 @@ public:
 		return star_formation.get_integration_intervals();
 	}
 
+protected:
+	ode_cost evolve_builtin(ode_state &y, solver_params &params, double delta_t) override;
+	ode_batch_cost evolve_builtin_batch(ode_batch_state &y, std::size_t n_lanes, std::vector<solver_params> &params, double delta_t) override;
+
 };
 
 }  // namespace shark
@@ -27,6 +27,7 @@
 #define SHARK_SHARK_RUNNER_H
 
 #include <memory>
+#include <vector>
 
 namespace shark {
 
@@ -62,6 +63,21 @@ public:
 	/// Run shark until completion
 	void run();
 
+	/**
+	 * Run several models until completion, one after the other. Merger trees
+	 * are imported only once by the first model, and then reused by the rest.
+	 * Each model writes only its own outputs, and the import of the trees
+	 * shows in the metrics and trace of the first one.
+	 *
+	 * Each model is given by its full set of options. Models can differ only
+	 * in options that don't affect the merger trees (i.e., those of the
+	 * physical model); otherwise an exception is thrown.
+	 *
+	 * @param models The options of each model
+	 * @param threads The number of threads used to run shark
+	 */
+	static void run(const std::vector<Options> &models, unsigned int threads);
+
 private:
 	class impl;
 	std::unique_ptr<impl> pimpl;
@@ -26,10 +26,13 @@
 #ifndef SHARK_SIMULATION_H_
 #define SHARK_SIMULATION_H_
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 #include <string>
 
 #include "cosmology.h"
+#include "exceptions.h"
 #include "options.h"
 
 namespace shark {
@@ -60,6 +63,92 @@ public:
 };
 
 
+/**
+ * An immutable table with the cosmic time properties of each snapshot of the
+ * simulation: redshift, age of the universe, expansion factor and Hubble
+ * parameter.
+ *
+ * These are computed once per run out of the redshift table of the simulation,
+ * so looking them up is a simple array access instead of a map lookup plus an
+ * evaluation of the cosmological formulae. Snapshots after the last one in the
+ * redshift table are considered to be at the present (z = 0).
+ */
+class SnapshotTimes {
+
+public:
+
+	/**
+	 * Builds the table for all the snapshots in the redshift table of
+	 * @p sim_params, which must be consecutive.
+	 *
+	 * @param sim_params The simulation parameters
+	 * @param cosmology The cosmology used to derive ages and Hubble parameters
+	 */
+	SnapshotTimes(const SimulationParameters &sim_params, const Cosmology &cosmology);
+
+	/// @return The redshift of @p snapshot
+	double redshift(int snapshot) const
+	{
+		return at(snapshot).redshift;
+	}
+
+	/// @return The age of the universe at @p snapshot, in Gyr
+	double age(int snapshot) const
+	{
+		return at(snapshot).age;
+	}
+
+	/// @return The expansion factor at @p snapshot
+	double expansion_factor(int snapshot) const
+	{
+		return at(snapshot).expansion_factor;
+	}
+
+	/// @return The Hubble parameter at @p snapshot, in km/s/Mpc
+	double hubble_parameter(int snapshot) const
+	{
+		return at(snapshot).hubble_parameter;
+	}
+
+	/// @return The time elapsed between @p snapshot and the next one, in Gyr
+	double delta_t(int snapshot) const
+	{
+		return at(snapshot + 1).age - at(snapshot).age;
+	}
+
+	/// @return The present age of the universe (i.e., at z = 0), in Gyr
+	double present_age() const
+	{
+		return times.back().age;
+	}
+
+private:
+
+	struct snapshot_time {
+		double redshift;
+		double age;
+		double expansion_factor;
+		double hubble_parameter;
+	};
+
+	int first_snapshot;
+
+	/// The properties of each snapshot, followed by those of the present
+	std::vector<snapshot_time> times;
+
+	const snapshot_time &at(int snapshot) const
+	{
+		if (snapshot < first_snapshot) {
+			throw invalid_argument("snapshot " + std::to_string(snapshot) + " is before the first snapshot of the simulation");
+		}
+		auto idx = std::min(std::size_t(snapshot - first_snapshot), times.size() - 1);
+		return times[idx];
+	}
+};
+
+/// Type to be used by users handling pointers to this class
+using SnapshotTimesPtr = std::shared_ptr<const SnapshotTimes>;
+
 class Simulation {
 
 public:
@@ -68,9 +157,16 @@ public:
 
 	double convert_snapshot_to_age(int s);
 
+	/// @return The table with the cosmic time properties of each snapshot
+	const SnapshotTimesPtr &get_snapshot_times() const
+	{
+		return snapshot_times;
+	}
+
 private:
 	SimulationParameters parameters;
 	CosmologyPtr cosmology;
+	SnapshotTimesPtr snapshot_times;
 
 
 };
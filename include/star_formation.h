@@ -26,12 +26,16 @@
 #ifndef INCLUDE_STAR_FORMATION_H_
 #define INCLUDE_STAR_FORMATION_H_
 
+#include <array>
 #include <memory>
 
+#include "components.h"
 #include "cosmology.h"
 #include "integrator.h"
+#include "numerical_constants.h"
 #include "options.h"
 #include "recycling.h"
+#include "star_formation_kernel_table.h"
 
 namespace shark {
 
@@ -52,6 +56,7 @@ public:
 	 * clump_factor_KMT09: clumping factor of the ISM for the Krumholz+ models.
 	 * sigma_crit_KMT09: critical gas surface density above which the SF law becomes superlinear in the KMT09 model.
 	 * angular_momentum_transfer: boolean parameter indicating whether the user wants to trigger the calculation of angular momentum transfer within the disk.
+	 * tabulate_kernels: boolean parameter indicating whether the SFR integrals should be looked up in a table built at startup, falling back to exact integration where the table is not accurate enough.
 	 *
 	 */
 	enum StarFormationModel {
@@ -74,21 +79,37 @@ public:
 	double sigma_crit_KMT09 = 0;
 
 	bool angular_momentum_transfer = false;
+	bool tabulate_kernels = false;
 };
 
+struct galaxy_properties_for_integration;
+
+/**
+ * The inputs and outputs of the star formation rate calculation of a batch of
+ * up to @p W galaxies, one element per galaxy. See
+ * StarFormation::star_formation_rate for the meaning of each of them.
+ */
+template <std::size_t W>
+struct star_formation_batch {
+	using lanes = std::array<double, W>;
+	lanes mcold;
+	lanes mstars;
+	lanes rgas;
+	lanes rstars;
+	lanes zgas;
+	lanes z;
+	std::array<bool, W> burst;
+	lanes vgal;
+	lanes jgas;
+	lanes jrate;
+	lanes sfr;
+};
 
 class StarFormation {
 
 public:
 
-	struct molecular_gas {
-		double m_mol;
-		double m_atom;
-		double m_mol_b;
-		double m_atom_b;
-		double j_mol;
-		double j_atom;
-	};
+	using molecular_gas = MolecularGas;
 
 	StarFormation(StarFormationParameters parameters, RecyclingParameters recycleparams, CosmologyPtr cosmology);
 
@@ -100,6 +121,18 @@ public:
 	double star_formation_rate(double mcold, double mstars, double rgas, double rstars, double zgas, double z,
 							   bool burst, double vgal, double &jrate, double jgas);
 
+	/**
+	 * Calculates the star formation rate (and angular momentum transfer rate) of
+	 * the first @p n_galaxies galaxies of @p batch that are set in @p mask
+	 * and whose kernels can be looked up in the kernel table, giving the same
+	 * results as star_formation_rate. Galaxies that would need an integration
+	 * are left untouched, and should be given to star_formation_rate instead.
+	 *
+	 * @return The galaxies whose star formation rate was calculated
+	 */
+	template <std::size_t W>
+	std::array<bool, W> tabulated_star_formation_rates(const std::array<bool, W> &mask, std::size_t n_galaxies, star_formation_batch<W> &batch) const;
+
 	double star_formation_rate_surface_density(double r, void * params) const;
 
 	double manual_integral(func_t f, void * params, double rmin, double rmax);
@@ -135,11 +168,54 @@ private:
 	RecyclingParameters recycleparams;
 	CosmologyPtr cosmology;
 	Integrator integrator;
+	std::shared_ptr<const StarFormationKernelTable> kernel_table;
+
+	std::shared_ptr<const StarFormationKernelTable> make_kernel_table();
+	bool kernel_coordinates(const galaxy_properties_for_integration &props, StarFormationKernelTable::point &x) const;
+	bool exact_kernels(Integrator &kernel_integrator, const StarFormationKernelTable::point &x, StarFormationKernelTable::kernels &values) const;
+	bool lookup_kernels(double Sigma_gas, double Sigma_star, double re, double rse, double zgas, bool burst, StarFormationKernelTable::kernels &kernels) const;
+
+	/// Turns the physical SFR and angular momentum integrals of a galaxy into
+	/// its comoving SFR, which is returned, and angular momentum transfer rate
+	double comoving_rates(double mcold, double result, double jSFR, bool burst, double vgal, double jgas, double &jrate) const;
 
 };
 
-/// A collection of galaxy-indexed molecular gas objects
-using molgas_per_galaxy = std::map<GalaxyPtr, StarFormation::molecular_gas>;
+template <std::size_t W>
+std::array<bool, W> StarFormation::tabulated_star_formation_rates(const std::array<bool, W> &mask, std::size_t n_galaxies, star_formation_batch<W> &batch) const
+{
+	std::array<bool, W> tabulated {};
+	if (!kernel_table) {
+		return tabulated;
+	}
+
+	// Physical properties of all galaxies, as in star_formation_rate
+	typename star_formation_batch<W>::lanes re, rse, Sigma_gas, Sigma_star;
+	const double h = cosmology->parameters.Hubble_h;
+	for (std::size_t l = 0; l != n_galaxies; l++) {
+		re[l] = batch.rgas[l] / constants::RDISK_HALF_SCALE / h;
+		rse[l] = batch.rstars[l] / constants::RDISK_HALF_SCALE / h;
+		Sigma_gas[l] = batch.mcold[l] / h / constants::PI2 / (re[l] * re[l]);
+		Sigma_star[l] = (batch.mstars[l] > 0 && batch.rstars[l] > 0) ? batch.mstars[l] / h / constants::PI2 / (rse[l] * rse[l]) : 0;
+	}
+
+	// Galaxies without gas, or with invalid sizes, are left to star_formation_rate
+	StarFormationKernelTable::kernels kernels;
+	for (std::size_t l = 0; l != n_galaxies; l++) {
+		if (!mask[l] || !(batch.mcold[l] > constants::EPS3 && batch.rgas[l] > constants::tolerance) ||
+		    !lookup_kernels(Sigma_gas[l], Sigma_star[l], re[l], rse[l], batch.zgas[l], batch.burst[l], kernels)) {
+			continue;
+		}
+		tabulated[l] = true;
+		double result = kernels[0] * Sigma_gas[l] * re[l] * re[l];
+		double jSFR = kernels[1] * Sigma_gas[l] * re[l] * re[l] * re[l];
+		if (batch.burst[l]) {
+			result *= parameters.boost_starburst;
+		}
+		batch.sfr[l] = comoving_rates(batch.mcold[l], result, jSFR, batch.burst[l], batch.vgal[l], batch.jgas[l], batch.jrate[l]);
+	}
+	return tabulated;
+}
 
 }  // namespace shark
 
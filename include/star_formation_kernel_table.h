@@ -0,0 +1,120 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Header file for the StarFormationKernelTable class
+ */
+
+#ifndef SHARK_STAR_FORMATION_KERNEL_TABLE_H_
+#define SHARK_STAR_FORMATION_KERNEL_TABLE_H_
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace shark {
+
+/**
+ * A table of precomputed star formation kernels, regularly sampled over up to
+ * three dimensionless galaxy parameters, and looked up with multilinear
+ * interpolation.
+ *
+ * The kernels are the dimensionless integrals of the star formation rate
+ * surface density (and of the radius times the surface density) over an
+ * exponential disk. They are positive, and span many orders of magnitude,
+ * so their logarithm is stored and interpolated instead.
+ *
+ * After sampling the table, each cell is checked by evaluating the kernels
+ * exactly at its centre and at the midpoints of its edges, halfway between
+ * nodes. Cells where the interpolated values differ from the exact ones at any
+ * of these points by more than the requested relative accuracy are flagged, and
+ * lookups falling on them (or outside the table) fail. Users should then
+ * resort to the exact calculation.
+ */
+class StarFormationKernelTable {
+
+public:
+
+	static constexpr std::size_t NDIMS = 3;
+
+	/// A point in parameter space
+	using point = std::array<double, NDIMS>;
+
+	/// The star formation rate and angular momentum kernels
+	using kernels = std::array<double, 2>;
+
+	/// A function that calculates the exact kernels at a point, returning false on failure
+	using kernel_evaluator = std::function<bool(const point &, kernels &)>;
+
+	/// A regularly sampled axis of the table. Axes with a single node are ignored
+	struct axis {
+		double min;
+		double max;
+		std::size_t n_nodes;
+	};
+
+	/**
+	 * Creates a new table by sampling @p evaluator on all its nodes.
+	 *
+	 * @param axes The axes of the table
+	 * @param evaluator The function calculating the exact kernels
+	 * @param accuracy The maximum relative error allowed on the cells of the table
+	 */
+	StarFormationKernelTable(const std::array<axis, NDIMS> &axes, const kernel_evaluator &evaluator, double accuracy);
+
+	/**
+	 * Looks up the kernels at point @p x.
+	 *
+	 * @param x The point at which kernels should be looked up
+	 * @param values The kernels at @p x
+	 * @return Whether the kernels could be looked up with the table's accuracy
+	 */
+	bool lookup(const point &x, kernels &values) const;
+
+	/// @return The total number of cells in this table
+	std::size_t cell_count() const {
+		return accurate_cells.size();
+	}
+
+	/// @return The number of cells in this table that can be used for lookups
+	std::size_t accurate_cell_count() const;
+
+private:
+	std::array<axis, NDIMS> axes;
+	std::array<double, NDIMS> steps;
+	std::array<std::size_t, NDIMS> n_cells;
+	std::vector<kernels> log_values;
+	std::vector<bool> accurate_cells;
+
+	using index = std::array<std::size_t, NDIMS>;
+
+	std::size_t node_offset(const index &node) const;
+	std::size_t cell_offset(const index &cell) const;
+	bool interpolate(const index &cell, const point &fraction, kernels &values) const;
+	void check_edge(const index &node, std::size_t dim, const kernel_evaluator &evaluator, double accuracy);
+
+};
+
+}  // namespace shark
+
+#endif // SHARK_STAR_FORMATION_KERNEL_TABLE_H_
@@ -55,6 +55,11 @@ public:
 		return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - t0).count();
 	}
 
+	/// @return The point in time at which this timer was created
+	clock::time_point get_start() const {
+		return t0;
+	}
+
 private:
 	clock::time_point t0 {clock::now()};
 
@@ -0,0 +1,130 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Header file for the Tracer class
+ */
+
+#ifndef SHARK_TRACER_H_
+#define SHARK_TRACER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "timer.h"
+
+namespace shark {
+
+/**
+ * Records what each thread is doing over time, and writes it as a trace-event
+ * JSON file, which can be loaded into trace viewers like Perfetto or
+ * chrome://tracing.
+ *
+ * Events are recorded into a ring buffer of bounded size for each lane (one per
+ * thread, plus one for the thread writing outputs), so recording is cheap and
+ * memory usage bounded; if a buffer fills up its oldest events are dropped.
+ * Buffers grow as events are recorded, so lanes that record few events (or
+ * none) don't use the memory of a full buffer.
+ * Each lane must be recorded into by a single thread at a time.
+ */
+class Tracer {
+
+public:
+
+	/// Marks events without an argument
+	static constexpr std::int64_t NO_ARG = -1;
+
+	/**
+	 * Creates a new Tracer.
+	 *
+	 * @param threads The number of threads whose events are recorded
+	 * @param buffer_size The maximum number of events kept for each lane
+	 */
+	Tracer(unsigned int threads, std::size_t buffer_size);
+
+	/**
+	 * Records an event that started when @p t was created, and ends now.
+	 *
+	 * @param lane The lane to record the event into, usually the thread index
+	 * @param name The name of the event, which must be a string literal
+	 * @param t The timer measuring the event
+	 * @param arg An optional argument shown with the event (e.g., an ID)
+	 */
+	void record(unsigned int lane, const char *name, const Timer &t, std::int64_t arg = NO_ARG)
+	{
+		auto &buffer = lanes[lane];
+		event e {name, arg, t.get_start(), Timer::clock::now()};
+		if (buffer.events.size() < buffer_size) {
+			buffer.events.push_back(e);
+			return;
+		}
+		buffer.events[buffer.next] = e;
+		buffer.wrapped = true;
+		if (++buffer.next == buffer_size) {
+			buffer.next = 0;
+		}
+	}
+
+	/// @return The lane where events of the thread writing outputs are recorded
+	unsigned int writer_lane() const
+	{
+		return threads;
+	}
+
+	/**
+	 * Writes all the recorded events into @p filename as a trace-event JSON file.
+	 *
+	 * @param filename The name of the file to write
+	 */
+	void write(const std::string &filename) const;
+
+private:
+
+	struct event {
+		const char *name;
+		std::int64_t arg;
+		Timer::clock::time_point start;
+		Timer::clock::time_point end;
+	};
+
+	struct lane_events {
+		std::vector<event> events;
+		std::size_t next;
+		bool wrapped;
+		// Keeps the lanes of different threads in different cache lines
+		char padding[64];
+	};
+
+	unsigned int threads;
+	std::size_t buffer_size;
+	Timer::clock::time_point origin;
+	std::vector<lane_events> lanes;
+};
+
+/// Type used by the rest of the code to handle Tracer instances
+using TracerPtr = std::shared_ptr<Tracer>;
+
+}  // namespace shark
+
+#endif // SHARK_TRACER_H_
@@ -47,21 +47,23 @@ public:
 protected:
 
 	ExecutionParameters &get_exec_params();
+	unsigned int get_threads() const;
 
 	virtual void loop_through_halos(const std::vector<HaloPtr> &halos) = 0;
 
 	void link(const SubhaloPtr &parent_shalo, const SubhaloPtr &desc_subhalo,
 	          const HaloPtr &parent_halo, const HaloPtr &desc_halo);
 
+	void define_accretion_rate_from_dm(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params, GasCoolingParameters &gas_cooling_params, Cosmology &cosmology, TotalBaryon &AllBaryons);
+	void define_ages_halos(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params);
+
 private:
 	void ensure_trees_are_self_contained(const std::vector<MergerTreePtr> &trees) const;
 	void ensure_halo_mass_growth(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params);
 	void spin_interpolated_halos(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params);
 	void define_central_subhalos(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params);
 	SubhaloPtr define_central_subhalo(HaloPtr &halo, SubhaloPtr &subhalo);
-	void define_accretion_rate_from_dm(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params, GasCoolingParameters &gas_cooling_params, Cosmology &cosmology, TotalBaryon &AllBaryons);
 	void remove_satellite(HaloPtr &halo, SubhaloPtr &subhalo);
-	void define_ages_halos(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params);
 
 private:
 	ExecutionParameters exec_params;
@@ -0,0 +1,138 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Header file for the TreeCache class
+ */
+
+#ifndef SHARK_TREE_CACHE_H_
+#define SHARK_TREE_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "binary_buffer.h"
+#include "components.h"
+#include "dark_matter_halos.h"
+#include "execution.h"
+#include "options.h"
+#include "simulation.h"
+
+namespace shark {
+
+/**
+ * A persistent, on-disk cache of fully built merger trees.
+ *
+ * Reading the merger tree files and building the trees out of them doesn't
+ * depend on the physical model, so runs that only change physical parameters
+ * (e.g., when calibrating the model) can reuse the trees built by a previous
+ * run. Trees are stored in a versioned binary file whose name derives from
+ * a key. The key describes everything the trees depend on: the tree files
+ * (including their sizes and modification times), the snapshots being
+ * considered, and the simulation, cosmology and dark matter halo options.
+ * Files with a different key or version are never loaded, so changing any of
+ * the inputs automatically invalidates previously cached trees.
+ *
+ * Only the properties that are set while building the trees are stored;
+ * galaxies and baryonic reservoirs are created afterwards by each run.
+ */
+class TreeCache {
+
+public:
+
+	/// The version of the on-disk format, increased on every layout change
+	static constexpr std::uint32_t VERSION = 1;
+
+	/**
+	 * Creates a new TreeCache.
+	 *
+	 * @param directory The directory where cached trees are stored
+	 * @param key A description of the inputs the cached trees depend on
+	 */
+	TreeCache(const std::string &directory, std::string key);
+
+	/**
+	 * Loads the trees cached for our key, if any.
+	 *
+	 * @param AllBaryons Where the baryons created during tree building are recorded
+	 * @return The cached trees, or an empty vector if none is available
+	 */
+	std::vector<MergerTreePtr> load(TotalBaryon &AllBaryons) const;
+
+	/**
+	 * Stores @p trees in the cache. The file is written under a temporary name
+	 * first, so concurrent runs never see a partially written file.
+	 *
+	 * @param trees The fully built trees
+	 * @param AllBaryons The baryons created during tree building
+	 */
+	void save(const std::vector<MergerTreePtr> &trees, const TotalBaryon &AllBaryons) const;
+
+	/// @return The name of the file where trees are cached
+	const std::string &get_filename() const
+	{
+		return filename;
+	}
+
+private:
+	std::string key;
+	std::string filename;
+};
+
+/**
+ * Serialises the structure of @p trees, i.e., the properties of their halos
+ * and subhalos set while building the trees, and the links between them.
+ *
+ * @param writer The buffer to write the trees into
+ * @param trees The merger trees to write
+ */
+void write_merger_trees(buffer_writer &writer, const std::vector<MergerTreePtr> &trees);
+
+/**
+ * Reads back merger trees serialised by write_merger_trees. Halos and
+ * subhalos are restored in the order in which they were written.
+ *
+ * @param reader The buffer to read the trees from
+ * @return The merger trees
+ */
+std::vector<MergerTreePtr> read_merger_trees(buffer_reader &reader);
+
+/**
+ * Builds the key identifying the merger trees built by a run out of
+ * @p tree_files.
+ *
+ * @param options All the options of the run
+ * @param exec_params The execution parameters of the run
+ * @param sim_params The simulation parameters of the run
+ * @param dark_matter_halo_params The dark matter halo parameters of the run
+ * @param tree_files The names of the merger tree files read by the run
+ * @return A description of all the inputs the built trees depend on
+ */
+std::string make_tree_cache_key(const Options &options,
+		const ExecutionParameters &exec_params,
+		const SimulationParameters &sim_params,
+		const DarkMatterHaloParameters &dark_matter_halo_params,
+		const std::vector<std::string> &tree_files);
+
+}  // namespace shark
+
+#endif // SHARK_TREE_CACHE_H_
@@ -274,6 +274,12 @@ detail::_nanoseconds_amount ns_time(std::chrono::nanoseconds::rep amount) {
 /// Returns the name of the computer executing this program
 std::string gethostname();
 
+/// Returns the resident set size of this process in bytes, or 0 if unknown
+std::size_t current_rss();
+
+/// Returns the peak resident set size of this process in bytes, or 0 if unknown
+std::size_t peak_rss();
+
 /// A class template for deleters that use a function to delete objects
 template<typename T, void (*F)(T *)>
 class deleter {
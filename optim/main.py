@@ -19,6 +19,7 @@
 # along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #
 import argparse
+import itertools
 import logging
 import math
 import multiprocessing
@@ -85,6 +86,12 @@ def _to_shark_options(particle, space):
         yield '%s=%s' % (name, value)
 
 
+def _common_shark_options(opts):
+    """Return an iterable with the shark options settings shared by all particles"""
+    if opts.tree_cache:
+        yield 'execution.tree_cache_directory=%s' % opts.tree_cache
+
+
 count = 0
 def run_shark_hpc(particles, *args):
     """
@@ -103,7 +110,7 @@ def run_shark_hpc(particles, *args):
     # to determine which values shark will be run for. We put a final \n so the
     # final line gets properly counted by wc (used by shark-submit)
     shark_options = [
-        ' '.join(['-o "%s"' % option for option in _to_shark_options(particle, space)])
+        ' '.join(['-o "%s"' % option for option in itertools.chain(_common_shark_options(opts), _to_shark_options(particle, space))])
         for particle in particles
     ]
     positions_fname = tempfile.mktemp('particle_positions.txt')
@@ -165,7 +172,7 @@ def run_shark(particle, *args):
     cmdline = [opts.shark_binary, opts.config,
                '-o', 'execution.output_directory=%s' % shark_output_base,
                '-o', 'execution.simulation_batches=%s' % ' '.join(map(str, subvols))]
-    for option in _to_shark_options(particle, space):
+    for option in itertools.chain(_common_shark_options(opts), _to_shark_options(particle, space)):
         cmdline += ['-o', option]
     _exec_shark('Executing shark instance', cmdline)
 
@@ -206,6 +213,8 @@ def main():
     parser.add_argument('-o', '--outdir', help='Auxiliary output directory, defaults to .', default=_abspath('.'),
                         type=_abspath)
     parser.add_argument('-k', '--keep', help='Keep temporary output files', action='store_true')
+    parser.add_argument('-T', '--tree-cache', help='Directory where shark caches the merger trees it builds, so they are built only once',
+                        default=None, type=_abspath)
 
     pso_opts = parser.add_argument_group('PSO options')
     pso_opts.add_argument('-s', '--swarm-size', help='Size of the particle swarm. Defaults to 10 + sqrt(D) * 2 (D=number of dimensions)',
@@ -0,0 +1,78 @@
+#
+# Read one or more metrics files written by shark (execution.write_metrics)
+# and spit out CSV content with high-level stats about each execution
+#
+# ICRAR - International Centre for Radio Astronomy Research
+# (c) UWA - The University of Western Australia, 2018
+# Copyright by UWA (in the framework of the ICRAR)
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+import argparse
+import json
+
+NS = 1e9
+
+
+def read_args():
+    """Return an argparse.Namespace object with the CLI arguments"""
+    arg_parser = argparse.ArgumentParser(
+        "Summarise the metrics files written by shark as CSV, one line per run."
+        )
+    arg_parser.add_argument('files', nargs='+', help='The metrics files to read.')
+    return arg_parser.parse_args()
+
+
+def read_runs(fname):
+    """Split the records of a metrics file into runs"""
+    runs = []
+    with open(fname) as f:
+        for line in f:
+            record = json.loads(line)
+            if record['type'] == 'run' or not runs:
+                runs.append([])
+            runs[-1].append(record)
+    return runs
+
+
+def summarise(records):
+    """Return the high-level stats of a single run"""
+    run = next((r for r in records if r['type'] == 'run'), {})
+    imports = [r for r in records if r['type'] == 'import']
+    snapshots = [r for r in records if r['type'] == 'snapshot']
+    finishes = [r for r in records if r['type'] == 'finish']
+    peak_rss = max([r['memory']['peak_rss'] for r in records if 'memory' in r] or [0])
+    return (
+        run.get('shark_version', ''),
+        run.get('threads', 0),
+        sum(r['total'] for r in imports) / NS,
+        sum(r['times']['evolution'] for r in snapshots) / NS,
+        # finish records include the outputs written after the last snapshot
+        sum(r['writing_jobs'] for r in finishes) / NS if finishes else
+        sum(r['times']['writing_jobs'] for r in snapshots) / NS,
+        peak_rss / 1024. ** 2
+    )
+
+
+def main():
+    args = read_args()
+    print('"version", "# threads", "import [s]", "evolution [s]", "io_write [s]", "peak_rss [MiB]", "filename"')
+    for fname in args.files:
+        for records in read_runs(fname):
+            print('"%s", %11d, %10.3f, %13.3f, %12.3f, %14.3f, "%s"' % (summarise(records) + (fname,)))
+
+
+if __name__ == '__main__':
+    main()
@@ -3,6 +3,9 @@
 # Read one or more files containing the output logs from shark execution
 # and spits out CSV content with high-level stats about the execution
 #
+# Runs writing metrics files (execution.write_metrics) can be summarised
+# more reliably with metrics_stats.py, which doesn't depend on log messages
+#
 # ICRAR - International Centre for Radio Astronomy Research
 # (c) UWA - The University of Western Australia, 2018
 # Copyright by UWA (in the framework of the ICRAR)
@@ -0,0 +1,71 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Implementation of the Arena class
+ */
+
+#include <cstdint>
+
+#include "arena.h"
+
+namespace shark {
+
+constexpr std::size_t Arena::DEFAULT_CHUNK_SIZE;
+
+Arena::Arena(std::size_t chunk_size) :
+	chunk_size(chunk_size),
+	current(nullptr),
+	remaining(0),
+	total_capacity(0)
+{
+}
+
+char *Arena::new_chunk(std::size_t size)
+{
+	chunks.emplace_back(new char[size]);
+	total_capacity += size;
+	return chunks.back().get();
+}
+
+void *Arena::allocate(std::size_t size, std::size_t alignment)
+{
+	auto padding = (alignment - reinterpret_cast<std::uintptr_t>(current) % alignment) % alignment;
+	if (current && padding + size <= remaining) {
+		auto ptr = current + padding;
+		current += padding + size;
+		remaining -= padding + size;
+		return ptr;
+	}
+
+	// Memory from new[] is suitably aligned for any fundamental type,
+	// which is what we support
+	if (size > chunk_size) {
+		return new_chunk(size);
+	}
+	current = new_chunk(chunk_size);
+	remaining = chunk_size - size;
+	auto ptr = current;
+	current += size;
+	return ptr;
+}
+
+}  // namespace shark
@@ -0,0 +1,70 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Implementation of the binary file reading and writing functions
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+#include "binary_buffer.h"
+#include "logging.h"
+
+namespace shark {
+
+bool read_binary_file(const std::string &filename, std::vector<char> &contents)
+{
+	std::ifstream f(filename, std::ios::binary);
+	if (!f) {
+		return false;
+	}
+	contents.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	return true;
+}
+
+bool write_binary_file(const std::string &filename, const std::vector<char> &data)
+{
+	auto tmp_filename = filename + ".tmp." + std::to_string(std::random_device()());
+	{
+		std::ofstream f(tmp_filename, std::ios::binary | std::ios::trunc);
+		f.write(data.data(), data.size());
+		if (!f) {
+			std::remove(tmp_filename.c_str());
+			LOG(warning) << "Error while writing " << tmp_filename;
+			return false;
+		}
+	}
+	if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+		// Some platforms don't allow renaming over an existing file
+		std::remove(filename.c_str());
+		if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+			std::remove(tmp_filename.c_str());
+			LOG(warning) << "Cannot move " << tmp_filename << " into " << filename;
+			return false;
+		}
+	}
+	return true;
+}
+
+}  // namespace shark
@@ -0,0 +1,504 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Implementation of the Checkpoint class
+ */
+
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+
+#include "arena.h"
+#include "binary_buffer.h"
+#include "checkpoint.h"
+#include "exceptions.h"
+#include "logging.h"
+#include "timer.h"
+#include "tree_cache.h"
+#include "utils.h"
+
+namespace shark {
+
+constexpr std::uint32_t Checkpoint::VERSION;
+
+namespace {
+
+const char TREES_MAGIC[8] = {'S', 'H', 'A', 'R', 'K', 'C', 'K', 'T'};
+const char STATE_MAGIC[8] = {'S', 'H', 'A', 'R', 'K', 'C', 'K', 'S'};
+const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+void write_header(buffer_writer &writer, const char (&magic)[8], const std::string &key)
+{
+	for (auto c: magic) {
+		writer.write(c);
+	}
+	writer.write(Checkpoint::VERSION);
+	writer.write(BYTE_ORDER_MARK);
+	writer.write(key);
+}
+
+bool read_header(buffer_reader &reader, const char (&magic)[8], const std::string &key)
+{
+	for (auto c: magic) {
+		if (reader.read<char>() != c) {
+			return false;
+		}
+	}
+	return reader.read<std::uint32_t>() == Checkpoint::VERSION &&
+	       reader.read<std::uint32_t>() == BYTE_ORDER_MARK &&
+	       reader.read_string() == key;
+}
+
+// save/restore pairs for all the evolving components
+
+template <typename T>
+typename std::enable_if<std::is_arithmetic<T>::value>::type
+save(buffer_writer &writer, const T &value)
+{
+	writer.write(value);
+}
+
+template <typename T>
+typename std::enable_if<std::is_arithmetic<T>::value>::type
+restore(buffer_reader &reader, T &value)
+{
+	value = reader.read<T>();
+}
+
+void save(buffer_writer &writer, const BaryonBase &baryon)
+{
+	writer.write(baryon.mass);
+	writer.write(baryon.mass_metals);
+}
+
+void restore(buffer_reader &reader, BaryonBase &baryon)
+{
+	restore(reader, baryon.mass);
+	restore(reader, baryon.mass_metals);
+}
+
+void save(buffer_writer &writer, const Baryon &baryon)
+{
+	save(writer, static_cast<const BaryonBase &>(baryon));
+	writer.write(baryon.rscale);
+	writer.write(baryon.sAM);
+}
+
+void restore(buffer_reader &reader, Baryon &baryon)
+{
+	restore(reader, static_cast<BaryonBase &>(baryon));
+	restore(reader, baryon.rscale);
+	restore(reader, baryon.sAM);
+}
+
+void save(buffer_writer &writer, const BlackHole &smbh)
+{
+	save(writer, static_cast<const BaryonBase &>(smbh));
+	writer.write(smbh.macc_hh);
+	writer.write(smbh.macc_sb);
+}
+
+void restore(buffer_reader &reader, BlackHole &smbh)
+{
+	restore(reader, static_cast<BaryonBase &>(smbh));
+	restore(reader, smbh.macc_hh);
+	restore(reader, smbh.macc_sb);
+}
+
+void save(buffer_writer &writer, const HistoryItem &item)
+{
+	writer.write(item.sfr_disk);
+	writer.write(item.sfr_bulge_mergers);
+	writer.write(item.sfr_bulge_diskins);
+	writer.write(item.sfr_z_disk);
+	writer.write(item.sfr_z_bulge_mergers);
+	writer.write(item.sfr_z_bulge_diskins);
+	writer.write(item.snapshot);
+}
+
+void restore(buffer_reader &reader, HistoryItem &item)
+{
+	restore(reader, item.sfr_disk);
+	restore(reader, item.sfr_bulge_mergers);
+	restore(reader, item.sfr_bulge_diskins);
+	restore(reader, item.sfr_z_disk);
+	restore(reader, item.sfr_z_bulge_mergers);
+	restore(reader, item.sfr_z_bulge_diskins);
+	restore(reader, item.snapshot);
+}
+
+template <typename T>
+void save(buffer_writer &writer, const std::vector<T> &values)
+{
+	writer.write(std::uint64_t(values.size()));
+	for (auto &value: values) {
+		save(writer, value);
+	}
+}
+
+template <typename T>
+void restore(buffer_reader &reader, std::vector<T> &values)
+{
+	values.resize(reader.read<std::uint64_t>());
+	for (auto &value: values) {
+		restore(reader, value);
+	}
+}
+
+void save(buffer_writer &writer, const std::map<int, double> &values)
+{
+	writer.write(std::uint64_t(values.size()));
+	for (auto &key_and_value: values) {
+		writer.write(key_and_value.first);
+		writer.write(key_and_value.second);
+	}
+}
+
+void restore(buffer_reader &reader, std::map<int, double> &values)
+{
+	values.clear();
+	auto size = reader.read<std::uint64_t>();
+	for (std::uint64_t i = 0; i != size; i++) {
+		auto key = reader.read<int>();
+		values[key] = reader.read<double>();
+	}
+}
+
+void save(buffer_writer &writer, const CoolingSubhaloTracking &tracking)
+{
+	writer.write(tracking.integral);
+	writer.write(tracking.rheat);
+}
+
+void restore(buffer_reader &reader, CoolingSubhaloTracking &tracking)
+{
+	restore(reader, tracking.integral);
+	restore(reader, tracking.rheat);
+}
+
+void save(buffer_writer &writer, const Galaxy &galaxy)
+{
+	writer.write(galaxy.id);
+	writer.write(galaxy.descendant_id);
+	writer.write(std::int32_t(galaxy.galaxy_type));
+	save(writer, galaxy.bulge_stars);
+	save(writer, galaxy.bulge_gas);
+	save(writer, galaxy.disk_stars);
+	save(writer, galaxy.disk_gas);
+	save(writer, galaxy.galaxymergers_burst_stars);
+	save(writer, galaxy.galaxymergers_assembly_stars);
+	save(writer, galaxy.diskinstabilities_burst_stars);
+	save(writer, galaxy.diskinstabilities_assembly_stars);
+	save(writer, galaxy.smbh);
+	writer.write(galaxy.sfr_disk);
+	writer.write(galaxy.sfr_bulge_mergers);
+	writer.write(galaxy.sfr_bulge_diskins);
+	writer.write(galaxy.sfr_z_disk);
+	writer.write(galaxy.sfr_z_bulge_mergers);
+	writer.write(galaxy.sfr_z_bulge_diskins);
+	writer.write(galaxy.mean_stellar_age);
+	writer.write(galaxy.total_stellar_mass_ever_formed);
+	writer.write(galaxy.vmax);
+	save(writer, galaxy.history);
+	writer.write(galaxy.interaction.major_mergers);
+	writer.write(galaxy.interaction.minor_mergers);
+	writer.write(galaxy.interaction.disk_instabilities);
+	writer.write(galaxy.molecular_gas.m_mol);
+	writer.write(galaxy.molecular_gas.m_atom);
+	writer.write(galaxy.molecular_gas.m_mol_b);
+	writer.write(galaxy.molecular_gas.m_atom_b);
+	writer.write(galaxy.molecular_gas.j_mol);
+	writer.write(galaxy.molecular_gas.j_atom);
+	writer.write(galaxy.tmerge);
+	writer.write(galaxy.concentration_type2);
+	writer.write(galaxy.msubhalo_type2);
+	writer.write(galaxy.vvir_type2);
+	writer.write(galaxy.lambda_type2);
+}
+
+GalaxyPtr restore_galaxy(buffer_reader &reader, const ArenaPtr &arena)
+{
+	auto galaxy = make_arena_shared<Galaxy>(arena, reader.read<Galaxy::id_t>());
+	restore(reader, galaxy->descendant_id);
+	galaxy->galaxy_type = Galaxy::galaxy_type_t(reader.read<std::int32_t>());
+	restore(reader, galaxy->bulge_stars);
+	restore(reader, galaxy->bulge_gas);
+	restore(reader, galaxy->disk_stars);
+	restore(reader, galaxy->disk_gas);
+	restore(reader, galaxy->galaxymergers_burst_stars);
+	restore(reader, galaxy->galaxymergers_assembly_stars);
+	restore(reader, galaxy->diskinstabilities_burst_stars);
+	restore(reader, galaxy->diskinstabilities_assembly_stars);
+	restore(reader, galaxy->smbh);
+	restore(reader, galaxy->sfr_disk);
+	restore(reader, galaxy->sfr_bulge_mergers);
+	restore(reader, galaxy->sfr_bulge_diskins);
+	restore(reader, galaxy->sfr_z_disk);
+	restore(reader, galaxy->sfr_z_bulge_mergers);
+	restore(reader, galaxy->sfr_z_bulge_diskins);
+	restore(reader, galaxy->mean_stellar_age);
+	restore(reader, galaxy->total_stellar_mass_ever_formed);
+	restore(reader, galaxy->vmax);
+	restore(reader, galaxy->history);
+	restore(reader, galaxy->interaction.major_mergers);
+	restore(reader, galaxy->interaction.minor_mergers);
+	restore(reader, galaxy->interaction.disk_instabilities);
+	restore(reader, galaxy->molecular_gas.m_mol);
+	restore(reader, galaxy->molecular_gas.m_atom);
+	restore(reader, galaxy->molecular_gas.m_mol_b);
+	restore(reader, galaxy->molecular_gas.m_atom_b);
+	restore(reader, galaxy->molecular_gas.j_mol);
+	restore(reader, galaxy->molecular_gas.j_atom);
+	restore(reader, galaxy->tmerge);
+	restore(reader, galaxy->concentration_type2);
+	restore(reader, galaxy->msubhalo_type2);
+	restore(reader, galaxy->vvir_type2);
+	restore(reader, galaxy->lambda_type2);
+	return galaxy;
+}
+
+void save(buffer_writer &writer, const Subhalo &subhalo)
+{
+	save(writer, subhalo.hot_halo_gas);
+	save(writer, subhalo.cold_halo_gas);
+	save(writer, subhalo.ejected_galaxy_gas);
+	save(writer, subhalo.lost_galaxy_gas);
+	save(writer, subhalo.cooling_subhalo_tracking);
+	writer.write(std::uint64_t(subhalo.galaxies.size()));
+	for (auto &galaxy: subhalo.galaxies) {
+		save(writer, *galaxy);
+	}
+}
+
+void restore(buffer_reader &reader, Subhalo &subhalo, const ArenaPtr &arena)
+{
+	restore(reader, subhalo.hot_halo_gas);
+	restore(reader, subhalo.cold_halo_gas);
+	restore(reader, subhalo.ejected_galaxy_gas);
+	restore(reader, subhalo.lost_galaxy_gas);
+	restore(reader, subhalo.cooling_subhalo_tracking);
+	auto n_galaxies = reader.read<std::uint64_t>();
+	subhalo.galaxies.clear();
+	for (std::uint64_t i = 0; i != n_galaxies; i++) {
+		subhalo.galaxies.emplace_back(restore_galaxy(reader, arena));
+	}
+}
+
+void save(buffer_writer &writer, const TotalBaryon &AllBaryons)
+{
+	save(writer, AllBaryons.mcold);
+	save(writer, AllBaryons.mstars);
+	save(writer, AllBaryons.mstars_burst_galaxymergers);
+	save(writer, AllBaryons.mstars_burst_diskinstabilities);
+	save(writer, AllBaryons.mhot_halo);
+	save(writer, AllBaryons.mcold_halo);
+	save(writer, AllBaryons.mejected_halo);
+	save(writer, AllBaryons.mlost_halo);
+	save(writer, AllBaryons.mBH);
+	save(writer, AllBaryons.mHI);
+	save(writer, AllBaryons.mH2);
+	save(writer, AllBaryons.mDM);
+	save(writer, AllBaryons.SFR_disk);
+	save(writer, AllBaryons.SFR_bulge);
+	save(writer, AllBaryons.max_BH);
+	save(writer, AllBaryons.major_mergers);
+	save(writer, AllBaryons.minor_mergers);
+	save(writer, AllBaryons.disk_instabil);
+	save(writer, AllBaryons.baryon_total_created);
+	save(writer, AllBaryons.baryon_total_lost);
+}
+
+void restore(buffer_reader &reader, TotalBaryon &AllBaryons)
+{
+	restore(reader, AllBaryons.mcold);
+	restore(reader, AllBaryons.mstars);
+	restore(reader, AllBaryons.mstars_burst_galaxymergers);
+	restore(reader, AllBaryons.mstars_burst_diskinstabilities);
+	restore(reader, AllBaryons.mhot_halo);
+	restore(reader, AllBaryons.mcold_halo);
+	restore(reader, AllBaryons.mejected_halo);
+	restore(reader, AllBaryons.mlost_halo);
+	restore(reader, AllBaryons.mBH);
+	restore(reader, AllBaryons.mHI);
+	restore(reader, AllBaryons.mH2);
+	restore(reader, AllBaryons.mDM);
+	restore(reader, AllBaryons.SFR_disk);
+	restore(reader, AllBaryons.SFR_bulge);
+	restore(reader, AllBaryons.max_BH);
+	restore(reader, AllBaryons.major_mergers);
+	restore(reader, AllBaryons.minor_mergers);
+	restore(reader, AllBaryons.disk_instabil);
+	restore(reader, AllBaryons.baryon_total_created);
+	restore(reader, AllBaryons.baryon_total_lost);
+}
+
+/// Calls @p f for all halos of @p trees at @p snapshot or later, always in the same order
+template <typename Callable>
+void for_each_halo_since(const std::vector<MergerTreePtr> &trees, int snapshot, Callable &&f)
+{
+	for (auto &tree: trees) {
+		for (auto &halo: tree->halos_since(snapshot)) {
+			f(*halo);
+		}
+	}
+}
+
+}  // anonymous namespace
+
+Checkpoint::Checkpoint(const std::string &directory, std::string key) :
+	key(std::move(key)),
+	trees_saved(std::make_shared<std::atomic<bool>>(false))
+{
+	std::ostringstream os;
+	os << directory << "/checkpoint_" << std::hex << std::setw(16) << std::setfill('0') << fnv1a(this->key);
+	trees_filename = os.str() + ".trees";
+	state_filename = os.str() + ".state";
+}
+
+int Checkpoint::load(std::vector<MergerTreePtr> &trees, TotalBaryon &AllBaryons)
+{
+	std::vector<char> contents;
+	if (!read_binary_file(state_filename, contents)) {
+		LOG(info) << "No checkpoint found at " << state_filename;
+		return -1;
+	}
+
+	Timer t;
+	buffer_reader state_reader(std::move(contents));
+	if (!read_header(state_reader, STATE_MAGIC, key)) {
+		LOG(warning) << "Checkpoint at " << state_filename << " was taken with different inputs, ignoring it";
+		return -1;
+	}
+	if (!read_binary_file(trees_filename, contents)) {
+		throw invalid_data("checkpoint " + state_filename + " has no merger trees file");
+	}
+	buffer_reader trees_reader(std::move(contents));
+	if (!read_header(trees_reader, TREES_MAGIC, key)) {
+		throw invalid_data("checkpoint " + state_filename + " has merger trees taken with different inputs");
+	}
+
+	auto restored_trees = read_merger_trees(trees_reader);
+	if (!trees_reader.finished()) {
+		throw invalid_data("checkpoint file " + trees_filename + " has unexpected trailing data");
+	}
+
+	auto snapshot = state_reader.read<int>();
+	TotalBaryon restored_baryons;
+	restore(state_reader, restored_baryons);
+
+	auto n_halos = state_reader.read<std::uint64_t>();
+	std::uint64_t n_restored_halos = 0;
+	auto arena = std::make_shared<Arena>();
+	for_each_halo_since(restored_trees, snapshot, [&](Halo &halo) {
+		if (n_restored_halos++ == n_halos) {
+			throw invalid_data("checkpoint file " + state_filename + " doesn't match its merger trees");
+		}
+		restore(state_reader, halo.cooling_rate);
+		for (auto &subhalo: halo.all_subhalos()) {
+			restore(state_reader, *subhalo, arena);
+		}
+	});
+	if (n_restored_halos != n_halos || !state_reader.finished()) {
+		throw invalid_data("checkpoint file " + state_filename + " doesn't match its merger trees");
+	}
+
+	trees = std::move(restored_trees);
+	AllBaryons = std::move(restored_baryons);
+	*trees_saved = true;
+	LOG(info) << "Loaded checkpoint for snapshot " << snapshot << " with " << trees.size()
+	          << " merger trees from " << state_filename << " in " << t;
+	return snapshot;
+}
+
+Checkpoint::writing_job Checkpoint::prepare_save(int snapshot, const std::vector<MergerTreePtr> &trees, const TotalBaryon &AllBaryons)
+{
+	Timer t;
+
+	// The structure of the trees doesn't change, so it's written only once
+	std::shared_ptr<buffer_writer> trees_writer;
+	if (!*trees_saved) {
+		trees_writer = std::make_shared<buffer_writer>();
+		write_header(*trees_writer, TREES_MAGIC, key);
+		write_merger_trees(*trees_writer, trees);
+	}
+
+	auto state_writer = std::make_shared<buffer_writer>();
+	write_header(*state_writer, STATE_MAGIC, key);
+	state_writer->write(snapshot);
+	save(*state_writer, AllBaryons);
+
+	std::uint64_t n_halos = 0;
+	for_each_halo_since(trees, snapshot, [&](const Halo &) {
+		n_halos++;
+	});
+	state_writer->write(n_halos);
+	for_each_halo_since(trees, snapshot, [&](const Halo &halo) {
+		state_writer->write(halo.cooling_rate);
+		for (auto &subhalo: halo.all_subhalos()) {
+			save(*state_writer, *subhalo);
+		}
+	});
+	LOG(info) << "Checkpoint for snapshot " << snapshot << " prepared in " << t;
+
+	// The job runs in the background, and must not refer to us
+	auto trees_written = trees_saved;
+	auto trees_fname = trees_filename;
+	auto state_fname = state_filename;
+	return [=]() {
+		Timer write_t;
+		if (trees_writer) {
+			if (!write_binary_file(trees_fname, trees_writer->data())) {
+				LOG(warning) << "Checkpoint for snapshot " << snapshot << " could not be written";
+				return;
+			}
+			*trees_written = true;
+		}
+		if (!write_binary_file(state_fname, state_writer->data())) {
+			LOG(warning) << "Checkpoint for snapshot " << snapshot << " could not be written";
+			return;
+		}
+		LOG(info) << "Checkpoint for snapshot " << snapshot << " written to " << state_fname
+		          << " (" << memory_amount(state_writer->data().size()) << ") in " << write_t;
+	};
+}
+
+std::string make_checkpoint_key(const Options &options, const ExecutionParameters &exec_params, const std::string &tree_key)
+{
+	std::ostringstream os;
+	os << tree_key;
+
+	// The checkpointing options themselves can change across restarts
+	const std::string checkpoint_options = "execution.checkpoint_";
+	for (auto &name_and_value: options.get_all()) {
+		if (name_and_value.first.compare(0, checkpoint_options.size(), checkpoint_options) == 0) {
+			continue;
+		}
+		os << name_and_value.first << " = " << name_and_value.second << "\n";
+	}
+	os << "seed " << exec_params.seed << "\n";
+	return os.str();
+}
+
+}  // namespace shark
@@ -34,7 +34,54 @@
 
 namespace shark {
 
-std::vector<HaloPtr> MergerTree::NONE;
+void MergerTree::add_halo(const HaloPtr &halo)
+{
+	auto snapshot = halo->snapshot;
+	if (halos.empty()) {
+		first_snapshot = snapshot;
+	}
+	else if (indexed && snapshot < last_snapshot()) {
+		indexed = false;
+	}
+	halos.push_back(halo);
+
+	// Halos are appended to the last snapshot (possibly a new one),
+	// so the index can be extended in place
+	if (indexed) {
+		while (last_snapshot() < snapshot) {
+			snapshot_offsets.push_back(std::uint32_t(halos.size() - 1));
+		}
+		snapshot_offsets.back() = std::uint32_t(halos.size());
+	}
+}
+
+void MergerTree::index_halos()
+{
+	if (indexed) {
+		return;
+	}
+
+	std::stable_sort(halos.begin(), halos.end(), [](const HaloPtr &h1, const HaloPtr &h2) {
+		return h1->snapshot < h2->snapshot;
+	});
+
+	first_snapshot = halos.front()->snapshot;
+	snapshot_offsets.assign(halos.back()->snapshot - first_snapshot + 2, 0);
+	for (auto &halo: halos) {
+		snapshot_offsets[halo->snapshot - first_snapshot + 1]++;
+	}
+	std::partial_sum(snapshot_offsets.begin(), snapshot_offsets.end(), snapshot_offsets.begin());
+	indexed = true;
+}
+
+void MergerTree::ensure_indexed() const
+{
+	if (!indexed) {
+		std::ostringstream os;
+		os << *this << " has halos that were added out of snapshot order, index_halos() must be called before accessing them";
+		throw invalid_data(os.str());
+	}
+}
 
 SubhaloPtr Subhalo::main() const
 {
@@ -234,25 +281,24 @@ void Subhalo::remove_galaxies(const std::vector<GalaxyPtr> &to_remove)
 	}
 }
 
-std::vector<SubhaloPtr> Halo::all_subhalos() const
+namespace {
+
+bool more_massive(const SubhaloPtr &lhs, const SubhaloPtr &rhs)
 {
+	return lhs->Mvir > rhs->Mvir;
+}
 
-	std::vector<SubhaloPtr> all;
+}  // namespace
 
+void Halo::update_subhalo_order()
+{
+	ordered_subhalos.clear();
+	ordered_subhalos.reserve(subhalo_count());
 	if (central_subhalo) {
-		all.push_back(central_subhalo);
+		ordered_subhalos.push_back(central_subhalo);
 	}
-	all.insert(all.end(), satellite_subhalos.begin(), satellite_subhalos.end());
-
-	// If there are more than one subhalo, then return them ordered by mass in decreasing order.
-	if(all.size() > 1){
-		std::sort(all.begin(), all.end(), [](const SubhaloPtr &lhs, const SubhaloPtr &rhs) {
-			return lhs->Mvir > rhs->Mvir;
-		});
-	}
-
-	assert(all.size() == satellite_subhalos.size() + (central_subhalo ? 1 : 0));
-	return all;
+	ordered_subhalos.insert(ordered_subhalos.end(), satellite_subhalos.begin(), satellite_subhalos.end());
+	std::stable_sort(ordered_subhalos.begin(), ordered_subhalos.end(), more_massive);
 }
 
 void Halo::add_subhalo(SubhaloPtr &&subhalo)
@@ -261,6 +307,11 @@ void Halo::add_subhalo(SubhaloPtr &&subhalo)
 	Mvir += subhalo->Mvir;
 	Mgas += subhalo->Mgas;
 
+	// Keep subhalos ordered by mass; subhalos with equal masses
+	// keep the order in which they were added
+	auto position = std::upper_bound(ordered_subhalos.begin(), ordered_subhalos.end(), subhalo, more_massive);
+	ordered_subhalos.insert(position, subhalo);
+
 	// Assign subhalo to proper member
 	if (subhalo->subhalo_type == Subhalo::CENTRAL) {
 		central_subhalo = std::move(subhalo);
@@ -273,6 +324,7 @@ void Halo::add_subhalo(SubhaloPtr &&subhalo)
 void Halo::remove_subhalo(const SubhaloPtr &subhalo)
 {
 	if (subhalo == central_subhalo) {
+		ordered_subhalos.erase(std::find(ordered_subhalos.begin(), ordered_subhalos.end(), subhalo));
 		central_subhalo.reset();
 		return;
 	}
@@ -281,6 +333,7 @@ void Halo::remove_subhalo(const SubhaloPtr &subhalo)
 	if (it == satellite_subhalos.end()) {
 		throw subhalo_not_found("subhalo not in satellites", subhalo->id);
 	}
+	ordered_subhalos.erase(std::find(ordered_subhalos.begin(), ordered_subhalos.end(), subhalo));
 	satellite_subhalos.erase(it);
 }
 
@@ -298,6 +351,16 @@ double Subhalo::total_baryon_mass() const
 	return mass;
 }
 
+void Subhalo::reset_baryons()
+{
+	galaxies.clear();
+	cooling_subhalo_tracking = CoolingSubhaloTracking();
+	hot_halo_gas = Baryon();
+	cold_halo_gas = Baryon();
+	ejected_galaxy_gas = Baryon();
+	lost_galaxy_gas = Baryon();
+}
+
 double Halo::total_baryon_mass() const
 {
 	double mass= 0.0;
@@ -309,6 +372,31 @@ double Halo::total_baryon_mass() const
 	return mass;
 }
 
+void Halo::reset_baryons()
+{
+	cooling_rate = 0;
+	for (auto &subhalo: all_subhalos()) {
+		subhalo->reset_baryons();
+	}
+}
+
+void MergerTree::release()
+{
+	for (auto &halo: halos) {
+		for (auto &subhalo: halo->all_subhalos()) {
+			subhalo->descendant.reset();
+			subhalo->ascendants.clear();
+			subhalo->host_halo.reset();
+		}
+		halo->descendant.reset();
+		halo->ascendants.clear();
+		halo->merger_tree.reset();
+	}
+	halos.clear();
+	snapshot_offsets.clear();
+	indexed = true;
+}
+
 galaxies_size_type Halo::galaxy_count() const
 {
 	galaxies_size_type count = 0;
@@ -104,9 +104,7 @@ DarkMatterHalos::DarkMatterHalos(
 	params(params),
 	cosmology(std::move(cosmology)),
 	sim_params(sim_params),
-	generator(exec_params.seed),
-	distribution(std::log(0.03), std::abs(std::log(0.5))),
-	flat_distribution(0,1)
+	seed(exec_params.seed)
 {
 	// no-op
 }
@@ -146,16 +144,19 @@ double DarkMatterHalos::halo_virial_radius(Subhalo &subhalo){
 	return constants::G * subhalo.Mvir / std::pow(subhalo.Vvir,2);
 }
 
-float DarkMatterHalos::halo_lambda (xyz<float> L, float m, double z, double npart){
+float DarkMatterHalos::halo_lambda (const Subhalo &subhalo, float m, double z, double npart){
 
 	//Spin parameter either read from the DM files or assumed a random distribution.
 	double H0 = 10.0* cosmology->hubble_parameter(z);
-        double lambda = L.norm() / m / 1.41421356237 / std::pow(constants::G * m, 0.666) * std::pow(H0,0.33);
+        double lambda = subhalo.L.norm() / m / 1.41421356237 / std::pow(constants::G * m, 0.666) * std::pow(H0,0.33);
 
 	if(lambda > 1){
 			lambda = 1;
 	}
 
+	// Drawn from the subhalo's own stream, so this is safe to call from any thread
+	philox_engine generator(seed, HALO_LAMBDA, subhalo.id);
+	std::lognormal_distribution<double> distribution(std::log(0.03), std::abs(std::log(0.5)));
 	auto lambda_random = distribution(generator);
 
 	// Avoid zero values. In that case assume small lambda value.
@@ -424,8 +425,10 @@ struct lambert_w0<double>
 	}
 };
 
-xyz<float> DarkMatterHalos::random_point_in_sphere(float r)
+xyz<float> DarkMatterHalos::random_point_in_sphere(float r, philox_engine &generator)
 {
+	std::uniform_real_distribution<float> flat_distribution(0, 1);
+
 	// We distribute cos_theta flatly instead of theta itself to end up with a
 	// more uniform distribution of points in the sphere
 	float cos_theta = flat_distribution(generator) * 2.0 - 1; //flat between -1 and 1.
@@ -439,7 +442,10 @@ xyz<float> DarkMatterHalos::random_point_in_sphere(float r)
 	};
 }
 
-void DarkMatterHalos::generate_random_orbits(xyz<float> &pos, xyz<float> &v, xyz<float> &L, double total_am, const HaloPtr &halo){
+void DarkMatterHalos::generate_random_orbits(xyz<float> &pos, xyz<float> &v, xyz<float> &L, double total_am, const HaloPtr &halo, const Galaxy &galaxy){
+
+	// Halo IDs are unique across snapshots, galaxy IDs are unique within a halo
+	philox_engine generator(seed, GALAXY_ORBITS, halo->id, galaxy.id);
 
 	double c = halo->concentration;
 
@@ -448,7 +454,7 @@ void DarkMatterHalos::generate_random_orbits(xyz<float> &pos, xyz<float> &v, xyz
 	// Assign positions based on an NFW halo of concentration c.
 	nfw_distribution<double> r(c);
 	double rproj = r(generator);
-	pos = halo->position + random_point_in_sphere(rvir * rproj);
+	pos = halo->position + random_point_in_sphere(rvir * rproj, generator);
 
 	// Assign velocities using NFW velocity dispersion at the radius in which the galaxy is and assuming isotropy.
 	double sigma = std::sqrt(0.333 * constants::G * halo->Mvir * enclosed_mass(rproj, c) / (rvir * rproj));
@@ -463,7 +469,7 @@ void DarkMatterHalos::generate_random_orbits(xyz<float> &pos, xyz<float> &v, xyz
 	v = halo->velocity + delta_v;
 
 	// Assign angular momentum based on random angles,
-	L = random_point_in_sphere(total_am);
+	L = random_point_in_sphere(total_am, generator);
 
 }
 
@@ -171,7 +171,7 @@ double DiskInstability::bulge_size(GalaxyPtr &galaxy){
 
 }
 
-void DiskInstability::create_starburst(SubhaloPtr &subhalo, GalaxyPtr &galaxy, double z, double delta_t){
+void DiskInstability::create_starburst(const SubhaloPtr &subhalo, GalaxyPtr &galaxy, double z, double delta_t){
 
 	// Trigger starburst only in case there is gas in the bulge.
 	if(galaxy->bulge_gas.mass > merger_params.mass_min){
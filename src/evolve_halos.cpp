@@ -154,8 +154,8 @@ void transfer_galaxies_to_next_snapshot(const std::vector<HaloPtr> &halos, int s
 
 }
 
-void track_total_baryons(Cosmology &cosmology, ExecutionParameters execparams, SimulationParameters simulation_params, const std::vector<HaloPtr> &halos,
-		TotalBaryon &AllBaryons, int snapshot, const molgas_per_galaxy &molgas, double deltat){
+void track_total_baryons(const SnapshotTimes &snapshot_times, ExecutionParameters execparams, const std::vector<HaloPtr> &halos,
+		TotalBaryon &AllBaryons, int snapshot, double deltat){
 
 
 	BaryonBase mcold_total;
@@ -180,10 +180,7 @@ void track_total_baryons(Cosmology &cosmology, ExecutionParameters execparams, S
 	int number_minor_mergers = 0;
 	int number_disk_instabil = 0;
 
-	double z1 = simulation_params.redshifts[snapshot];
-	double z2 = simulation_params.redshifts[snapshot+1];
-
-	double mean_age = 0.5 * (cosmology.convert_redshift_to_age(z1) + cosmology.convert_redshift_to_age(z2));
+	double mean_age = 0.5 * (snapshot_times.age(snapshot) + snapshot_times.age(snapshot+1));
 
 	// Loop over all halos and subhalos to write galaxy properties
 	for (auto &halo: halos){
@@ -229,7 +226,7 @@ void track_total_baryons(Cosmology &cosmology, ExecutionParameters execparams, S
 				}
         
 				//Accumulate galaxy baryons
-				auto &molecular_gas = molgas.at(galaxy);
+				auto &molecular_gas = galaxy->molecular_gas;
         
 				mHI_total.mass += molecular_gas.m_atom + molecular_gas.m_atom_b;
 				mH2_total.mass += molecular_gas.m_mol + molecular_gas.m_mol_b;
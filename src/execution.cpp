@@ -21,15 +21,20 @@
  * @file
  */
 
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <map>
+#include <sstream>
+#include <string>
 #include <tuple>
 
+#include "exceptions.h"
 #include "execution.h"
 
 namespace shark {
 
+constexpr unsigned int ExecutionParameters::MAX_ODE_BATCH_SIZE;
 
 ExecutionParameters::ExecutionParameters(const Options &options)
 {
@@ -42,19 +47,109 @@ ExecutionParameters::ExecutionParameters(const Options &options)
 	options.load("execution.ensure_mass_growth", ensure_mass_growth);
 
 	options.load("execution.ode_solver_precision", ode_solver_precision, true);
+	options.load("execution.ode_solver", ode_solver);
+	options.load("execution.ode_batch_size", ode_batch_size);
+	if (ode_batch_size == 0 || ode_batch_size > MAX_ODE_BATCH_SIZE) {
+		std::ostringstream os;
+		os << "execution.ode_batch_size must be between 1 and " << MAX_ODE_BATCH_SIZE;
+		throw invalid_option(os.str());
+	}
+	if (ode_batch_size > 1 && ode_solver != BUILTIN_RKCK) {
+		throw invalid_option("execution.ode_batch_size > 1 requires execution.ode_solver = builtin");
+	}
 	options.load("execution.name_model", name_model, true);
 	options.load("execution.seed", seed);
 
 	options.load("execution.output_sf_histories", output_sf_histories);
 	options.load("execution.snapshots_sf_histories", snapshots_sf_histories);
+
+	options.load("execution.async_output", async_output);
+	options.load("execution.output_queue_length", output_queue_length);
+	if (output_queue_length == 0) {
+		throw invalid_option("execution.output_queue_length must be greater than 0");
+	}
+
+	options.load("execution.tree_cache_directory", tree_cache_directory);
+	options.load("execution.stream_batches", stream_batches);
+	options.load("execution.profile_galaxies", profile_galaxies);
+	options.load("execution.write_metrics", write_metrics);
+	options.load("execution.trace", trace);
+	options.load("execution.trace_buffer_size", trace_buffer_size);
+	if (trace && trace_buffer_size == 0) {
+		throw invalid_option("execution.trace_buffer_size must be greater than 0");
+	}
+
+	options.load("execution.checkpoint_directory", checkpoint_directory);
+	options.load("execution.checkpoint_interval", checkpoint_interval);
+	if (!checkpoint_directory.empty()) {
+		if (checkpoint_interval == 0) {
+			throw invalid_option("execution.checkpoint_interval must be greater than 0");
+		}
+		// Resumed runs must draw the same random numbers
+		if (options.get_all().find("execution.seed") == options.get_all().end()) {
+			throw invalid_option("execution.checkpoint_directory requires execution.seed to be given");
+		}
+		if (stream_batches > 0) {
+			throw invalid_option("execution.checkpoint_directory cannot be used together with execution.stream_batches");
+		}
+	}
+}
+
+std::vector<std::vector<unsigned int>> ExecutionParameters::batch_groups() const
+{
+	if (stream_batches == 0) {
+		return {simulation_batches};
+	}
+
+	std::vector<std::vector<unsigned int>> groups;
+	for (std::size_t i = 0; i < simulation_batches.size(); i += stream_batches) {
+		auto end = std::min(simulation_batches.size(), std::size_t(i + stream_batches));
+		groups.emplace_back(simulation_batches.begin() + i, simulation_batches.begin() + end);
+	}
+	return groups;
+}
+
+std::string ExecutionParameters::batch_directory() const
+{
+	if (simulation_batches.size() == 1) {
+		return std::to_string(simulation_batches[0]);
+	}
+
+	// When streaming, each group of batches goes into its own directory
+	if (stream_batches == 0) {
+		return "multiple_batches";
+	}
+	std::ostringstream os;
+	for (std::size_t i = 0; i != simulation_batches.size(); i++) {
+		if (i > 0) {
+			os << "_";
+		}
+		os << simulation_batches[i];
+	}
+	return os.str();
+}
+
+template <>
+ExecutionParameters::ode_solver_t
+Options::get<ExecutionParameters::ode_solver_t>(const std::string &name, const std::string &value) const {
+	auto lvalue = lower(value);
+	if (lvalue == "gsl") {
+		return ExecutionParameters::GSL_RKCK;
+	}
+	else if (lvalue == "builtin") {
+		return ExecutionParameters::BUILTIN_RKCK;
+	}
+	std::ostringstream os;
+	os << name << " option value invalid: " << value << ". Supported values are gsl and builtin";
+	throw invalid_option(os.str());
 }
 
-bool ExecutionParameters::output_snapshot(int snapshot)
+bool ExecutionParameters::output_snapshot(int snapshot) const
 {
 	return output_snapshots.find(snapshot) != output_snapshots.end();
 }
 
-int ExecutionParameters::last_output_snapshot()
+int ExecutionParameters::last_output_snapshot() const
 {
 	return *output_snapshots.rbegin();
 }
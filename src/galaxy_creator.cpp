@@ -23,12 +23,19 @@
  * Galaxy creator class implementation
  */
 
+#include <memory>
+#include <vector>
+
 #include "galaxy_creator.h"
 #include "logging.h"
 #include "timer.h"
 
 namespace shark {
 
+// Galaxies are allocated from arenas together with their reference counts
+// and allocator, see make_arena_shared
+static constexpr std::size_t GALAXY_ALLOCATION_SIZE = sizeof(Galaxy) + 64;
+
 GalaxyCreator::GalaxyCreator(CosmologyPtr cosmology, GasCoolingParameters cool_params, SimulationParameters sim_params) :
 	cosmology(std::move(cosmology)),
 	cool_params(std::move(cool_params)),
@@ -44,11 +51,31 @@ void GalaxyCreator::create_galaxies(const std::vector<MergerTreePtr> &merger_tre
 
 	Galaxy::id_t galaxy_id = 0;
 	auto timer = Timer();
+
+	// The initial galaxies of each merger tree are allocated together from an
+	// arena sized to fit them, which is released in bulk once they are all gone
+	std::vector<ArenaPtr> arenas;
+	arenas.reserve(merger_trees.size());
+	for(auto &merger_tree: merger_trees) {
+		std::size_t n_galaxies = 0;
+		for(auto &halo: merger_tree->all_halos()) {
+			if (halo->snapshot >= sim_params.min_snapshot && halo->snapshot < sim_params.max_snapshot &&
+			    halo->central_subhalo->ascendants.empty()) {
+				n_galaxies++;
+			}
+		}
+		if (n_galaxies == 0) {
+			arenas.emplace_back();
+			continue;
+		}
+		arenas.emplace_back(std::make_shared<Arena>(n_galaxies * GALAXY_ALLOCATION_SIZE));
+	}
+
 	for(int snapshot = sim_params.min_snapshot; snapshot <= sim_params.max_snapshot - 1; snapshot++) {
 		auto z = sim_params.redshifts[snapshot];
-		for(auto &merger_tree: merger_trees) {
-			for(auto &halo: merger_tree->halos_at(snapshot)) {
-				if (create_galaxies(halo, z, galaxy_id)) {
+		for(std::size_t i = 0; i != merger_trees.size(); i++) {
+			for(auto &halo: merger_trees[i]->halos_at(snapshot)) {
+				if (create_galaxies(halo, z, galaxy_id, arenas[i])) {
 					galaxy_id++;
 					galaxies_added++;
 					total_baryon += halo->central_subhalo->hot_halo_gas.mass;
@@ -62,7 +89,7 @@ void GalaxyCreator::create_galaxies(const std::vector<MergerTreePtr> &merger_tre
 	LOG(info) << "Created " << galaxies_added << " initial galaxies in " << timer;
 }
 
-bool GalaxyCreator::create_galaxies(const HaloPtr &halo, double z, Galaxy::id_t galaxy_id)
+bool GalaxyCreator::create_galaxies(const HaloPtr &halo, double z, Galaxy::id_t galaxy_id, const ArenaPtr &arena)
 {
 
 	// Halo has a central subhalo with ascendants so ignore it, as it should already have galaxies in it.
@@ -87,7 +114,7 @@ bool GalaxyCreator::create_galaxies(const HaloPtr &halo, double z, Galaxy::id_t
 		throw invalid_argument(os.str());
 	}
 
-	auto galaxy = std::make_shared<Galaxy>(galaxy_id);
+	auto galaxy = make_arena_shared<Galaxy>(arena, galaxy_id);
 	galaxy->vmax = central_subhalo->Vcirc;
 
 
@@ -56,17 +56,18 @@ GalaxyMergers::GalaxyMergers(GalaxyMergerParameters parameters,
 		CosmologyPtr cosmology,
 		const ExecutionParameters &execparams,
 		SimulationParameters simparams,
+		SnapshotTimesPtr snapshot_times,
 		DarkMatterHalosPtr darkmatterhalo,
 		std::shared_ptr<BasicPhysicalModel> physicalmodel,
 		AGNFeedbackPtr agnfeedback) :
 	parameters(parameters),
 	cosmology(std::move(cosmology)),
 	simparams(std::move(simparams)),
+	snapshot_times(std::move(snapshot_times)),
 	darkmatterhalo(std::move(darkmatterhalo)),
 	physicalmodel(std::move(physicalmodel)),
 	agnfeedback(std::move(agnfeedback)),
-	generator(execparams.seed),
-	distribution(-0.14, 0.26)
+	seed(execparams.seed)
 {
 	// no-op
 }
@@ -84,7 +85,7 @@ void GalaxyMergers::orbital_parameters(double &vr, double &vt, double f){
 	vt = distribution(generator);
 }
 
-double GalaxyMergers::merging_timescale_orbital(){
+double GalaxyMergers::merging_timescale_orbital(const Subhalo &secondary, const Galaxy &galaxy){
 
 	/**
 	 * Uses function calculated in Lacey & Cole (1993), who found that it was best described by a log
@@ -93,6 +94,8 @@ double GalaxyMergers::merging_timescale_orbital(){
 
 	//TODO: add other dynamical friction timescales.
 
+	philox_engine generator(seed, MERGING_TIMESCALE, secondary.id, galaxy.id);
+	std::lognormal_distribution<double> distribution(-0.14, 0.26);
 	return distribution(generator);
 
 }
@@ -144,7 +147,7 @@ void GalaxyMergers::merging_timescale(SubhaloPtr &primary, SubhaloPtr &secondary
 				ms = galaxy->msubhalo_type2 + mgal;
 			}
 			double tau_mass = merging_timescale_mass(mp, ms);
-			double tau_orbits = merging_timescale_orbital();
+			double tau_orbits = merging_timescale_orbital(*secondary, *galaxy);
 
 			galaxy->tmerge = parameters.tau_delay * tau_mass * tau_orbits* tau_dyn;
 		}
@@ -153,12 +156,12 @@ void GalaxyMergers::merging_timescale(SubhaloPtr &primary, SubhaloPtr &secondary
 		}
 
 		//check if this galaxy will merge on the second consecutive snapshot instead, and if so, redefine their descendant_id.
-		double z1 = simparams.redshifts[snapshot+1];
-		double z2 = simparams.redshifts[snapshot+2];
+		double t1 = snapshot_times->age(snapshot+1);
+		double t2 = snapshot_times->age(snapshot+2);
 		if(snapshot+1 > simparams.max_snapshot){
-			z2 = 0;
+			t2 = snapshot_times->present_age();
 		}
-		double delta_t_next = cosmology->convert_redshift_to_age(z2) - cosmology->convert_redshift_to_age(z1);
+		double delta_t_next = t2 - t1;
 		if(galaxy->tmerge <= delta_t_next){
 			galaxy->descendant_id = primary->central_galaxy()->id;
 		}
@@ -323,12 +326,12 @@ void GalaxyMergers::merging_galaxies(HaloPtr &halo, int snapshot, double delta_t
 			else{
 				galaxy->tmerge = galaxy->tmerge - delta_t;
 				//check if this galaxy will merge on the second consecutive snapshot instead, and if so, redefine their descendant_id.
-				double z1 = simparams.redshifts[snapshot+1];
-				double z2 = simparams.redshifts[snapshot+2];
+				double t1 = snapshot_times->age(snapshot+1);
+				double t2 = snapshot_times->age(snapshot+2);
 				if(snapshot+1 > simparams.max_snapshot){
-					z2 = 0;
+					t2 = snapshot_times->present_age();
 				}
-				double delta_t_next = cosmology->convert_redshift_to_age(z2) - cosmology->convert_redshift_to_age(z1);
+				double delta_t_next = t2 - t1;
 				if(galaxy->tmerge <= delta_t_next){
 					galaxy->descendant_id = central_galaxy->id;
 				}
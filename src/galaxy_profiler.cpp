@@ -0,0 +1,185 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Implementation of the per-galaxy profiling functions
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <tuple>
+
+#include <boost/filesystem.hpp>
+
+#include "exceptions.h"
+#include "galaxy_profiler.h"
+#include "hdf5/writer.h"
+#include "logging.h"
+#include "utils.h"
+
+namespace shark {
+
+log_histogram make_log_histogram(const std::vector<double> &values, unsigned int bins_per_decade)
+{
+	if (bins_per_decade == 0) {
+		throw invalid_argument("bins_per_decade must be positive");
+	}
+
+	log_histogram histogram;
+	auto to_bin = [bins_per_decade](double value) {
+		return int(std::floor(std::log10(value) * bins_per_decade));
+	};
+
+	int min_bin = 0, max_bin = -1;
+	for (auto value: values) {
+		if (!(value > 0)) {
+			histogram.non_positive++;
+			continue;
+		}
+		auto bin = to_bin(value);
+		if (max_bin < min_bin) {
+			min_bin = max_bin = bin;
+		}
+		min_bin = std::min(min_bin, bin);
+		max_bin = std::max(max_bin, bin);
+	}
+
+	if (max_bin < min_bin) {
+		return histogram;
+	}
+
+	histogram.counts.resize(max_bin - min_bin + 1);
+	for (auto value: values) {
+		if (value > 0) {
+			histogram.counts[to_bin(value) - min_bin]++;
+		}
+	}
+	for (int bin = min_bin; bin <= max_bin + 1; bin++) {
+		histogram.bin_edges.push_back(std::pow(10., double(bin) / bins_per_decade));
+	}
+	return histogram;
+}
+
+double top_share(std::vector<double> values, double fraction)
+{
+	if (values.empty()) {
+		return 0;
+	}
+
+	auto n_top = std::min(values.size(), std::max(std::size_t(1), std::size_t(std::ceil(fraction * values.size()))));
+	std::nth_element(values.begin(), values.begin() + (n_top - 1), values.end(), std::greater<double>());
+	auto top = std::accumulate(values.begin(), values.begin() + n_top, 0.);
+	auto total = std::accumulate(values.begin() + n_top, values.end(), top);
+	if (total <= 0) {
+		return 0;
+	}
+	return top / total;
+}
+
+namespace {
+
+template <typename T, typename F>
+std::vector<T> column(const std::vector<galaxy_cost> &costs, F &&f)
+{
+	std::vector<T> values;
+	values.reserve(costs.size());
+	for (auto &cost: costs) {
+		values.push_back(T(f(cost)));
+	}
+	return values;
+}
+
+void write_histogram(hdf5::Writer &file, const std::string &name, const std::vector<double> &values, const std::string &what)
+{
+	auto histogram = make_log_histogram(values, 10);
+	std::vector<std::int64_t> counts(histogram.counts.begin(), histogram.counts.end());
+	file.write_dataset("histograms/" + name + "/bin_edges", histogram.bin_edges, "Edges of the logarithmic bins of " + what + ", 10 per decade");
+	file.write_dataset("histograms/" + name + "/counts", counts, "Number of galaxy integrations per bin of " + what);
+	file.write_dataset("histograms/" + name + "/non_positive", std::int64_t(histogram.non_positive), "Number of galaxy integrations with no " + what);
+}
+
+}  // anonymous namespace
+
+void write_galaxy_costs(const std::string &filename, int snapshot, double redshift, std::vector<galaxy_cost> costs)
+{
+	// Threads record costs in whichever order they evolve galaxies;
+	// a stable sort keeps the relative order of the events of each galaxy
+	std::stable_sort(costs.begin(), costs.end(), [](const galaxy_cost &c1, const galaxy_cost &c2) {
+		return std::make_tuple(c1.halo_id, c1.subhalo_id, c1.galaxy_id) < std::make_tuple(c2.halo_id, c2.subhalo_id, c2.galaxy_id);
+	});
+
+	auto evaluations = column<double>(costs, [](const galaxy_cost &c) { return c.ode_evaluations; });
+	auto wall_times = column<double>(costs, [](const galaxy_cost &c) { return c.wall_time; });
+	auto total_evaluations = std::accumulate(evaluations.begin(), evaluations.end(), 0.);
+	auto total_time = std::accumulate(wall_times.begin(), wall_times.end(), 0.);
+
+	LOG(info) << "Galaxy costs up to snapshot " << snapshot << ": " << costs.size()
+	          << " galaxy integrations, " << std::size_t(total_evaluations) << " ODE evaluations, "
+	          << ns_time(Timer::duration(total_time)) << " of evolution time. The top 1% of galaxies took "
+	          << fixed<1>(100 * top_share(evaluations, 0.01)) << "% of the evaluations and "
+	          << fixed<1>(100 * top_share(wall_times, 0.01)) << "% of the time";
+
+	boost::filesystem::path dirname = boost::filesystem::path(filename).parent_path();
+	if (!dirname.empty() && !boost::filesystem::exists(dirname)) {
+		boost::filesystem::create_directories(dirname);
+	}
+	hdf5::Writer file(filename);
+
+	std::string comment = "Snapshot galaxies were evolved up to from the previous snapshot";
+	file.write_dataset("run_info/snapshot", snapshot, comment);
+	comment = "Redshift corresponding to this snapshot";
+	file.write_dataset("run_info/redshift", redshift, comment);
+
+	comment = "Galaxy ID. Galaxies that underwent a starburst appear once more with starburst=1";
+	file.write_dataset("galaxies/id_galaxy", column<int>(costs, [](const galaxy_cost &c) { return c.galaxy_id; }), comment);
+	comment = "Subhalo ID hosting the galaxy";
+	file.write_dataset("galaxies/id_subhalo", column<std::int64_t>(costs, [](const galaxy_cost &c) { return c.subhalo_id; }), comment);
+	comment = "Halo ID hosting the galaxy";
+	file.write_dataset("galaxies/id_halo", column<std::int64_t>(costs, [](const galaxy_cost &c) { return c.halo_id; }), comment);
+	comment = "Galaxy type; =0 for centrals; =1 for satellites that reside in well identified subhalos; =2 for orphan satellites";
+	file.write_dataset("galaxies/type", column<int>(costs, [](const galaxy_cost &c) { return c.galaxy_type; }), comment);
+	comment = "Whether this integration corresponds to a starburst (=1) or to the evolution of the disk (=0)";
+	file.write_dataset("galaxies/starburst", column<int>(costs, [](const galaxy_cost &c) { return c.starburst; }), comment);
+	comment = "Stellar mass of the galaxy before the integration [Msun/h]";
+	file.write_dataset("galaxies/mstars", column<float>(costs, [](const galaxy_cost &c) { return c.mstars; }), comment);
+	comment = "Cold gas mass of the galaxy before the integration [Msun/h]";
+	file.write_dataset("galaxies/mgas", column<float>(costs, [](const galaxy_cost &c) { return c.mgas; }), comment);
+	comment = "Hot gas mass of the host subhalo before the integration [Msun/h]";
+	file.write_dataset("galaxies/mhot", column<float>(costs, [](const galaxy_cost &c) { return c.mhot; }), comment);
+	comment = "Dark matter mass of the host subhalo [Msun/h]";
+	file.write_dataset("galaxies/mvir_subhalo", column<float>(costs, [](const galaxy_cost &c) { return c.mvir_subhalo; }), comment);
+	comment = "Number of evaluations of the ODE system";
+	file.write_dataset("galaxies/ode_evaluations", column<unsigned int>(costs, [](const galaxy_cost &c) { return c.ode_evaluations; }), comment);
+	comment = "Number of steps rejected by the ODE solver";
+	file.write_dataset("galaxies/rejected_steps", column<unsigned int>(costs, [](const galaxy_cost &c) { return c.rejected_steps; }), comment);
+	comment = "Number of intervals used to integrate star formation rates";
+	file.write_dataset("galaxies/integration_intervals", column<unsigned int>(costs, [](const galaxy_cost &c) { return c.integration_intervals; }), comment);
+	comment = "Wall time of the integration [ns]. Galaxies integrated together in a batch share its time evenly";
+	file.write_dataset("galaxies/wall_time", column<std::int64_t>(costs, [](const galaxy_cost &c) { return c.wall_time; }), comment);
+
+	write_histogram(file, "ode_evaluations", evaluations, "ODE evaluations");
+	write_histogram(file, "wall_time", wall_times, "wall time [ns]");
+}
+
+}  // namespace shark
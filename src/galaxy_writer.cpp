@@ -23,6 +23,7 @@
  * Galaxy writer classes implementations
  */
 
+#include <algorithm>
 #include <ctime>
 #include <iomanip>
 #include <iostream>
@@ -32,7 +33,7 @@
 
 #include <boost/filesystem.hpp>
 
-#include "hdf5/writer.h"
+#include "hdf5/deferred_writer.h"
 #include "components.h"
 #include "config.h"
 #include "cosmology.h"
@@ -47,29 +48,144 @@
 
 namespace shark {
 
-GalaxyWriter::GalaxyWriter(ExecutionParameters exec_params, CosmologicalParameters cosmo_params,  CosmologyPtr cosmology, DarkMatterHalosPtr darkmatterhalo, SimulationParameters sim_params):
+GalaxyWriter::GalaxyWriter(ExecutionParameters exec_params, CosmologicalParameters cosmo_params,  CosmologyPtr cosmology, DarkMatterHalosPtr darkmatterhalo, SimulationParameters sim_params, SnapshotTimesPtr snapshot_times):
 	exec_params(std::move(exec_params)),
 	cosmo_params(std::move(cosmo_params)),
 	cosmology(std::move(cosmology)),
 	darkmatterhalo(std::move(darkmatterhalo)),
-	sim_params(std::move(sim_params))
+	sim_params(std::move(sim_params)),
+	snapshot_times(std::move(snapshot_times))
 {
 	//no-opt
 }
 
+GalaxyWriter::~GalaxyWriter()
+{
+	{
+		std::unique_lock<std::mutex> lock(jobs_mutex);
+		stopping = true;
+	}
+	jobs_changed.notify_all();
+	if (writing_thread.joinable()) {
+		writing_thread.join();
+	}
+	if (writing_error) {
+		LOG(error) << "Errors occurred while writing output files, some of them might be incomplete";
+	}
+}
+
+void GalaxyWriter::write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons)
+{
+	Timer t;
+	auto job = prepare_write(snapshot, halos, AllBaryons);
+	LOG(info) << "Output for snapshot " << snapshot << " prepared in " << t;
+	schedule(std::move(job));
+}
+
+void GalaxyWriter::schedule(writing_job &&job)
+{
+	if (!exec_params.async_output) {
+		Timer t;
+		job();
+		writing_time += t.get();
+		if (tracer) {
+			tracer->record(tracer->writer_lane(), "writing job", t);
+		}
+		return;
+	}
+	enqueue(std::move(job));
+}
+
+void GalaxyWriter::finish()
+{
+	std::unique_lock<std::mutex> lock(jobs_mutex);
+	jobs_changed.wait(lock, [this]() {
+		return pending_jobs.empty() && !job_in_progress;
+	});
+	rethrow_writing_error(lock);
+}
+
+void GalaxyWriter::enqueue(writing_job &&job)
+{
+	std::unique_lock<std::mutex> lock(jobs_mutex);
+	if (!writing_thread.joinable()) {
+		writing_thread = std::thread(&GalaxyWriter::writing_loop, this);
+	}
+
+	// Don't let unwritten snapshots pile up in memory
+	if (pending_jobs.size() >= exec_params.output_queue_length) {
+		Timer t;
+		jobs_changed.wait(lock, [this]() {
+			return writing_error || pending_jobs.size() < exec_params.output_queue_length;
+		});
+		LOG(info) << "Waited " << t << " for previous outputs to be written";
+	}
+	rethrow_writing_error(lock);
+
+	pending_jobs.emplace_back(std::move(job));
+	jobs_changed.notify_all();
+}
+
+void GalaxyWriter::writing_loop()
+{
+	std::unique_lock<std::mutex> lock(jobs_mutex);
+	while (true) {
+
+		jobs_changed.wait(lock, [this]() {
+			return stopping || !pending_jobs.empty();
+		});
+		if (pending_jobs.empty()) {
+			return;
+		}
+
+		auto job = std::move(pending_jobs.front());
+		pending_jobs.pop_front();
+		job_in_progress = true;
+		jobs_changed.notify_all();
+
+		lock.unlock();
+		std::exception_ptr error;
+		Timer t;
+		try {
+			job();
+		} catch (...) {
+			error = std::current_exception();
+		}
+		writing_time += t.get();
+		if (tracer) {
+			tracer->record(tracer->writer_lane(), "writing job", t);
+		}
+		lock.lock();
+
+		// After an error there is no point in writing anything else
+		if (error) {
+			writing_error = error;
+			pending_jobs.clear();
+		}
+		job_in_progress = false;
+		jobs_changed.notify_all();
+	}
+}
+
+void GalaxyWriter::rethrow_writing_error(std::unique_lock<std::mutex> &lock)
+{
+	if (!writing_error) {
+		return;
+	}
+	auto error = writing_error;
+	writing_error = nullptr;
+	lock.unlock();
+	std::rethrow_exception(error);
+}
+
 std::string GalaxyWriter::get_output_directory(int snapshot)
 {
 	using namespace boost::filesystem;
 	using std::string;
 
-	string batch_dir = "multiple_batches";
-	if (exec_params.simulation_batches.size() == 1) {
-		batch_dir = std::to_string(exec_params.simulation_batches[0]);
-	}
-
 	string output_dir = exec_params.output_directory + "/" + sim_params.sim_name +
 	                    "/" + exec_params.name_model + "/" + std::to_string(snapshot) +
-	                    "/" + batch_dir;
+	                    "/" + exec_params.batch_directory();
 
 	// Make sure the directory structure exists
 	path dirname(output_dir);
@@ -80,16 +196,25 @@ std::string GalaxyWriter::get_output_directory(int snapshot)
 	return output_dir;
 }
 
-void HDF5GalaxyWriter::write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal)
+GalaxyWriter::writing_job HDF5GalaxyWriter::prepare_write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons)
 {
-	hdf5::Writer file(get_output_directory(snapshot) + "/galaxies.hdf5");
-	write_header(file, snapshot);
-	write_galaxies(file, snapshot, halos, molgas_per_gal);
-	write_global_properties(file, snapshot, AllBaryons);
-	write_histories(snapshot, halos);
+	auto file = std::make_shared<hdf5::DeferredWriter>(get_output_directory(snapshot) + "/galaxies.hdf5");
+	write_header(*file, snapshot);
+	write_galaxies(*file, snapshot, halos);
+	write_global_properties(*file, snapshot, AllBaryons);
+	auto file_sfh = write_histories(snapshot, halos);
+
+	return [snapshot, file, file_sfh]() {
+		Timer t;
+		file->write();
+		if (file_sfh) {
+			file_sfh->write();
+		}
+		LOG(info) << "Output files for snapshot " << snapshot << " written in " << t;
+	};
 }
 
-void HDF5GalaxyWriter::write_header(hdf5::Writer &file, int snapshot){
+void HDF5GalaxyWriter::write_header(hdf5::DeferredWriter &file, int snapshot){
 
 	std::string comment;
 
@@ -169,7 +294,7 @@ std::size_t report_vsize(const std::vector<T> &v, std::ostringstream &os, const
 	return amount;
 };
 
-void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const std::vector<HaloPtr> &halos, const molgas_per_galaxy &molgas_per_gal){
+void HDF5GalaxyWriter::write_galaxies(hdf5::DeferredWriter &file, int snapshot, const std::vector<HaloPtr> &halos){
 
 	Timer t;
 
@@ -333,7 +458,7 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 				id_subhalo_tree.push_back(subhalo->id);
 
 				//Calculate molecular gas mass of disk and bulge, and specific angular momentum in atomic/molecular disk.
-				auto &molecular_gas = molgas_per_gal.at(galaxy);
+				auto &molecular_gas = galaxy->molecular_gas;
 				// Gas components separated into HI and H2.
 				mmol_disk.push_back(molecular_gas.m_mol);
 				mmol_bulge.push_back(molecular_gas.m_mol_b);
@@ -446,14 +571,14 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 				}
 				else{
 					// In case of type 2 galaxies assign negative positions, velocities and angular momentum.
-					darkmatterhalo->generate_random_orbits(pos, vel, L, galaxy->angular_momentum(), halo);
+					darkmatterhalo->generate_random_orbits(pos, vel, L, galaxy->angular_momentum(), halo, *galaxy);
 					mvir_subhalo.push_back(galaxy->msubhalo_type2);
 					cnfw_subhalo.push_back(galaxy->concentration_type2);
 					lambda_subhalo.push_back(galaxy->lambda_type2);
 					vvir_subhalo.push_back(galaxy->vvir_type2);
 
 					// calculate the age of the universe by the time this galaxy will merge.
-					double tmerge  = cosmology->convert_redshift_to_age(sim_params.redshifts[snapshot-1]) + galaxy->tmerge;
+					double tmerge  = snapshot_times->age(snapshot-1) + galaxy->tmerge;
 					double redshift_merger = cosmology->convert_age_to_redshift_lcdm(tmerge);
 					redshift_of_merger.push_back(redshift_merger);
 
@@ -599,245 +724,245 @@ void HDF5GalaxyWriter::write_galaxies(hdf5::Writer &file, int snapshot, const st
 	file.write_dataset("halo/mvir", halo_m, comment);
 
 	comment = "virial velocity of halo [km/s]";
-	file.write_dataset("halo/vvir", halo_m, comment);
+	file.write_dataset("halo/vvir", std::move(halo_m), comment);
 
 	comment = "halo concentration";
-	file.write_dataset("halo/concentration", halo_concentration, comment);
+	file.write_dataset("halo/concentration", std::move(halo_concentration), comment);
 
 	comment = "halo spin";
-	file.write_dataset("halo/lambda", halo_lambda, comment);
+	file.write_dataset("halo/lambda", std::move(halo_lambda), comment);
 
 	comment = "redshift at which the halo had 80% of its current mass";
-	file.write_dataset("halo/age_80", age_80_halo, comment);
+	file.write_dataset("halo/age_80", std::move(age_80_halo), comment);
 
 	comment = "redshift at which the halo had 50% of its current mass";
-	file.write_dataset("halo/age_50", age_50_halo, comment);
+	file.write_dataset("halo/age_50", std::move(age_50_halo), comment);
 
 	comment = "virial mass of the halo in which this halo will end up in by z=0 [Msun/h]";
-	file.write_dataset("halo/final_z0_mvir", halo_final_m, comment);
+	file.write_dataset("halo/final_z0_mvir", std::move(halo_final_m), comment);
 
 	//Write subhalo properties.
 	comment = "Subhalo id";
-	file.write_dataset("subhalo/id", id, comment);
+	file.write_dataset("subhalo/id", std::move(id), comment);
 
 	comment = "=1 if subhalo is the main progenitor' =0 otherwise.";
-	file.write_dataset("subhalo/main_progenitor", main, comment);
+	file.write_dataset("subhalo/main_progenitor", std::move(main), comment);
 
 	comment = "id of the subhalo that is the descendant of this subhalo";
-	file.write_dataset("subhalo/descendant_id", descendant_id, comment);
+	file.write_dataset("subhalo/descendant_id", std::move(descendant_id), comment);
 
 	comment = "id of the host halo of this subhalo";
-	file.write_dataset("subhalo/host_id", host_id, comment);
+	file.write_dataset("subhalo/host_id", std::move(host_id), comment);
 
 	comment = "redshift at which the subhalo became a SATELLITE (only well defined for satellite subhalos)";
-	file.write_dataset("subhalo/infall_time_subhalo", infall_time_subhalo, comment);
+	file.write_dataset("subhalo/infall_time_subhalo", std::move(infall_time_subhalo), comment);
 
 	//Write galaxy properties.
 	comment = "stellar mass in the disk [Msun/h]";
-	file.write_dataset("galaxies/mstars_disk", mstars_disk, comment);
+	file.write_dataset("galaxies/mstars_disk", std::move(mstars_disk), comment);
 
 	comment = "stellar mass in the bulge [Msun/h]";
-	file.write_dataset("galaxies/mstars_bulge", mstars_bulge, comment);
+	file.write_dataset("galaxies/mstars_bulge", std::move(mstars_bulge), comment);
 
 	comment = "stellar mass formed via starbursts driven by galaxy mergers [Msun/h]";
-	file.write_dataset("galaxies/mstars_burst_mergers", mstars_burst_mergers, comment);
+	file.write_dataset("galaxies/mstars_burst_mergers", std::move(mstars_burst_mergers), comment);
 
 	comment = "stellar mass formed via starbursts driven by disk instabilities [Msun/h]";
-	file.write_dataset("galaxies/mstars_burst_diskinstabilities", mstars_burst_diskinstabilities, comment);
+	file.write_dataset("galaxies/mstars_burst_diskinstabilities", std::move(mstars_burst_diskinstabilities), comment);
 
 	comment = "stellar mass in the bulge brought via galaxy mergers (but that formed in disks) [Msun/h]";
-	file.write_dataset("galaxies/mstars_bulge_mergers_assembly", mstars_bulge_mergers_assembly, comment);
+	file.write_dataset("galaxies/mstars_bulge_mergers_assembly", std::move(mstars_bulge_mergers_assembly), comment);
 
 	comment = "stellar mass in the bulge brought via disk instabilities from the disk [Msun/h]";
-	file.write_dataset("galaxies/mstars_bulge_diskins_assembly", mstars_bulge_diskins_assembly, comment);
+	file.write_dataset("galaxies/mstars_bulge_diskins_assembly", std::move(mstars_bulge_diskins_assembly), comment);
 
 	comment = "total gas mass in the disk [Msun/h]";
-	file.write_dataset("galaxies/mgas_disk", mgas_disk, comment);
+	file.write_dataset("galaxies/mgas_disk", std::move(mgas_disk), comment);
 
 	comment = "gas mass in the bulge [Msun/h]";
-	file.write_dataset("galaxies/mgas_bulge", mgas_bulge, comment);
+	file.write_dataset("galaxies/mgas_bulge", std::move(mgas_bulge), comment);
 
 	comment = "mass of metals locked in stars in the disk [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_disk",mstars_metals_disk, comment);
+	file.write_dataset("galaxies/mstars_metals_disk",std::move(mstars_metals_disk), comment);
 
 	comment = "mass of metals locked in stars in the bulge [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_bulge", mstars_metals_bulge, comment);
+	file.write_dataset("galaxies/mstars_metals_bulge", std::move(mstars_metals_bulge), comment);
 
 	comment = "mass of metals locked in stars that formed via starbursts driven by galaxy mergers [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_burst_mergers", mstars_metals_burst_mergers, comment);
+	file.write_dataset("galaxies/mstars_metals_burst_mergers", std::move(mstars_metals_burst_mergers), comment);
 
 	comment = "mass of metals locked in stars that formed via starbursts driven by disk instabilities [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_burst_diskinstabilities", mstars_metals_burst_diskinstabilities, comment);
+	file.write_dataset("galaxies/mstars_metals_burst_diskinstabilities", std::move(mstars_metals_burst_diskinstabilities), comment);
 
 	comment = "mass of metals locked in stars in the bulge that was brought via galaxy mergers (but that formed in disks) [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_bulge_mergers_assembly", mstars_metals_bulge_mergers_assembly, comment);
+	file.write_dataset("galaxies/mstars_metals_bulge_mergers_assembly", std::move(mstars_metals_bulge_mergers_assembly), comment);
 
 	comment = "mass of metals locked in stars in the bulge that was brought via disk instabilities from the disk [Msun/h]";
-	file.write_dataset("galaxies/mstars_metals_bulge_diskins_assembly", mstars_metals_bulge_diskins_assembly, comment);
+	file.write_dataset("galaxies/mstars_metals_bulge_diskins_assembly", std::move(mstars_metals_bulge_diskins_assembly), comment);
 
 	comment = "stellar mass-weighted stellar age [Gyr]";
-	file.write_dataset("galaxies/mean_stellar_age", mean_stellar_age, comment);
+	file.write_dataset("galaxies/mean_stellar_age", std::move(mean_stellar_age), comment);
 
 	comment = "mass of metals locked in the gas of the disk [Msun/h]";
-	file.write_dataset("galaxies/mgas_metals_disk", mgas_metals_disk, comment);
+	file.write_dataset("galaxies/mgas_metals_disk", std::move(mgas_metals_disk), comment);
 
 	comment = "mass of metals locked in the gas of the bulge [Msun/h]";
-	file.write_dataset("galaxies/mgas_metals_bulge", mgas_metals_bulge, comment);
+	file.write_dataset("galaxies/mgas_metals_bulge", std::move(mgas_metals_bulge), comment);
 
 	comment = "molecular gas mass (helium plus hydrogen) in the disk [Msun/h]";
-	file.write_dataset("galaxies/mmol_disk",mmol_disk, comment);
+	file.write_dataset("galaxies/mmol_disk",std::move(mmol_disk), comment);
 
 	comment ="molecular gas mass (helium plus hydrogen) in the bulge [Msun/h]";
-	file.write_dataset("galaxies/mmol_bulge",mmol_bulge, comment);
+	file.write_dataset("galaxies/mmol_bulge",std::move(mmol_bulge), comment);
 
 	comment = "atomic gas mass (helium plus hydrogen) in the disk [Msun/h]";
-	file.write_dataset("galaxies/matom_disk",matom_disk, comment);
+	file.write_dataset("galaxies/matom_disk",std::move(matom_disk), comment);
 
 	comment ="atomic gas mass (helium plus hydrogen) in the bulge [Msun/h]";
-	file.write_dataset("galaxies/matom_bulge",matom_bulge, comment);
+	file.write_dataset("galaxies/matom_bulge",std::move(matom_bulge), comment);
 
 	comment = "star formation rate in the disk [Msun/Gyr/h]";
-	file.write_dataset("galaxies/sfr_disk", sfr_disk, comment);
+	file.write_dataset("galaxies/sfr_disk", std::move(sfr_disk), comment);
 
 	comment = "star formation rate in the bulge [Msun/Gyr/h]";
-	file.write_dataset("galaxies/sfr_burst", sfr_burst, comment);
+	file.write_dataset("galaxies/sfr_burst", std::move(sfr_burst), comment);
 
 	comment = "black hole mass [Msun/h]";
-	file.write_dataset("galaxies/m_bh", mBH, comment);
+	file.write_dataset("galaxies/m_bh", std::move(mBH), comment);
 
 	comment = "accretion rate onto the black hole during the hot halo mode [Msun/Gyr/h]";
-	file.write_dataset("galaxies/bh_accretion_rate_hh", mBH_acc_hh, comment);
+	file.write_dataset("galaxies/bh_accretion_rate_hh", std::move(mBH_acc_hh), comment);
 
 	comment = "accretion rate onto the black hole during the starburst mode [Msun/Gyr/h]";
-	file.write_dataset("galaxies/bh_accretion_rate_sb", mBH_acc_sb, comment);
+	file.write_dataset("galaxies/bh_accretion_rate_sb", std::move(mBH_acc_sb), comment);
 
 	comment = "half-mass radius of the stellar disk [cMpc/h]";
-	file.write_dataset("galaxies/rstar_disk", rdisk_star, comment);
+	file.write_dataset("galaxies/rstar_disk", std::move(rdisk_star), comment);
 
 	comment = "half-mass radius of the stellar bulge [cMpc/h]";
-	file.write_dataset("galaxies/rstar_bulge", rbulge_star, comment);
+	file.write_dataset("galaxies/rstar_bulge", std::move(rbulge_star), comment);
 
 	comment = "specific angular momentum of the stellar disk [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_disk_star", sAM_disk_star, comment);
+	file.write_dataset("galaxies/specific_angular_momentum_disk_star", std::move(sAM_disk_star), comment);
 
 	comment = "specific angular momentum of the stellar bulge [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_bulge_star", sAM_bulge_star, comment);
+	file.write_dataset("galaxies/specific_angular_momentum_bulge_star", std::move(sAM_bulge_star), comment);
 
 	comment = "half-mass radius of the gas disk [cMpc/h]";
-	file.write_dataset("galaxies/rgas_disk", rdisk_gas, comment);
+	file.write_dataset("galaxies/rgas_disk", std::move(rdisk_gas), comment);
 
 	comment = "half-mass radius of the gas bulge [cMpc/h]";
-	file.write_dataset("galaxies/rgas_bulge", rbulge_gas, comment);
+	file.write_dataset("galaxies/rgas_bulge", std::move(rbulge_gas), comment);
 
 	comment = "specific angular momentum of the gas disk [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_disk_gas", sAM_disk_gas, comment);
+	file.write_dataset("galaxies/specific_angular_momentum_disk_gas", std::move(sAM_disk_gas), comment);
 
 	comment = "specific angular momentum of the atomic gas disk [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_disk_gas_atom", sAM_disk_gas_atom, comment);
+	file.write_dataset("galaxies/specific_angular_momentum_disk_gas_atom", std::move(sAM_disk_gas_atom), comment);
 
 	comment = "specific angular momentum of the molecular gas disk [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_disk_gas_mol", sAM_disk_gas_mol, comment);
+	file.write_dataset("galaxies/specific_angular_momentum_disk_gas_mol", std::move(sAM_disk_gas_mol), comment);
 
 	comment = "specific angular momentum of the gas bulge [km/s * cMpc/h]";
-	file.write_dataset("galaxies/specific_angular_momentum_bulge_gas", sAM_bulge_gas, comment);
+	file.write_dataset("galaxies/specific_angular_momentum_bulge_gas", std::move(sAM_bulge_gas), comment);
 
 	comment = "redshift at which this galaxy will merge onto a central galaxy (only relevant for type 2 galaxies)";
-	file.write_dataset("galaxies/redshift_merger", redshift_of_merger, comment);
+	file.write_dataset("galaxies/redshift_merger", std::move(redshift_of_merger), comment);
 
 	comment = "hot gas mass in the halo [Msun/h]";
-	file.write_dataset("galaxies/mhot", mhot, comment);
+	file.write_dataset("galaxies/mhot", std::move(mhot), comment);
 
 	comment = "mass of metals locked in the hot halo gas [Msun/h]";
-	file.write_dataset("galaxies/mhot_metals", mhot_metals, comment);
+	file.write_dataset("galaxies/mhot_metals", std::move(mhot_metals), comment);
 
 	comment = "gas mass in the ejected gas component [Msun/h]";
-	file.write_dataset("galaxies/mreheated", mreheated, comment);
+	file.write_dataset("galaxies/mreheated", std::move(mreheated), comment);
 
 	comment = "mass of metals locked in the ejected gas component [Msun/h]";
-	file.write_dataset("galaxies/mreheated_metals", mreheated_metals, comment);
+	file.write_dataset("galaxies/mreheated_metals", std::move(mreheated_metals), comment);
 
 	comment = "gas mass in the lost gas component - due to QSO feedback [Msun/h]";
-	file.write_dataset("galaxies/mlost", mlost, comment);
+	file.write_dataset("galaxies/mlost", std::move(mlost), comment);
 
 	comment = "mass of metals locked in the lost gas component - due to QSO feedback [Msun/h]";
-	file.write_dataset("galaxies/mlost_metals", mlost_metals, comment);
+	file.write_dataset("galaxies/mlost_metals", std::move(mlost_metals), comment);
 
 	comment = "cooling rate of the hot halo component [Msun/Gyr/h].";
-	file.write_dataset("galaxies/cooling_rate", cooling_rate, comment);
+	file.write_dataset("galaxies/cooling_rate", std::move(cooling_rate), comment);
 
 	comment = "Dark matter mass of the host halo in which this galaxy resides [Msun/h]";
-	file.write_dataset("galaxies/mvir_hosthalo", mvir_hosthalo, comment);
+	file.write_dataset("galaxies/mvir_hosthalo", std::move(mvir_hosthalo), comment);
 
 	comment = "Dark matter mass of the subhalo in which this galaxy resides [Msun/h]. In the case of type 2 satellites, this corresponds to the mass its subhalo had before disappearing from the subhalo catalogs.";
-	file.write_dataset("galaxies/mvir_subhalo", mvir_subhalo, comment);
+	file.write_dataset("galaxies/mvir_subhalo", std::move(mvir_subhalo), comment);
 
 	comment = "Maximum circular velocity of this galaxy [km/s]";
-	file.write_dataset("galaxies/vmax_subhalo", vmax_subhalo, comment);
+	file.write_dataset("galaxies/vmax_subhalo", std::move(vmax_subhalo), comment);
 
 	comment = "Virial velocity of the dark matter subhalo in which this galaxy resides [km/s]. In the case of type 2 satellites, this corresponds to the virial velocity its subhalo had before disappearing from the subhalo catalogs.";
-	file.write_dataset("galaxies/vvir_subhalo", vvir_subhalo, comment);
+	file.write_dataset("galaxies/vvir_subhalo", std::move(vvir_subhalo), comment);
 
 	comment = "Virial velocity of the dark matter host halo in which this galaxy resides [km/s].";
-	file.write_dataset("galaxies/vvir_hosthalo", vvir_hosthalo, comment);
+	file.write_dataset("galaxies/vvir_hosthalo", std::move(vvir_hosthalo), comment);
 
 	comment = "NFW concentration parameter of the dark matter subhalo in which this galaxy resides [dimensionless]. In the case of type 2 satellites, this corresponds to the concentration its subhalo had before disappearing from the subhalo catalogs.";
-	file.write_dataset("galaxies/cnfw_subhalo", cnfw_subhalo, comment);
+	file.write_dataset("galaxies/cnfw_subhalo", std::move(cnfw_subhalo), comment);
 
 	comment = "Spin parameter of the dark matter subhalo in which this galaxy resides [dimensionless].  In the case of type 2 satellites, this corresponds to the lambda its subhalo had before disappearing from the subhalo catalogs.";
-	file.write_dataset("galaxies/lambda_subhalo", lambda_subhalo, comment);
+	file.write_dataset("galaxies/lambda_subhalo", std::move(lambda_subhalo), comment);
 
 	//Galaxy position
 	comment = "position component x of galaxy [cMpc/h]. In the case of type 2 galaxies, the positions are generated to randomly sample an NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/position_x", position_x, comment);
+	file.write_dataset("galaxies/position_x", std::move(position_x), comment);
 	comment = "position component y of galaxy [cMpc/h]. In the case of type 2 galaxies, the positions are generated to randomly sample an NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/position_y", position_y, comment);
+	file.write_dataset("galaxies/position_y", std::move(position_y), comment);
 	comment = "position component z of galaxy [cMpc/h]. In the case of type 2 galaxies, the positions are generated to randomly sample an NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/position_z", position_z, comment);
+	file.write_dataset("galaxies/position_z", std::move(position_z), comment);
 
 	//Galaxy velocity
 	comment = "peculiar velocity component x of galaxy [km/s]. In the case of type 2 galaxies, the velocity is generated to randomly sample the velocity dispersion of a NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/velocity_x", velocity_x, comment);
+	file.write_dataset("galaxies/velocity_x", std::move(velocity_x), comment);
 	comment = "peculiar velocity component y of galaxy [km/s]. In the case of type 2 galaxies, the velocity is generated to randomly sample the velocity dispersion of a NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/velocity_y", velocity_y, comment);
+	file.write_dataset("galaxies/velocity_y", std::move(velocity_y), comment);
 	comment = "peculiar velocity component z of galaxy [km/s]. In the case of type 2 galaxies, the velocity is generated to randomly sample the velocity dispersion of a NFW halo with the concentration of the halo the galaxy lives in.";
-	file.write_dataset("galaxies/velocity_z", velocity_z, comment);
+	file.write_dataset("galaxies/velocity_z", std::move(velocity_z), comment);
 
 	//Galaxy AM vector
 	comment = "total angular momentum component x of galaxy [Msun pMpc km/s]. In the case of type 2 galaxies, the AM vector is randomly oriented.";
-	file.write_dataset("galaxies/l_x", L_x,  comment);
+	file.write_dataset("galaxies/l_x", std::move(L_x),  comment);
 	comment = "total angular momentum component y of galaxy [Msun pMpc km/s]. In the case of type 2 galaxies, the AM vector is randomly oriented.";
-	file.write_dataset("galaxies/l_y", L_y, comment);
+	file.write_dataset("galaxies/l_y", std::move(L_y), comment);
 	comment = "total angular momentum component z of galaxy [Msun pMpc km/s]. In the case of type 2 galaxies, the AM vector is randomly oriented.";
-	file.write_dataset("galaxies/l_z", L_z, comment);
+	file.write_dataset("galaxies/l_z", std::move(L_z), comment);
 
 	//Galaxy type.
 	comment = "galaxy type; =0 for centrals; =1 for satellites that reside in well identified subhalos; =2 for orphan satellites";
-	file.write_dataset("galaxies/type", type, comment);
+	file.write_dataset("galaxies/type", std::move(type), comment);
 
 	//Galaxy IDs.
 	comment = "subhalo ID. Unique to this snapshot.";
-	file.write_dataset("galaxies/id_subhalo", id_subhalo, comment);
+	file.write_dataset("galaxies/id_subhalo", std::move(id_subhalo), comment);
 
 	comment = "halo ID. Unique to this snapshot.";
-	file.write_dataset("galaxies/id_halo", id_halo, comment);
+	file.write_dataset("galaxies/id_halo", std::move(id_halo), comment);
 
 	comment = "galaxy ID. Unique to this galaxy throughout time. If this galaxy never mergers onto a central, then its ID is always the same.";
-	file.write_dataset("galaxies/id_galaxy", id_galaxy, comment);
+	file.write_dataset("galaxies/id_galaxy", std::move(id_galaxy), comment);
 
 	comment = "descendant galaxy ID. Different to galaxy id only if galaxy is type 2 and merges on the next snapshot.";
-	file.write_dataset("galaxies/descendant_id_galaxy", descendant_id_galaxy, comment);
+	file.write_dataset("galaxies/descendant_id_galaxy", std::move(descendant_id_galaxy), comment);
 
 	comment = "subhalo id in the tree (unique to entire halo catalogue).";
-	file.write_dataset("galaxies/id_subhalo_tree", id_subhalo_tree, comment);
+	file.write_dataset("galaxies/id_subhalo_tree", std::move(id_subhalo_tree), comment);
 
 	comment = "halo id in the tree (unique to entire halo catalogue).";
-	file.write_dataset("galaxies/id_halo_tree", id_halo_tree, comment);
+	file.write_dataset("galaxies/id_halo_tree", std::move(id_halo_tree), comment);
 
-	LOG(info) << "Galaxies data written in " << t;
+	LOG(info) << "Galaxies data frozen for writing in " << t;
 
 }
 
-void HDF5GalaxyWriter::write_global_properties (hdf5::Writer &file, int snapshot, TotalBaryon &AllBaryons){
+void HDF5GalaxyWriter::write_global_properties (hdf5::DeferredWriter &file, int snapshot, TotalBaryon &AllBaryons){
 
 	using std::string;
 	using std::vector;
@@ -860,7 +985,7 @@ void HDF5GalaxyWriter::write_global_properties (hdf5::Writer &file, int snapshot
 	}
 
 	comment = "redshifts of the global outputs.";
-	file.write_dataset("global/redshifts", redshifts, comment);
+	file.write_dataset("global/redshifts", std::move(redshifts), comment);
 
 	comment = "total cold gas mass (interstellar medium) in the simulated box [Msun/h]";
 	file.write_dataset("global/mcold",AllBaryons.get_masses(AllBaryons.mcold), comment);
@@ -940,13 +1065,13 @@ void HDF5GalaxyWriter::write_global_properties (hdf5::Writer &file, int snapshot
 	file.write_dataset("global/m_dm",AllBaryons.get_masses(AllBaryons.mDM), comment);
 
 	comment = "total baryon mass in the simulated box [Msun/h]";
-	file.write_dataset("global/mbar_created",baryons_ever_created, comment);
+	file.write_dataset("global/mbar_created",std::move(baryons_ever_created), comment);
 
 	comment = "total baryons lost in the simulated box [Msun/h] (ideally this should be =0)";
-	file.write_dataset("global/mbar_lost", baryons_ever_lost, comment);
+	file.write_dataset("global/mbar_lost", std::move(baryons_ever_lost), comment);
 }
 
-void HDF5GalaxyWriter::write_histories (int snapshot, const std::vector<HaloPtr> &halos){
+std::shared_ptr<hdf5::DeferredWriter> HDF5GalaxyWriter::write_histories (int snapshot, const std::vector<HaloPtr> &halos){
 
 
 	using std::string;
@@ -956,7 +1081,8 @@ void HDF5GalaxyWriter::write_histories (int snapshot, const std::vector<HaloPtr>
 
 	if(exec_params.output_sf_histories){
 		if(std::find(exec_params.snapshots_sf_histories.begin(), exec_params.snapshots_sf_histories.end(), snapshot) != exec_params.snapshots_sf_histories.end()){
-			hdf5::Writer file_sfh(get_output_directory(snapshot) + "/star_formation_histories.hdf5");
+			auto file_sfh_ptr = std::make_shared<hdf5::DeferredWriter>(get_output_directory(snapshot) + "/star_formation_histories.hdf5");
+			auto &file_sfh = *file_sfh_ptr;
 
 			//Create the vectors that will save the information of the galaxies
 			vector<vector<float>> sfhs_disk;
@@ -1074,11 +1200,11 @@ void HDF5GalaxyWriter::write_histories (int snapshot, const std::vector<HaloPtr>
 			vector<float> age_mean;
 			vector<float> delta_t;
 
-			double age_uni = std::abs(cosmology->convert_redshift_to_age(0));
+			double age_uni = std::abs(snapshot_times->present_age());
 			for (int i=sim_params.min_snapshot+1; i <= snapshot; i++){
-				redshifts.push_back(sim_params.redshifts[i]);
-				double delta = std::abs(cosmology->convert_redshift_to_age(sim_params.redshifts[i]) - cosmology->convert_redshift_to_age(sim_params.redshifts[i-1]));
-				double age = age_uni - 0.5 * (std::abs(cosmology->convert_redshift_to_age(sim_params.redshifts[i]) + cosmology->convert_redshift_to_age(sim_params.redshifts[i-1])));
+				redshifts.push_back(snapshot_times->redshift(i));
+				double delta = std::abs(snapshot_times->age(i) - snapshot_times->age(i-1));
+				double age = age_uni - 0.5 * (std::abs(snapshot_times->age(i) + snapshot_times->age(i-1)));
 				delta_t.push_back(delta);
 				age_mean.push_back(age);
 			}
@@ -1087,66 +1213,73 @@ void HDF5GalaxyWriter::write_histories (int snapshot, const std::vector<HaloPtr>
 			write_header(file_sfh, snapshot);
 
 			comment = "galaxy ID. Unique to this galaxy throughout time. If this galaxy never mergers onto a central, then its ID is always the same.";
-			file_sfh.write_dataset("galaxies/id_galaxy", id_galaxy, comment);
+			file_sfh.write_dataset("galaxies/id_galaxy", std::move(id_galaxy), comment);
 
 			//Write disk component history.
 			comment = "Star formation history of stars formed that by this output time end up in the disk [Msun/yr/h]";
-			file_sfh.write_dataset("disks/star_formation_rate_histories", sfhs_disk, comment);
+			file_sfh.write_dataset("disks/star_formation_rate_histories", std::move(sfhs_disk), comment);
 
 			comment = "Stellar metallicity of the stars formed in a timestep that by this output time ends up in the disk";
-			file_sfh.write_dataset("disks/metallicity_histories", stellar_metals_disk, comment);
+			file_sfh.write_dataset("disks/metallicity_histories", std::move(stellar_metals_disk), comment);
 
 			//Write bulge component history, for the mass build up due to galaxy mergers.
 			comment = "Star formation history of stars formed that by this output time end up in the bulge formed via galaxy mergers [Msun/yr/h]";
-			file_sfh.write_dataset("bulges_mergers/star_formation_rate_histories", sfhs_bulge_mergers, comment);
+			file_sfh.write_dataset("bulges_mergers/star_formation_rate_histories", std::move(sfhs_bulge_mergers), comment);
 
 			comment = "Stellar metallicity of the stars formed in a timestep that by this output time ends up in the bulge formed via galaxy mergers";
-			file_sfh.write_dataset("bulges_mergers/metallicity_histories", stellar_metals_bulge_mergers, comment);
+			file_sfh.write_dataset("bulges_mergers/metallicity_histories", std::move(stellar_metals_bulge_mergers), comment);
 
 			//Write bulge component history.
 			comment = "Star formation history of stars formed that by this output time end up in the bulge formed via disk instabilities [Msun/yr/h]";
-			file_sfh.write_dataset("bulges_diskins/star_formation_rate_histories", sfhs_bulge_diskins, comment);
+			file_sfh.write_dataset("bulges_diskins/star_formation_rate_histories", std::move(sfhs_bulge_diskins), comment);
 
 			comment = "Stellar metallicity of the stars formed in a timestep that by this output time ends up in the bulge formed via disk instabilities";
-			file_sfh.write_dataset("bulges_diskins/metallicity_histories", stellar_metals_bulge_diskins, comment);
+			file_sfh.write_dataset("bulges_diskins/metallicity_histories", std::move(stellar_metals_bulge_diskins), comment);
 
 			comment = "Redshifts of the history outputs";
-			file_sfh.write_dataset("redshifts", redshifts, comment);
+			file_sfh.write_dataset("redshifts", std::move(redshifts), comment);
 
 			comment = "Look back time to mean time between snapshots [Gyr]";
-			file_sfh.write_dataset("lbt_mean", age_mean, comment);
+			file_sfh.write_dataset("lbt_mean", std::move(age_mean), comment);
 
 			comment = "Time interval covered between snapshots [Gyr]";
-			file_sfh.write_dataset("delta_t", delta_t, comment);
+			file_sfh.write_dataset("delta_t", std::move(delta_t), comment);
 
+			return file_sfh_ptr;
 		}
 
 	}
+
+	return nullptr;
 }
 
-void ASCIIGalaxyWriter::write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons, const molgas_per_galaxy &molgas_per_gal)
+GalaxyWriter::writing_job ASCIIGalaxyWriter::prepare_write(int snapshot, const std::vector<HaloPtr> &halos, TotalBaryon &AllBaryons)
 {
 
 	using std::vector;
 	using std::string;
 
-	std::ofstream output(get_output_directory(snapshot) + "/galaxies.dat");
-
 	// TODO: Write a header?
 
 	// Each galaxy corresponds to one line
+	auto contents = std::make_shared<std::ostringstream>();
 	for (const auto &halo: halos) {
 		for(const auto &subhalo: halo->all_subhalos()) {
 			for(const auto &galaxy: subhalo->galaxies) {
-				write_galaxy(galaxy, subhalo, snapshot, output, molgas_per_gal);
+				write_galaxy(galaxy, subhalo, snapshot, *contents);
 			}
 		}
 	}
 
-	output.close();
+	auto fname = get_output_directory(snapshot) + "/galaxies.dat";
+	return [fname, contents]() {
+		std::ofstream output(fname);
+		output << contents->str();
+		output.close();
+	};
 }
 
-void ASCIIGalaxyWriter::write_galaxy(const GalaxyPtr &galaxy, const SubhaloPtr &subhalo, int snapshot, std::ofstream &f, const molgas_per_galaxy &molgas_per_gal)
+void ASCIIGalaxyWriter::write_galaxy(const GalaxyPtr &galaxy, const SubhaloPtr &subhalo, int snapshot, std::ostream &f)
 {
 	auto mstars_disk = galaxy->disk_stars.mass;
 	auto mstars_bulge = galaxy->bulge_stars.mass;
@@ -1155,7 +1288,7 @@ void ASCIIGalaxyWriter::write_galaxy(const GalaxyPtr &galaxy, const SubhaloPtr &
 	auto mBH = galaxy->smbh.mass;
 	auto rdisk = galaxy->disk_stars.rscale;
 	auto rbulge = galaxy->bulge_stars.rscale;
-	auto &molecular_gas = molgas_per_gal.at(galaxy);
+	auto &molecular_gas = galaxy->molecular_gas;
 
 	f << mstars_disk << " " << mstars_bulge << " " <<  molecular_gas.m_atom + molecular_gas.m_atom_b
 	  << " " << mBH << " " << mgas_metals_disk / mgas_disk << " "
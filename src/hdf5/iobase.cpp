@@ -35,10 +35,15 @@ namespace shark {
 
 namespace hdf5 {
 
-IOBase::IOBase(const std::string &filename, unsigned int flags) :
-	hdf5_file(filename, flags)
+std::unique_lock<std::recursive_mutex> IOBase::lock_library()
 {
-	// no-op
+	static std::recursive_mutex mutex;
+	return std::unique_lock<std::recursive_mutex>(mutex);
+}
+
+IOBase::IOBase(const std::string &filename, unsigned int flags)
+{
+	open_file(filename, flags);
 }
 
 IOBase::~IOBase()
@@ -48,22 +53,26 @@ IOBase::~IOBase()
 
 void IOBase::close()
 {
-	if (!opened) {
+	if (!hdf5_file) {
 		return;
 	}
 
-	hdf5_file.close();
-	opened = false;
+	auto lock = lock_library();
+	hdf5_file->close();
+	hdf5_file.reset();
 }
 
 void IOBase::open_file(const std::string &filename, unsigned int flags)
 {
-	hdf5_file = H5::H5File(filename, flags);
+	close();
+	auto lock = lock_library();
+	hdf5_file = std::unique_ptr<H5::H5File>(new H5::H5File(filename, flags));
 }
 
 const std::string IOBase::get_filename() const
 {
-	return hdf5_file.getFileName();
+	auto lock = lock_library();
+	return hdf5_file->getFileName();
 }
 
 H5::DataSpace IOBase::get_nd_dataspace(const H5::DataSet &dataset, unsigned int expected_ndims) const
@@ -115,11 +124,11 @@ H5::DataSet IOBase::get_dataset(const std::vector<std::string> &path) const {
 
 	// only the attribute name, read directly and come back
 	if( path.size() == 1 ) {
-		return hdf5_file.openDataSet(path[0]);
+		return hdf5_file->openDataSet(path[0]);
 	}
 
 	// else there's a path to follow, go for it!
-	H5::Group group = hdf5_file.openGroup(path.front());
+	H5::Group group = hdf5_file->openGroup(path.front());
 	std::vector<std::string> group_paths(path.begin() + 1, path.end() - 1);
 	for(auto const &path: group_paths) {
 		LOG(debug) << "Getting dataset " << path << " on file " << get_filename();
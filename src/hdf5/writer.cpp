@@ -144,10 +144,10 @@ H5::Group Writer::ensure_group(const std::vector<std::string> &path) const
 {
 	if (path.size() == 1) {
 		check_group_name(path[0]);
-		return ensure_entity<H5G_GROUP>(hdf5_file, path[0]);
+		return ensure_entity<H5G_GROUP>(*hdf5_file, path[0]);
 	}
 
-	H5::Group group =  ensure_entity<H5G_GROUP>(hdf5_file, path.front());
+	H5::Group group =  ensure_entity<H5G_GROUP>(*hdf5_file, path.front());
 	std::vector<std::string> group_paths(path.begin() + 1, path.end());
 	for(auto &part: group_paths) {
 		group = ensure_entity<H5G_GROUP>(group, part);
@@ -160,7 +160,7 @@ H5::DataSet Writer::ensure_dataset(const std::vector<std::string> &path, const H
 {
 	if (path.size() == 1) {
 		check_dataset_name(path[0]);
-		return ensure_entity<H5G_DATASET>(hdf5_file, path[0], dataType, dataSpace);
+		return ensure_entity<H5G_DATASET>(*hdf5_file, path[0], dataType, dataSpace);
 	}
 
 	std::vector<std::string> group_paths(path.begin(), path.end() - 1);
@@ -25,6 +25,8 @@
  */
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include <sstream>
 
 #include "exceptions.h"
@@ -71,6 +73,58 @@ double Interpolator::get(double x, double y) const
 			x, y, xacc.get(), yacc.get());
 }
 
+GridInterpolator::axis::axis(std::vector<double> nodes_) :
+	nodes(std::move(nodes_))
+{
+	if (nodes.size() < 2) {
+		throw invalid_argument("grid axes need at least two points");
+	}
+
+	double min_width = std::numeric_limits<double>::max();
+	for (std::size_t i = 0; i != nodes.size() - 1; i++) {
+		double width = nodes[i + 1] - nodes[i];
+		if (!(width > 0)) {
+			throw invalid_argument("grid axis points are not strictly increasing");
+		}
+		min_width = std::min(min_width, width);
+		cell_ends.push_back(nodes[i + 1]);
+		inv_cell_widths.push_back(1 / width);
+	}
+	cell_ends.back() = std::numeric_limits<double>::infinity();
+
+	// Buckets no wider than the narrowest cell contain at most one cell boundary
+	const std::size_t max_buckets = 1 << 24;
+	double range = nodes.back() - nodes.front();
+	auto n_buckets = std::size_t(std::ceil(range / min_width)) + 1;
+	if (n_buckets > max_buckets) {
+		std::ostringstream os;
+		os << "grid axis is too irregular: it would need " << n_buckets << " buckets";
+		throw invalid_argument(os.str());
+	}
+	double bucket_width = range / (n_buckets - 1);
+	inv_bucket_width = 1 / bucket_width;
+
+	std::size_t cell = 0;
+	for (std::size_t bucket = 0; bucket != n_buckets; bucket++) {
+		double start = nodes.front() + bucket * bucket_width;
+		while (start >= cell_ends[cell]) {
+			cell++;
+		}
+		bucket_cells.push_back(std::uint32_t(cell));
+	}
+}
+
+GridInterpolator::GridInterpolator(std::vector<double> xvals, std::vector<double> yvals, std::vector<double> zvals) :
+	x_axis(std::move(xvals)), y_axis(std::move(yvals)), z(std::move(zvals))
+{
+	if (x_axis.size() * y_axis.size() != z.size()) {
+		std::ostringstream os;
+		os << "Grid size (" << x_axis.size() << "x" << y_axis.size() << " = " << x_axis.size() * y_axis.size();
+		os << ") does not correspond with values size (" << z.size() << ")";
+		throw invalid_argument(os.str());
+	}
+}
+
 const gsl_interp2d_type *Interpolator::to_gsl(InterpolatorType type) const
 {
 	if (type == BILINEAR) {
@@ -24,6 +24,7 @@
  */
 
 #include <algorithm>
+#include <fstream>
 #include <ios>
 #include <iostream>
 #include <vector>
@@ -43,6 +44,7 @@
 #include "shark_runner.h"
 #include "git_revision.h"
 #include "timer.h"
+#include "utils.h"
 
 namespace shark {
 
@@ -131,7 +133,10 @@ boost::program_options::variables_map parse_cmdline(int argc, char **argv) {
 		("threads,t",   po::value<unsigned int>()->default_value(1), "OpenMP threads, defaults to 1. 0 means use OpenMP default number of threads")
 #endif // SHARK_OPENMP
 		("options,o",   po::value<vector<string>>()->multitoken()->default_value({}, ""),
-		                "Space-separated additional options to override config file");
+		                "Space-separated additional options to override config file")
+		("models,m",    po::value<string>(),
+		                "File with one model per line, each given as -o options overriding those of "
+		                "the rest of the command-line. All models are run over the same merger trees");
 
 	po::positional_options_description pdesc;
 	pdesc.add("config-file", -1);
@@ -196,6 +201,51 @@ Options read_options(const boost::program_options::variables_map &vm, unsigned i
 	return options;
 }
 
+std::vector<Options> read_models(const boost::program_options::variables_map &vm, const Options &options)
+{
+	namespace po = boost::program_options;
+
+	// Each model is a line of -o options, like those given on the command-line
+	po::options_description model_opts;
+	model_opts.add_options()
+		("options,o", po::value<std::vector<std::string>>()->multitoken()->default_value({}, ""));
+
+	std::string name_model;
+	options.load("execution.name_model", name_model, true);
+
+	std::vector<Options> models;
+	auto models_file = vm["models"].as<std::string>();
+	std::ifstream f = open_file(models_file);
+	std::string line;
+	while (std::getline(f, line)) {
+
+		trim(line);
+		if (empty_or_comment(line)) {
+			continue;
+		}
+
+		po::variables_map model_vm;
+		po::store(po::command_line_parser(po::split_unix(line)).options(model_opts).run(), model_vm);
+		po::notify(model_vm);
+
+		// Models write their outputs under their own name, unless told otherwise
+		Options model = options;
+		std::ostringstream os;
+		os << "execution.name_model = " << name_model << "_" << models.size();
+		model.add(os.str());
+		for(auto &opt_spec: model_vm["options"].as<std::vector<std::string>>()) {
+			model.add(opt_spec);
+		}
+		models.emplace_back(std::move(model));
+	}
+
+	if (models.empty()) {
+		throw invalid_option("No models found in " + models_file);
+	}
+	LOG(info) << "Read " << models.size() << " models from " << models_file;
+	return models;
+}
+
 int main(int argc, char **argv) {
 
 	try {
@@ -211,7 +261,12 @@ int main(int argc, char **argv) {
 		Timer timer;
 		unsigned int threads;
 		auto options = read_options(vm, threads);
-		SharkRunner(options, threads).run();
+		if (vm.count("models") != 0) {
+			SharkRunner::run(read_models(vm, options), threads);
+		}
+		else {
+			SharkRunner(options, threads).run();
+		}
 		LOG(info) << "Successfully finished in " << timer;
 
 		return 0;
@@ -25,12 +25,14 @@
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 #include <tuple>
 
+#include "arena.h"
 #include "dark_matter_halos.h"
 #include "exceptions.h"
 #include "logging.h"
@@ -53,7 +55,7 @@ SURFSReader::SURFSReader(const std::string &prefix, DarkMatterHalosPtr dark_matt
 
 }
 
-const std::string SURFSReader::get_filename(int batch)
+const std::string SURFSReader::get_filename(int batch) const
 {
 	std::ostringstream os;
 	os << prefix << "." << batch << ".hdf5";
@@ -143,6 +145,13 @@ const std::vector<SubhaloPtr> SURFSReader::read_subhalos(unsigned int batch)
 		subhalos.reserve(n_subhalos / threads);
 	}
 
+	// Each thread allocates its subhalos contiguously from its own arena,
+	// which is released only once all subhalos of this batch are gone
+	std::vector<ArenaPtr> arenas(std::max(threads, 1u));
+	for (auto &arena: arenas) {
+		arena = std::make_shared<Arena>();
+	}
+
 	omp_static_for(0, n_subhalos, threads, [&](std::size_t i, int thread_idx) {
 
 		if (snap[i] < simulation_params.min_snapshot) {
@@ -157,7 +166,7 @@ const std::vector<SubhaloPtr> SURFSReader::read_subhalos(unsigned int batch)
 			}
 		}
 
-		auto subhalo = std::make_shared<Subhalo>(nodeIndex[i], snap[i]);
+		auto subhalo = make_arena_shared<Subhalo>(arenas[thread_idx], nodeIndex[i], snap[i]);
 
 		// Subhalo and Halo index, snapshot
 		subhalo->haloID = hostIndex[i];
@@ -220,7 +229,7 @@ const std::vector<SubhaloPtr> SURFSReader::read_subhalos(unsigned int batch)
 
 		double npart = Mvir[i]/simulation_params.particle_mass;
 
-		subhalo->lambda = dark_matter_halos->halo_lambda(subhalo->L, Mvir[i], z, npart);
+		subhalo->lambda = dark_matter_halos->halo_lambda(*subhalo, Mvir[i], z, npart);
 
 		// Calculate virial velocity from the virial mass and redshift.
 		subhalo->Vvir = dark_matter_halos->halo_virial_velocity(subhalo->Mvir, z);
@@ -257,6 +266,7 @@ const std::vector<HaloPtr> SURFSReader::read_halos(unsigned int batch)
 	LOG(info) << "Sorted subhalos by haloID, creating Halos now";
 
 	// Create and assign Halos
+	auto arena = std::make_shared<Arena>();
 	HaloPtr halo;
 	std::vector<HaloPtr> halos;
 	Halo::id_t last_halo_id = -1;
@@ -269,7 +279,7 @@ const std::vector<HaloPtr> SURFSReader::read_halos(unsigned int batch)
 				halos.emplace_back(std::move(halo));
 			}
 			last_halo_id = halo_id;
-			halo = std::make_shared<Halo>(halo_id, subhalo->snapshot);
+			halo = make_arena_shared<Halo>(arena, halo_id, subhalo->snapshot);
 		}
 
 		if (LOG_ENABLED(trace)) {
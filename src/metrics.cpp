@@ -0,0 +1,142 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Implementation of the metrics classes
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+
+#include <boost/filesystem.hpp>
+
+#include "exceptions.h"
+#include "metrics.h"
+
+namespace shark {
+
+namespace {
+
+void write_json_string(std::ostream &os, const std::string &s)
+{
+	os << '"';
+	for (char c: s) {
+		switch (c) {
+		case '"':
+			os << "\\\"";
+			break;
+		case '\\':
+			os << "\\\\";
+			break;
+		case '\n':
+			os << "\\n";
+			break;
+		case '\t':
+			os << "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec << std::setfill(' ');
+			}
+			else {
+				os << c;
+			}
+		}
+	}
+	os << '"';
+}
+
+}  // anonymous namespace
+
+metrics_record &metrics_record::add(const std::string &name, const std::string &value)
+{
+	start_field(name);
+	write_json_string(fields, value);
+	return *this;
+}
+
+metrics_record &metrics_record::add(const std::string &name, const metrics_record &value)
+{
+	start_field(name);
+	write_value(value);
+	return *this;
+}
+
+std::string metrics_record::str() const
+{
+	return "{" + fields.str() + "}";
+}
+
+void metrics_record::start_field(const std::string &name)
+{
+	if (fields.tellp() > 0) {
+		fields << ',';
+	}
+	write_json_string(fields, name);
+	fields << ':';
+}
+
+void metrics_record::write_value(bool value)
+{
+	fields << (value ? "true" : "false");
+}
+
+void metrics_record::write_value(double value)
+{
+	if (!std::isfinite(value)) {
+		fields << "null";
+		return;
+	}
+	fields << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+}
+
+void metrics_record::write_value(const metrics_record &value)
+{
+	fields << value.str();
+}
+
+MetricsWriter::MetricsWriter(const std::string &filename) :
+	filename(filename)
+{
+	boost::filesystem::path dirname = boost::filesystem::path(filename).parent_path();
+	if (!dirname.empty() && !boost::filesystem::exists(dirname)) {
+		boost::filesystem::create_directories(dirname);
+	}
+	f.open(filename, std::ios::out | std::ios::app);
+	if (!f) {
+		std::ostringstream os;
+		os << "Error when opening metrics file '" << filename << "': " << strerror(errno);
+		throw exception(os.str());
+	}
+}
+
+void MetricsWriter::write(const metrics_record &record)
+{
+	auto line = record.str();
+	std::lock_guard<std::mutex> lock(mutex);
+	f << line << std::endl;
+}
+
+}  // namespace shark
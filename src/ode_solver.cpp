@@ -43,11 +43,16 @@ ODESolver::ODESolver(ode_evaluator evaluator, size_t dimension, double precision
 }
 
 void ODESolver::evolve(std::vector<double> &y, double delta_t)
+{
+	evolve(y.data(), delta_t);
+}
+
+void ODESolver::evolve(double y[], double delta_t)
 {
 	double t0 = 0;
 	double t1 = t0 + delta_t;
 	gsl_odeiv2_driver_reset_hstart(driver.get(), delta_t);
-	int status = gsl_odeiv2_driver_apply(driver.get(), &t0, t1, y.data());
+	int status = gsl_odeiv2_driver_apply(driver.get(), &t0, t1, y);
 
 	// TODO: add compiler-dependent likelihood macro
 	if (status == GSL_SUCCESS) {
@@ -59,8 +64,8 @@ void ODESolver::evolve(std::vector<double> &y, double delta_t)
 	std::ostringstream os;
 	os << "Error while solving ODE system: ";
 	if (status == GSL_FAILURE) {
-		os << "step size decreases below machine precision ";
-		LOG(warning) << "ODE: step size decreases below machine precision. Will force integration to finish regardless of desired accuracy not reached.";
+		// y holds the values of the last accepted step, which are kept
+		LOG(warning) << "ODE: step size decreases below machine precision. Integration stops before the end of the time step, with the desired accuracy not reached.";
 		return;
 	}
 	if (status == GSL_ENOPROG) {
@@ -89,4 +94,9 @@ std::size_t ODESolver::num_evaluations()
 	return driver->n;
 }
 
+std::size_t ODESolver::num_rejected_steps()
+{
+	return driver->e->failed_steps;
+}
+
 }  // namespace shark
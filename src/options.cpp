@@ -122,6 +122,19 @@ void Options::store_option(const std::string &name, const std::string &value)
 	options[name] = value;
 }
 
+Options::options_t Options::get_group(const std::string &group) const
+{
+	auto prefix = group + '.';
+	options_t group_options;
+	for (auto it = options.lower_bound(prefix); it != options.end(); it++) {
+		if (it->first.compare(0, prefix.size(), prefix) != 0) {
+			break;
+		}
+		group_options.insert(*it);
+	}
+	return group_options;
+}
+
 void Options::parse_option(const std::string &optspec, std::string &name, std::string &value)
 {
 	auto tokens = tokenize(optspec, "=");
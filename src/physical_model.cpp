@@ -27,6 +27,7 @@
 #include <memory>
 #include <vector>
 
+#include "cash_karp_ode_solver.h"
 #include "logging.h"
 #include "numerical_constants.h"
 #include "physical_model.h"
@@ -94,7 +95,9 @@ int basic_physicalmodel_evaluator(double t, const double y[], double f[], void *
 	}
 
 	// Calculate SFR.
+	auto intervals = model.star_formation.get_integration_intervals();
 	double SFR   = model.star_formation.star_formation_rate(y[1], y[0], params->rgas, params->rstar, zcold, params->redshift, params->burst, params->vgal, jrate, jgas);
+	params->integration_intervals += model.star_formation.get_integration_intervals() - intervals;
 
 	// Initialize mass loading and angular momentum loading parameters related to star formation.
 	double beta1 = 0, beta2 = 0;
@@ -142,8 +145,113 @@ int basic_physicalmodel_evaluator(double t, const double y[], double f[], void *
 	return 0;
 }
 
+using ode_batch_mask = std::array<bool, ExecutionParameters::MAX_ODE_BATCH_SIZE>;
+
+/**
+ * Like basic_physicalmodel_evaluator, but evaluates the ODE systems of the
+ * first @p n_lanes lanes of a batch that are set in @p active together, each
+ * with its own element of @p params. The equations of all lanes are computed
+ * at once, and so are the star formation rates of galaxies whose kernels are
+ * tabulated. The rest of the star formation rates, and the feedback, are still
+ * calculated one galaxy at a time.
+ */
+static
+int basic_physicalmodel_batch_evaluator(const ode_batch_mask &active, std::size_t n_lanes, const BasicPhysicalModel::ode_batch_state &y, BasicPhysicalModel::ode_batch_state &f, std::vector<BasicPhysicalModel::solver_params> &params) {
+
+	constexpr std::size_t W = ExecutionParameters::MAX_ODE_BATCH_SIZE;
+	using lanes = star_formation_batch<W>::lanes;
+
+	auto &model = static_cast<BasicPhysicalModel &>(params[0].model);
+
+	double R = model.recycling_parameters.recycle; /*recycling fraction of newly formed stars*/
+
+	double yield = model.recycling_parameters.yield; /*yield of newly formed stars*/
+
+	double pre_enrich_z = model.gas_cooling_parameters.pre_enrich_z; /*minimum gas metallicity*/
+
+	// Define current gas metallicities and angular momentum, see basic_physicalmodel_evaluator
+	star_formation_batch<W> sf {};
+	lanes mcoolrate {}, jcold_halo {}, zhot {};
+	for (std::size_t l = 0; l != n_lanes; l++) {
+		const auto &p = params[l];
+		mcoolrate[l] = p.mcoolrate;
+		jcold_halo[l] = p.jcold_halo;
+		sf.mcold[l] = y[1][l];
+		sf.mstars[l] = y[0][l];
+		sf.rgas[l] = p.rgas;
+		sf.rstars[l] = p.rstar;
+		sf.z[l] = p.redshift;
+		sf.burst[l] = p.burst;
+		sf.vgal[l] = p.vgal;
+		bool has_cold_metals = y[1][l] > 0 && y[7][l] > 0;
+		sf.zgas[l] = has_cold_metals ? y[7][l] / y[1][l] : pre_enrich_z;
+		sf.jgas[l] = has_cold_metals ? y[15][l] / y[1][l] : 2.0 * p.vgal * p.rgas / constants::RDISK_HALF_SCALE;
+		zhot[l] = (y[2][l] > 0 && y[8][l] > 0) ? y[8][l] / y[2][l] : pre_enrich_z;
+	}
+
+	// Calculate SFR, integrating it for the galaxies whose kernels are not tabulated.
+	auto tabulated = model.star_formation.tabulated_star_formation_rates(active, n_lanes, sf);
+	for (std::size_t l = 0; l != n_lanes; l++) {
+		if (!active[l] || tabulated[l]) {
+			continue;
+		}
+		auto intervals = model.star_formation.get_integration_intervals();
+		sf.sfr[l] = model.star_formation.star_formation_rate(sf.mcold[l], sf.mstars[l], sf.rgas[l], sf.rstars[l], sf.zgas[l], sf.z[l], sf.burst[l], sf.vgal[l], sf.jrate[l], sf.jgas[l]);
+		params[l].integration_intervals += model.star_formation.get_integration_intervals() - intervals;
+	}
+
+	// Calculate mass and angular momentum loading from stellar feedback and QSO outflows.
+	lanes beta1 {}, beta2 {}, betaj_1 {}, betaj_2 {}, beta_qso1 {}, beta_qso2 {};
+	for (std::size_t l = 0; l != n_lanes; l++) {
+		if (!active[l]) {
+			continue;
+		}
+		const auto &p = params[l];
+		model.stellar_feedback.outflow_rate(sf.sfr[l], p.vsubh, p.vgal, p.redshift, beta1[l], beta2[l], betaj_1[l], betaj_2[l]);
+		model.agn_feedback.qso_outflow_rate(y[1][l], p.mBHacc, p.mBH, sf.zgas[l], p.vgal, sf.sfr[l], y[0][l]+y[1][l], p.rstar, beta_qso1[l], beta_qso2[l]);
+	}
+
+	// Retained fraction.
+	double rsub = 1.0-R;
+
+	for (std::size_t l = 0; l != n_lanes; l++) {
+		double SFR = sf.sfr[l];
+		double zcold = sf.zgas[l];
+		double jrate = sf.jrate[l];
+
+		// Mass transfer equations.
+		f[0][l] = SFR * rsub;
+		f[1][l] = mcoolrate[l] - (rsub + beta1[l] + beta_qso1[l]) * SFR;
+		f[2][l] = - mcoolrate[l];
+		f[3][l] = (beta1[l] + beta_qso1[l] - (beta2[l] + beta_qso2[l])) * SFR;
+		f[4][l] = beta2[l] * SFR;
+		f[5][l] = beta_qso2[l] * SFR;
+
+		// Metallicity transfer equations.
+		f[6][l] = rsub * zcold * SFR;
+		f[7][l] = mcoolrate[l] * zhot[l] + SFR * (yield - (rsub + beta1[l] + beta_qso1[l]) * zcold);
+		f[8][l] = - mcoolrate[l] * zhot[l];
+		f[9][l] = f[3][l] * zcold;
+		f[10][l] = beta2[l] * zcold * SFR;
+		f[11][l] = beta_qso2[l]  * zcold * SFR;
+
+		// Keeps track of total stellar mass formed and the metals locked up in it..
+		f[12][l] = SFR;
+		f[13][l] = zcold * SFR;
+
+		// Solve angular momentum equations.
+		f[14][l] = rsub * jrate;
+		f[15][l] = mcoolrate[l] * jcold_halo[l] - (rsub + betaj_1[l]) * jrate;
+		f[16][l] = - mcoolrate[l] * jcold_halo[l];
+		f[17][l] = (betaj_1[l] - betaj_2[l]) * jrate;
+		f[18][l] = betaj_2[l] * jrate;
+	}
+
+	return 0;
+}
+
 BasicPhysicalModel::BasicPhysicalModel(
-		double ode_solver_precision,
+		const ExecutionParameters &exec_params,
 		GasCooling gas_cooling,
 		StellarFeedback stellar_feedback,
 		StarFormation star_formation,
@@ -151,7 +259,7 @@ BasicPhysicalModel::BasicPhysicalModel(
 		RecyclingParameters recycling_parameters,
 		GasCoolingParameters gas_cooling_parameters,
 		AGNFeedbackParameters agn_parameters) :
-	PhysicalModel(ode_solver_precision, basic_physicalmodel_evaluator, std::move(gas_cooling)),
+	PhysicalModel(exec_params, basic_physicalmodel_evaluator, std::move(gas_cooling)),
 	stellar_feedback(stellar_feedback),
 	star_formation(std::move(star_formation)),
 	agn_feedback(std::move(agn_feedback)),
@@ -162,7 +270,48 @@ BasicPhysicalModel::BasicPhysicalModel(
 	// no-op
 }
 
-void BasicPhysicalModel::from_galaxy(std::vector<double> &y, const Subhalo &subhalo, const Galaxy &galaxy)
+namespace {
+
+/// Adapts basic_physicalmodel_evaluator to the interface of CashKarpODESolver
+struct basic_physicalmodel_functor {
+	BasicPhysicalModel::solver_params &params;
+	int operator()(double t, const BasicPhysicalModel::ode_state &y, BasicPhysicalModel::ode_state &f) const
+	{
+		return basic_physicalmodel_evaluator(t, y.data(), f.data(), &params);
+	}
+};
+
+/// Adapts basic_physicalmodel_batch_evaluator to the interface of BatchedCashKarpODESolver
+struct basic_physicalmodel_batch_functor {
+	std::vector<BasicPhysicalModel::solver_params> &params;
+	int operator()(const ode_batch_mask &active, std::size_t n_lanes, const std::array<double, ExecutionParameters::MAX_ODE_BATCH_SIZE> &,
+	               const BasicPhysicalModel::ode_batch_state &y, BasicPhysicalModel::ode_batch_state &f) const
+	{
+		return basic_physicalmodel_batch_evaluator(active, n_lanes, y, f, params);
+	}
+};
+
+}  // anonymous namespace
+
+BasicPhysicalModel::ode_cost BasicPhysicalModel::evolve_builtin(ode_state &y, solver_params &params, double delta_t)
+{
+	auto solver = make_cash_karp_ode_solver<19>(basic_physicalmodel_functor {params}, ode_solver_precision);
+	solver.evolve(y, delta_t);
+	return {solver.num_evaluations(), solver.num_rejected_steps()};
+}
+
+BasicPhysicalModel::ode_batch_cost BasicPhysicalModel::evolve_builtin_batch(ode_batch_state &y, std::size_t n_lanes, std::vector<solver_params> &params, double delta_t)
+{
+	auto solver = make_batched_cash_karp_ode_solver<19, ExecutionParameters::MAX_ODE_BATCH_SIZE>(basic_physicalmodel_batch_functor {params}, ode_solver_precision);
+	solver.evolve(y, n_lanes, delta_t);
+	ode_batch_cost costs {};
+	for (std::size_t lane = 0; lane != n_lanes; lane++) {
+		costs[lane] = {solver.num_evaluations(lane), solver.num_rejected_steps(lane)};
+	}
+	return costs;
+}
+
+void BasicPhysicalModel::from_galaxy(ode_state &y, const Subhalo &subhalo, const Galaxy &galaxy)
 {
 
 	/** Variables introduced to solve ODE equations.
@@ -220,7 +369,7 @@ void BasicPhysicalModel::from_galaxy(std::vector<double> &y, const Subhalo &subh
 	y[18] = subhalo.ejected_galaxy_gas.sAM * subhalo.ejected_galaxy_gas.mass;
 }
 
-void BasicPhysicalModel::to_galaxy(const std::vector<double> &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t)
+void BasicPhysicalModel::to_galaxy(const ode_state &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t)
 {
 	using namespace constants;
 
@@ -333,7 +482,7 @@ void BasicPhysicalModel::to_galaxy(const std::vector<double> &y, Subhalo &subhal
 }
 
 
-void BasicPhysicalModel::from_galaxy_starburst(std::vector<double> &y, const Subhalo &subhalo, const Galaxy &galaxy)
+void BasicPhysicalModel::from_galaxy_starburst(ode_state &y, const Subhalo &subhalo, const Galaxy &galaxy)
 {
 	/** Variables introduced to solve ODE equations.
 	 * y[0]: stellar mass of galaxy.
@@ -385,7 +534,7 @@ void BasicPhysicalModel::from_galaxy_starburst(std::vector<double> &y, const Sub
 	// Equations of angular momentum exchange are ignored in the case of starbursts.
 }
 
-void BasicPhysicalModel::to_galaxy_starburst(const std::vector<double> &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t, bool from_galaxy_merger)
+void BasicPhysicalModel::to_galaxy_starburst(const ode_state &y, Subhalo &subhalo, Galaxy &galaxy, double delta_t, bool from_galaxy_merger)
 {
 	using namespace constants;
 
@@ -23,27 +23,40 @@
  * Main shark runner class
  */
 
+#include <algorithm>
+#include <ctime>
+#include <future>
+#include <map>
 #include <memory>
 #include <numeric>
 #include <ostream>
 #include <vector>
 
+#include "checkpoint.h"
 #include "components.h"
+#include "config.h"
 #include "evolve_halos.h"
+#include "exceptions.h"
 #include "execution.h"
 #include "disk_instability.h"
 #include "environment.h"
 #include "galaxy_creator.h"
 #include "galaxy_mergers.h"
+#include "galaxy_profiler.h"
 #include "galaxy_writer.h"
+#include "git_revision.h"
 #include "logging.h"
 #include "merger_tree_reader.h"
+#include "metrics.h"
 #include "omp_utils.h"
 #include "options.h"
 #include "physical_model.h"
 #include "shark_runner.h"
 #include "timer.h"
+#include "tracer.h"
 #include "tree_builder.h"
+#include "tree_cache.h"
+#include "utils.h"
 
 namespace shark {
 
@@ -56,11 +69,12 @@ namespace shark {
 // The
 struct PerThreadObjects
 {
-	PerThreadObjects(std::shared_ptr<BasicPhysicalModel> &&physical_model, GalaxyMergers &&galaxy_megers, DiskInstability &&disk_instability):
-		physical_model(std::move(physical_model)), galaxy_mergers(std::move(galaxy_megers)), disk_instability(std::move(disk_instability)) {}
+	PerThreadObjects(std::shared_ptr<BasicPhysicalModel> &&physical_model, GalaxyMergers &&galaxy_megers, DiskInstability &&disk_instability, StarFormation &&star_formation):
+		physical_model(std::move(physical_model)), galaxy_mergers(std::move(galaxy_megers)), disk_instability(std::move(disk_instability)), star_formation(std::move(star_formation)) {}
 	std::shared_ptr<BasicPhysicalModel> physical_model;
 	GalaxyMergers galaxy_mergers;
 	DiskInstability disk_instability;
+	StarFormation star_formation;
 };
 
 /// Structure containing detailed runtimes for the impl::evolve_merger_tree routine
@@ -69,6 +83,7 @@ struct evolution_times {
 	Timer::duration subhalos_mergers = 0;
 	Timer::duration galaxy_evolution = 0;
 	Timer::duration disk_instability_evaluation = 0;
+	Timer::duration molecular_gas = 0;
 
 	evolution_times &operator +=(const evolution_times &rhs)
 	{
@@ -76,6 +91,7 @@ struct evolution_times {
 		subhalos_mergers += rhs.subhalos_mergers;
 		galaxy_evolution += rhs.galaxy_evolution;
 		disk_instability_evaluation += rhs.disk_instability_evaluation;
+		molecular_gas += rhs.molecular_gas;
 		return *this;
 	}
 
@@ -86,6 +102,13 @@ struct evolution_times {
 	}
 };
 
+/// A merger tree scheduled for evolution, together with its estimated cost
+struct scheduled_tree {
+	std::size_t tree_idx;
+	std::size_t n_galaxies;
+	double cost;
+};
+
 /// impl class definition
 class SharkRunner::impl {
 public:
@@ -98,17 +121,23 @@ public:
 	    gas_cooling_params(options),recycling_params(options), reincorporation_params(options),
 	    simulation_params(options), star_formation_params(options),
 	    cosmology(make_cosmology(cosmo_params)),
-	    dark_matter_halos(make_dark_matter_halos(dark_matter_halo_params, cosmology, simulation_params, exec_params)),
-	    writer(make_galaxy_writer(exec_params, cosmo_params, cosmology, dark_matter_halos, simulation_params)),
 	    simulation(simulation_params, cosmology),
+	    snapshot_times(simulation.get_snapshot_times()),
+	    dark_matter_halos(make_dark_matter_halos(dark_matter_halo_params, cosmology, simulation_params, exec_params)),
+	    writer(make_galaxy_writer(exec_params, cosmo_params, cosmology, dark_matter_halos, simulation_params, snapshot_times)),
 	    star_formation(star_formation_params, recycling_params, cosmology)
 	{
 		create_per_thread_objects();
+		start_metrics();
+		start_tracing();
 	}
 
 	/// @see SharkRunner::run
 	void run();
 
+	/// @see SharkRunner::run(const std::vector<Options> &, unsigned int)
+	static void run(const std::vector<Options> &models, unsigned int threads);
+
 private:
 	Options options;
 	unsigned int threads;
@@ -122,18 +151,34 @@ private:
 	SimulationParameters simulation_params;
 	StarFormationParameters star_formation_params;
 	CosmologyPtr cosmology;
+	Simulation simulation;
+	SnapshotTimesPtr snapshot_times;
 	DarkMatterHalosPtr dark_matter_halos;
 	GalaxyWriterPtr writer;
-	Simulation simulation;
 	StarFormation star_formation;
 	std::vector<PerThreadObjects> thread_objects;
 	TotalBaryon all_baryons;
+	std::unique_ptr<Checkpoint> checkpoint;
+	MetricsWriterPtr metrics;
+	TracerPtr tracer;
+
+	/// ODE evaluations per galaxy measured for each merger tree in the
+	/// previous snapshot, or a negative number if unknown
+	std::vector<double> tree_evaluations_per_galaxy;
 
 	void create_per_thread_objects();
-	std::vector<MergerTreePtr> import_trees();
+	std::string run_output_filename(const std::string &name, const std::string &extension);
+	void start_metrics();
+	void start_tracing();
+	std::string tree_key();
+	std::vector<MergerTreePtr> import_trees(unsigned int import_threads);
+	void evolve(const std::vector<MergerTreePtr> &merger_trees);
+	void evolve(const std::vector<MergerTreePtr> &merger_trees, int first_snapshot);
+	void run_streaming();
+	void run_from_checkpoint();
+	std::vector<scheduled_tree> schedule_merger_trees(const std::vector<MergerTreePtr> &merger_trees, int snapshot);
 	void evolve_merger_trees(const std::vector<MergerTreePtr> &merger_trees, int snapshot);
-	evolution_times evolve_merger_tree(const MergerTreePtr &tree, int thread_idx, int snapshot, double z, double delta_t);
-	molgas_per_galaxy get_molecular_gas(const std::vector<HaloPtr> &halos, double z, bool calc_j);
+	evolution_times evolve_merger_tree(const MergerTreePtr &tree, int thread_idx, int snapshot, double z, double delta_t, bool calc_molgas_j);
 
 };
 
@@ -150,6 +195,11 @@ void SharkRunner::run()
 	pimpl->run();
 }
 
+void SharkRunner::run(const std::vector<Options> &models, unsigned int threads)
+{
+	impl::run(models, threads);
+}
+
 struct SnapshotStatistics {
 
 	int snapshot;
@@ -160,6 +210,23 @@ struct SnapshotStatistics {
 	std::size_t n_subhalos;
 	std::size_t n_galaxies;
 	Timer::duration duration_millis;
+	Timer::duration evolution_duration;
+	std::vector<Timer::duration> thread_busy_times;
+
+	Timer::duration thread_idle_time(std::size_t thread_idx) const {
+		return std::max(Timer::duration(0), evolution_duration - thread_busy_times[thread_idx]);
+	}
+
+	double idle_fraction() const {
+		if (evolution_duration == 0 || thread_busy_times.empty()) {
+			return 0;
+		}
+		Timer::duration total_idle = 0;
+		for (std::size_t i = 0; i != thread_busy_times.size(); i++) {
+			total_idle += thread_idle_time(i);
+		}
+		return static_cast<double>(total_idle) / (evolution_duration * thread_busy_times.size());
+	}
 
 	double galaxy_ode_evaluations_per_galaxy() const {
 		if (n_galaxies == 0) {
@@ -196,7 +263,13 @@ std::basic_ostream<T> &operator<<(std::basic_ostream<T> &os, const SnapshotStati
 	   << " (" << fixed<3>(stats.starburst_ode_evaluations_per_galaxy()) << " [evals/gal])" << "\n"
 	   << "  Star formation integration intervals: " << stats.starform_integration_intervals
 	   << " (" << fixed<3>(stats.starform_integration_intervals_per_galaxy_ode_evaluations()) << " [ints/eval])\n"
-	   << "  Time:                                 " << fixed<3>(stats.duration_millis / 1000.) << " [s]";
+	   << "  Time:                                 " << fixed<3>(stats.duration_millis / 1000.) << " [s]\n"
+	   << "  Tree evolution time:                  " << ns_time(stats.evolution_duration)
+	   << " (" << fixed<3>(stats.idle_fraction() * 100) << "% threads idle)";
+	for (std::size_t i = 0; i != stats.thread_busy_times.size(); i++) {
+		os << "\n    Thread " << i << " busy/idle:               "
+		   << ns_time(stats.thread_busy_times[i]) << " / " << ns_time(stats.thread_idle_time(i));
+	}
 	return os;
 }
 
@@ -206,10 +279,41 @@ std::basic_ostream<T> &operator<<(std::basic_ostream<T> &os, const evolution_tim
 	os << "galaxy mergers: " << ns_time(times.galaxy_mergers)
 	   << ", disk instability: " << ns_time(times.disk_instability_evaluation)
 	   << ", galaxy evolution: " << ns_time(times.galaxy_evolution)
-	   << ", subhalos mergers: " << ns_time(times.subhalos_mergers);
+	   << ", subhalos mergers: " << ns_time(times.subhalos_mergers)
+	   << ", molecular gas: " << ns_time(times.molecular_gas);
 	return os;
 }
 
+/// The per-thread breakdown of the evolution times, with one array per phase
+metrics_record thread_metrics(const std::vector<evolution_times> &times, const std::vector<Timer::duration> &busy_times)
+{
+	auto column = [&times](Timer::duration evolution_times::*phase) {
+		std::vector<Timer::duration> values;
+		for (auto &thread_times: times) {
+			values.push_back(thread_times.*phase);
+		}
+		return values;
+	};
+
+	metrics_record record;
+	record.add("busy", busy_times)
+	      .add("galaxy_mergers", column(&evolution_times::galaxy_mergers))
+	      .add("disk_instability", column(&evolution_times::disk_instability_evaluation))
+	      .add("galaxy_evolution", column(&evolution_times::galaxy_evolution))
+	      .add("subhalos_mergers", column(&evolution_times::subhalos_mergers))
+	      .add("molecular_gas", column(&evolution_times::molecular_gas));
+	return record;
+}
+
+/// The current and peak memory usage of the process
+metrics_record memory_metrics()
+{
+	metrics_record record;
+	record.add("rss", current_rss())
+	      .add("peak_rss", peak_rss());
+	return record;
+}
+
 void SharkRunner::impl::create_per_thread_objects()
 {
 	AGNFeedbackParameters agn_params(options);
@@ -228,56 +332,146 @@ void SharkRunner::impl::create_per_thread_objects()
 	GasCooling gas_cooling {gas_cooling_params, star_formation_params, reionisation, cosmology, agnfeedback, dark_matter_halos, reincorporation, environment};
 
 	for(unsigned int i = 0; i != threads; i++) {
-		auto physical_model = std::make_shared<BasicPhysicalModel>(exec_params.ode_solver_precision, gas_cooling, stellar_feedback, star_formation, *agnfeedback,
+		auto physical_model = std::make_shared<BasicPhysicalModel>(exec_params, gas_cooling, stellar_feedback, star_formation, *agnfeedback,
 				recycling_params, gas_cooling_params, agn_params);
-		GalaxyMergers galaxy_mergers(merger_parameters, cosmology, exec_params, simulation_params, dark_matter_halos, physical_model, agnfeedback);
+		GalaxyMergers galaxy_mergers(merger_parameters, cosmology, exec_params, simulation_params, snapshot_times, dark_matter_halos, physical_model, agnfeedback);
 		DiskInstability disk_instability(disk_instability_params, merger_parameters, simulation_params, dark_matter_halos, physical_model, agnfeedback);
-		thread_objects.emplace_back(std::move(physical_model), std::move(galaxy_mergers), std::move(disk_instability));
+		StarFormation thread_star_formation(star_formation);
+		thread_objects.emplace_back(std::move(physical_model), std::move(galaxy_mergers), std::move(disk_instability), std::move(thread_star_formation));
 	}
 }
 
-std::vector<MergerTreePtr> SharkRunner::impl::import_trees()
+std::string SharkRunner::impl::run_output_filename(const std::string &name, const std::string &extension)
 {
-	Timer t;
-	SURFSReader reader(simulation_params.tree_files_prefix, dark_matter_halos, simulation_params, threads);
-	HaloBasedTreeBuilder tree_builder(exec_params, threads);
-	auto halos = reader.read_halos(exec_params.simulation_batches);
-	auto trees = tree_builder.build_trees(halos, simulation_params, gas_cooling_params, cosmology, all_baryons);
-	LOG(info) << trees.size() << " Merger trees imported in " << t;
-	return trees;
+	return exec_params.output_directory + "/" + simulation_params.sim_name + "/" +
+	       exec_params.name_model + "/" + name + "_" + exec_params.batch_directory() + extension;
 }
 
-void _get_molecular_gas(const HaloPtr &halo, molgas_per_galaxy &molgas, StarFormation &star_formation, double z, bool calc_j)
+void SharkRunner::impl::start_metrics()
 {
-	for (auto &subhalo: halo->all_subhalos()) {
-		for (auto &galaxy: subhalo->galaxies) {
-			molgas[galaxy] = star_formation.get_molecular_gas(galaxy, z, calc_j);
-		}
+	if (!exec_params.write_metrics) {
+		return;
 	}
+
+	auto filename = run_output_filename("metrics", ".jsonl");
+	metrics = std::make_shared<MetricsWriter>(filename);
+	LOG(info) << "Writing execution metrics to " << filename;
+
+	char time_str[20];
+	std::strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S", std::gmtime(&exec_params.starting_time));
+
+	metrics_record record;
+	record.add("type", "run")
+	      .add("timestamp", std::string(time_str))
+	      .add("shark_version", SHARK_VERSION)
+	      .add("shark_git_revision", git_sha1())
+	      .add("shark_git_has_local_changes", git_has_local_changes())
+	      .add("hostname", gethostname())
+	      .add("model", exec_params.name_model)
+	      .add("batches", exec_params.simulation_batches)
+	      .add("threads", threads)
+	      .add("ode_solver_precision", exec_params.ode_solver_precision)
+	      .add("ode_batch_size", exec_params.ode_batch_size)
+	      .add("async_output", exec_params.async_output);
+	metrics->write(record);
 }
 
-molgas_per_galaxy SharkRunner::impl::get_molecular_gas(const std::vector<HaloPtr> &halos, double z, bool calc_j)
+void SharkRunner::impl::start_tracing()
 {
+	if (!exec_params.trace) {
+		return;
+	}
+	tracer = std::make_shared<Tracer>(threads, exec_params.trace_buffer_size);
+	writer->set_tracer(tracer);
+}
 
-	std::vector<StarFormation> star_formations(threads, star_formation);
-	std::vector<molgas_per_galaxy> local_molgas(threads);
-
-	omp_static_for(halos, threads, [&](const HaloPtr &halo, int idx){
-		_get_molecular_gas(halo, local_molgas[idx], star_formations[idx], z, calc_j);
-	});
+std::string SharkRunner::impl::tree_key()
+{
+	SURFSReader reader(simulation_params.tree_files_prefix, dark_matter_halos, simulation_params, threads);
+	std::vector<std::string> tree_files;
+	for (auto batch: exec_params.simulation_batches) {
+		tree_files.push_back(reader.get_filename(batch));
+	}
+	return make_tree_cache_key(options, exec_params, simulation_params, dark_matter_halo_params, tree_files);
+}
 
-	if (threads == 1) {
-		return local_molgas[0];
+std::vector<MergerTreePtr> SharkRunner::impl::import_trees(unsigned int import_threads)
+{
+	Timer t;
+	SURFSReader reader(simulation_params.tree_files_prefix, dark_matter_halos, simulation_params, import_threads);
+
+	metrics_record record;
+	record.add("type", "import")
+	      .add("threads", import_threads);
+	auto write_metrics = [&](const std::vector<MergerTreePtr> &trees) {
+		if (tracer) {
+			tracer->record(0, "import", t);
+		}
+		if (metrics) {
+			record.add("trees", trees.size())
+			      .add("total", t.get())
+			      .add("memory", memory_metrics());
+			metrics->write(record);
+		}
+	};
+
+	// Trees don't depend on the physical model, so they can be reused across runs
+	std::unique_ptr<TreeCache> tree_cache;
+	if (!exec_params.tree_cache_directory.empty()) {
+		tree_cache = std::unique_ptr<TreeCache>(new TreeCache(exec_params.tree_cache_directory, tree_key()));
+		try {
+			Timer cache_t;
+			auto trees = tree_cache->load(all_baryons);
+			record.add("cache_load", cache_t.get());
+			if (tracer) {
+				tracer->record(0, "tree cache load", cache_t);
+			}
+			if (!trees.empty()) {
+				LOG(info) << trees.size() << " Merger trees imported from cache in " << t;
+				record.add("from_cache", true);
+				write_metrics(trees);
+				return trees;
+			}
+		} catch (const invalid_data &e) {
+			LOG(warning) << "Cannot use cached merger trees, building them again: " << e.what();
+			all_baryons.baryon_total_created.clear();
+		}
 	}
+	record.add("from_cache", false);
 
-	return std::accumulate(local_molgas.begin(), local_molgas.end(), molgas_per_galaxy(), [](molgas_per_galaxy &mg1, molgas_per_galaxy &mg2) {
-		mg1.insert(mg2.begin(), mg2.end());
-		return mg1;
-	});
+	HaloBasedTreeBuilder tree_builder(exec_params, import_threads);
+	Timer reading_t;
+	auto halos = reader.read_halos(exec_params.simulation_batches);
+	record.add("reading", reading_t.get())
+	      .add("halos", halos.size());
+	if (tracer) {
+		tracer->record(0, "reading", reading_t);
+	}
+	Timer building_t;
+	auto trees = tree_builder.build_trees(halos, simulation_params, gas_cooling_params, cosmology, all_baryons);
+	record.add("building", building_t.get());
+	if (tracer) {
+		tracer->record(0, "tree building", building_t);
+	}
+	LOG(info) << trees.size() << " Merger trees imported in " << t;
 
+	if (tree_cache) {
+		try {
+			Timer cache_t;
+			tree_cache->save(trees, all_baryons);
+			record.add("cache_save", cache_t.get());
+			if (tracer) {
+				tracer->record(0, "tree cache save", cache_t);
+			}
+		} catch (const invalid_data &e) {
+			LOG(warning) << "Merger trees could not be cached: " << e.what();
+		}
+	}
+	write_metrics(trees);
+	return trees;
 }
 
-evolution_times SharkRunner::impl::evolve_merger_tree(const MergerTreePtr &tree, int thread_idx, int snapshot, double z, double delta_t)
+evolution_times SharkRunner::impl::evolve_merger_tree(const MergerTreePtr &tree, int thread_idx, int snapshot, double z, double delta_t, bool calc_molgas_j)
 {
 	// Get the thread-specific objects needed to run the evolution
 	// In the non-OpenMP case we simply have one
@@ -285,11 +479,45 @@ evolution_times SharkRunner::impl::evolve_merger_tree(const MergerTreePtr &tree,
 	auto &physical_model = objs.physical_model;
 	auto &galaxy_mergers = objs.galaxy_mergers;
 	auto &disk_instability = objs.disk_instability;
+	auto &star_formation = objs.star_formation;
 
 	evolution_times times;
+	auto trace = [&](const char *name, const Timer &t, std::int64_t arg) {
+		if (tracer) {
+			tracer->record(thread_idx, name, t, arg);
+		}
+	};
+
+	// Galaxies are either evolved halo by halo, or in batches of halos once
+	// all halos have gone through their mergers and disk instabilities.
+	// Halos don't interact with each other, so both are equivalent.
+	bool batched = exec_params.ode_batch_size > 1;
+
+	auto finish_halo = [&](HaloPtr &halo) {
+
+		/*Determine which subhalos are disappearing in this snapshot and calculate dynamical friction timescale and change galaxy types accordingly.*/
+		if (LOG_ENABLED(debug)) {
+			LOG(debug) << "Merging subhalos in halo " << halo;
+		}
+		Timer t4;
+		galaxy_mergers.merging_subhalos(halo, z, snapshot);
+		times.subhalos_mergers += t4.get();
+		trace("subhalo mergers", t4, halo->id);
+
+		/*Calculate the molecular gas content of the galaxies in their final state for this snapshot.*/
+		Timer t5;
+		for(auto &subhalo: halo->all_subhalos()) {
+			for(auto &galaxy: subhalo->galaxies) {
+				galaxy->molecular_gas = star_formation.get_molecular_gas(galaxy, z, calc_molgas_j);
+			}
+		}
+		times.molecular_gas += t5.get();
+		trace("molecular gas", t5, halo->id);
+	};
 
 	/*here loop over the halos this merger tree has at this time.*/
-	for(auto &halo: tree->halos_at(snapshot)) {
+	auto halos = tree->halos_at(snapshot);
+	for(auto &halo: halos) {
 
 
 		/*Evaluate which galaxies are merging in this halo.*/
@@ -299,6 +527,7 @@ evolution_times SharkRunner::impl::evolve_merger_tree(const MergerTreePtr &tree,
 		Timer t1;
 		galaxy_mergers.merging_galaxies(halo, snapshot, delta_t);
 		times.galaxy_mergers += t1.get();
+		trace("galaxy mergers", t1, halo->id);
 
 		/*Evaluate disk instabilities.*/
 		if (LOG_ENABLED(debug)) {
@@ -307,6 +536,11 @@ evolution_times SharkRunner::impl::evolve_merger_tree(const MergerTreePtr &tree,
 		Timer t2;
 		disk_instability.evaluate_disk_instability(halo, snapshot, delta_t);
 		times.disk_instability_evaluation += t2.get();
+		trace("disk instability", t2, halo->id);
+
+		if (batched) {
+			continue;
+		}
 
 		if (LOG_ENABLED(debug)) {
 			LOG(debug) << "Evolving content in halo " << halo;
@@ -318,19 +552,76 @@ evolution_times SharkRunner::impl::evolve_merger_tree(const MergerTreePtr &tree,
 			}
 		}
 		times.galaxy_evolution += t3.get();
+		trace("galaxy evolution", t3, halo->id);
 
-		/*Determine which subhalos are disappearing in this snapshot and calculate dynamical friction timescale and change galaxy types accordingly.*/
-		if (LOG_ENABLED(debug)) {
-			LOG(debug) << "Merging subhalos in halo " << halo;
+		finish_halo(halo);
+	}
+
+	if (batched) {
+		Timer t3;
+		physical_model->evolve_galaxies(halos, z, delta_t);
+		times.galaxy_evolution += t3.get();
+		trace("batched galaxy evolution", t3, tree->id);
+
+		for(auto &halo: halos) {
+			finish_halo(halo);
 		}
-		Timer t4;
-		galaxy_mergers.merging_subhalos(halo, z, snapshot);
-		times.subhalos_mergers += t4.get();
 	}
 
 	return times;
 }
 
+std::vector<scheduled_tree> SharkRunner::impl::schedule_merger_trees(const std::vector<MergerTreePtr> &merger_trees, int snapshot)
+{
+	// The cost of a tree is dominated by the ODE integration of its galaxies,
+	// while mergers and disk instabilities scale with the number of structures
+	std::vector<scheduled_tree> schedule;
+	schedule.reserve(merger_trees.size());
+	for (std::size_t i = 0; i != merger_trees.size(); i++) {
+		std::size_t n_halos = 0, n_subhalos = 0, n_galaxies = 0;
+		for (auto &halo: merger_trees[i]->halos_at(snapshot)) {
+			n_halos++;
+			n_subhalos += halo->subhalo_count();
+			n_galaxies += halo->galaxy_count();
+		}
+
+		// Trees without galaxies in this snapshot don't get a new measurement,
+		// so whatever was measured for them before is forgotten rather than
+		// being used again once they get galaxies, possibly much later
+		if (n_galaxies == 0) {
+			tree_evaluations_per_galaxy[i] = -1;
+		}
+		if (n_halos != 0) {
+			schedule.push_back({i, n_galaxies, double(n_halos + n_subhalos)});
+		}
+	}
+
+	// Trees that haven't been measured yet are assumed to behave like the average
+	double sum_evaluations = 0;
+	std::size_t n_measured = 0;
+	for (auto evaluations: tree_evaluations_per_galaxy) {
+		if (evaluations >= 0) {
+			sum_evaluations += evaluations;
+			n_measured++;
+		}
+	}
+	double default_evaluations = (n_measured == 0 ? 1 : sum_evaluations / n_measured);
+	for (auto &tree: schedule) {
+		double evaluations = tree_evaluations_per_galaxy[tree.tree_idx];
+		if (evaluations < 0) {
+			evaluations = default_evaluations;
+		}
+		tree.cost += tree.n_galaxies * (1 + evaluations);
+	}
+
+	// Largest trees first, so they don't end up being the last ones
+	// picked up while the rest of the threads are sitting idle
+	std::stable_sort(schedule.begin(), schedule.end(), [](const scheduled_tree &t1, const scheduled_tree &t2) {
+		return t1.cost > t2.cost;
+	});
+	return schedule;
+}
+
 void SharkRunner::impl::evolve_merger_trees(const std::vector<MergerTreePtr> &merger_trees, int snapshot)
 {
 	Timer t;
@@ -340,10 +631,10 @@ void SharkRunner::impl::evolve_merger_trees(const std::vector<MergerTreePtr> &me
 	}
 
 	// Calculate the initial and final time for the evolution start at this snapshot.
-	auto z = simulation_params.redshifts[snapshot];
-	auto z_end = simulation_params.redshifts[snapshot + 1];
-	double ti = simulation.convert_snapshot_to_age(snapshot);
-	double tf = simulation.convert_snapshot_to_age(snapshot + 1);
+	auto z = snapshot_times->redshift(snapshot);
+	auto z_end = snapshot_times->redshift(snapshot + 1);
+	double ti = snapshot_times->age(snapshot);
+	double tf = snapshot_times->age(snapshot + 1);
 	auto delta_t = tf - ti;
 
 	std::ostringstream os;
@@ -351,34 +642,62 @@ void SharkRunner::impl::evolve_merger_trees(const std::vector<MergerTreePtr> &me
 	os << ". Redshift: " << z << " -> " << z_end << ", time: " << ti << " -> " << tf;
 	LOG(info) << os.str();
 
+	// Angular momentum of the molecular and atomic gas is only needed for outputs
+	bool write_galaxies = exec_params.output_snapshot(snapshot + 1);
+
+	Timer scheduling_t;
+	auto schedule = schedule_merger_trees(merger_trees, snapshot);
+	auto scheduling_duration = scheduling_t.get();
+	if (tracer) {
+		tracer->record(0, "scheduling", scheduling_t, snapshot);
+	}
+	auto writing_time_before = writer->get_writing_time();
+
+	// Trees are handed out one by one in decreasing cost order to whichever
+	// thread becomes free first
 	Timer evolution_t;
 	std::vector<evolution_times> times(threads);
-	omp_static_for(merger_trees, threads, [&](const MergerTreePtr &merger_tree, int thread_idx) {
-		times[thread_idx] += evolve_merger_tree(merger_tree, thread_idx, snapshot, simulation_params.redshifts[snapshot], delta_t);
+	std::vector<Timer::duration> busy_times(threads, 0);
+	omp_dynamic_for(schedule, threads, 1, [&](const scheduled_tree &tree, int thread_idx) {
+		Timer busy_t;
+		auto &physical_model = *thread_objects[thread_idx].physical_model;
+		auto evaluations_before = physical_model.get_galaxy_ode_evaluations() + physical_model.get_galaxy_starburst_ode_evaluations();
+		times[thread_idx] += evolve_merger_tree(merger_trees[tree.tree_idx], thread_idx, snapshot, z, delta_t, write_galaxies);
+		if (tree.n_galaxies > 0) {
+			auto evaluations = physical_model.get_galaxy_ode_evaluations() + physical_model.get_galaxy_starburst_ode_evaluations() - evaluations_before;
+			tree_evaluations_per_galaxy[tree.tree_idx] = static_cast<double>(evaluations) / tree.n_galaxies;
+		}
+		busy_times[thread_idx] += busy_t.get();
+		if (tracer) {
+			tracer->record(thread_idx, "tree", busy_t, merger_trees[tree.tree_idx]->id);
+		}
 	});
-	LOG(info) << "Evolved galaxies in " << evolution_t;
+	auto evolution_duration = evolution_t.get();
+	if (tracer) {
+		tracer->record(0, "evolution", evolution_t, snapshot);
+	}
+	LOG(info) << "Evolved galaxies in " << ns_time(evolution_duration);
 	LOG(info) << "Detailed times: " << std::accumulate(times.begin(), times.end(), evolution_times{});
 
 	std::vector<HaloPtr> all_halos_this_snapshot;
 	for (auto &tree: merger_trees) {
-		auto &halos = tree->halos_at(snapshot);
+		auto halos = tree->halos_at(snapshot);
 		all_halos_this_snapshot.insert(all_halos_this_snapshot.end(), halos.begin(), halos.end());
 	}
 
-	bool write_galaxies = exec_params.output_snapshot(snapshot + 1);
-
-	Timer molgas_t;
-	auto molgas_per_gal = get_molecular_gas(all_halos_this_snapshot, z, write_galaxies);
-	LOG(info) << "Calculated molecular gas in " << molgas_t;
-
 	/*track all baryons of this snapshot*/
 	Timer tracking_t;
-	track_total_baryons(*cosmology, exec_params, simulation_params, all_halos_this_snapshot, all_baryons, snapshot, molgas_per_gal, delta_t);
-	LOG(info) << "Total baryon amounts tracked in " << tracking_t;
+	track_total_baryons(*snapshot_times, exec_params, all_halos_this_snapshot, all_baryons, snapshot, delta_t);
+	auto tracking_duration = tracking_t.get();
+	if (tracer) {
+		tracer->record(0, "tracking", tracking_t, snapshot);
+	}
+	LOG(info) << "Total baryon amounts tracked in " << ns_time(tracking_duration);
 
 	/*Here you could include the physics that allow halos to speak to each other. This could be useful e.g. during reionisation.*/
 	//do_stuff_at_halo_level(all_halos_this_snapshot);
 
+	Timer writing_t;
 	if (write_galaxies)
 	{
 		// Note that the output is being done at "snapshot + 1". This is because
@@ -386,7 +705,23 @@ void SharkRunner::impl::evolve_merger_trees(const std::vector<MergerTreePtr> &me
 		// snapshot "i+1", and therefore at this point in time (after the actual
 		// evolution) we consider our galaxies to be at snapshot "i+1"
 		LOG(info) << "Write output files for evolution from snapshot " << snapshot << " to " << snapshot + 1;
-		writer->write(snapshot + 1, all_halos_this_snapshot, all_baryons, molgas_per_gal);
+		writer->write(snapshot + 1, all_halos_this_snapshot, all_baryons);
+	}
+
+	if (exec_params.profile_galaxies) {
+		auto costs = std::make_shared<std::vector<galaxy_cost>>();
+		for (auto &o: thread_objects) {
+			auto thread_costs = o.physical_model->take_galaxy_costs();
+			costs->insert(costs->end(), thread_costs.begin(), thread_costs.end());
+		}
+		auto filename = run_output_filename("profiling", "/galaxy_costs_" + std::to_string(snapshot + 1) + ".hdf5");
+		writer->schedule([filename, snapshot, z_end, costs]() {
+			write_galaxy_costs(filename, snapshot + 1, z_end, std::move(*costs));
+		});
+	}
+	auto writing_duration = writing_t.get();
+	if (tracer) {
+		tracer->record(0, "writing", writing_t, snapshot);
 	}
 
 	auto duration_millis = t.get() / 1000 / 1000;
@@ -410,31 +745,243 @@ void SharkRunner::impl::evolve_merger_trees(const std::vector<MergerTreePtr> &me
 	});
 
 	SnapshotStatistics stats {snapshot, starform_integration_intervals, galaxy_ode_evaluations, starburst_ode_evaluations,
-							  n_halos, n_subhalos, n_galaxies, duration_millis};
+							  n_halos, n_subhalos, n_galaxies, duration_millis, evolution_duration, busy_times};
 	LOG(info) << "Statistics for snapshot " << snapshot << "\n" << stats;
 
 
 	/*transfer galaxies from this halo->subhalos to the next snapshot's halo->subhalos*/
 	LOG(debug) << "Transferring all galaxies for snapshot " << snapshot << " into next snapshot";
+	Timer transfer_t;
 	transfer_galaxies_to_next_snapshot(all_halos_this_snapshot, snapshot, all_baryons);
+	auto transfer_duration = transfer_t.get();
+	if (tracer) {
+		tracer->record(0, "transfer", transfer_t, snapshot);
+		tracer->record(0, "snapshot", t, snapshot);
+	}
+
+	if (!metrics) {
+		return;
+	}
 
+	auto total_times = std::accumulate(times.begin(), times.end(), evolution_times{});
+	metrics_record phases;
+	phases.add("total", t.get())
+	      .add("scheduling", scheduling_duration)
+	      .add("evolution", evolution_duration)
+	      .add("galaxy_mergers", total_times.galaxy_mergers)
+	      .add("disk_instability", total_times.disk_instability_evaluation)
+	      .add("galaxy_evolution", total_times.galaxy_evolution)
+	      .add("subhalos_mergers", total_times.subhalos_mergers)
+	      .add("molecular_gas", total_times.molecular_gas)
+	      .add("tracking", tracking_duration)
+	      .add("writing", writing_duration)
+	      .add("writing_jobs", writer->get_writing_time() - writing_time_before)
+	      .add("transfer", transfer_duration);
+
+	metrics_record counts;
+	counts.add("halos", n_halos)
+	      .add("subhalos", n_subhalos)
+	      .add("galaxies", n_galaxies);
+
+	metrics_record ode;
+	ode.add("galaxy_evaluations", galaxy_ode_evaluations)
+	   .add("starburst_evaluations", starburst_ode_evaluations)
+	   .add("starform_integration_intervals", starform_integration_intervals);
+
+	metrics_record record;
+	record.add("type", "snapshot")
+	      .add("snapshot", snapshot)
+	      .add("redshift", z)
+	      .add("output", write_galaxies)
+	      .add("times", phases)
+	      .add("threads", thread_metrics(times, busy_times))
+	      .add("counts", counts)
+	      .add("ode", ode)
+	      .add("memory", memory_metrics());
+	metrics->write(record);
 }
 
 void SharkRunner::impl::run() {
+	if (exec_params.stream_batches > 0) {
+		run_streaming();
+		return;
+	}
+	if (!exec_params.checkpoint_directory.empty()) {
+		run_from_checkpoint();
+		return;
+	}
+	evolve(import_trees(threads));
+}
+
+void SharkRunner::impl::run_from_checkpoint() {
+
+	auto key = make_checkpoint_key(options, exec_params, tree_key());
+	checkpoint = std::unique_ptr<Checkpoint>(new Checkpoint(exec_params.checkpoint_directory, key));
 
-	std::vector<MergerTreePtr> merger_trees = import_trees();
+	std::vector<MergerTreePtr> merger_trees;
+	int snapshot = -1;
+	try {
+		snapshot = checkpoint->load(merger_trees, all_baryons);
+	} catch (const invalid_data &e) {
+		LOG(warning) << "Cannot resume from checkpoint, starting from the beginning: " << e.what();
+	}
+
+	if (snapshot < 0) {
+		evolve(import_trees(threads));
+		return;
+	}
+	LOG(info) << "Resuming evolution from snapshot " << snapshot;
+	evolve(merger_trees, snapshot);
+}
+
+void SharkRunner::impl::run_streaming() {
+
+	// Each group of batches is run by its own runner, as if it had been
+	// given on its own, and is therefore written into its own batch directory
+	auto groups = exec_params.batch_groups();
+	auto make_group_runner = [&](std::size_t group_idx) {
+		Options group_options(options);
+		std::ostringstream os;
+		os << "execution.simulation_batches =";
+		for (auto batch: groups[group_idx]) {
+			os << " " << batch;
+		}
+		group_options.add(os.str());
+		return std::unique_ptr<impl>(new impl(group_options, threads));
+	};
+
+	auto release = [](std::vector<MergerTreePtr> &merger_trees) {
+		for (auto &tree: merger_trees) {
+			tree->release();
+		}
+		std::vector<MergerTreePtr>().swap(merger_trees);
+	};
+
+	auto group_runner = make_group_runner(0);
+	auto merger_trees = group_runner->import_trees(threads);
+	for (std::size_t i = 0; i != groups.size(); i++) {
+
+		// Trees for the next group are read and built in the background with a
+		// single thread, while this group evolves using all of them
+		std::unique_ptr<impl> next_group_runner;
+		std::future<std::vector<MergerTreePtr>> next_merger_trees;
+		if (i + 1 != groups.size()) {
+			next_group_runner = make_group_runner(i + 1);
+			auto next = next_group_runner.get();
+			next_merger_trees = std::async(std::launch::async, [next]() {
+				return next->import_trees(1);
+			});
+		}
+
+		LOG(info) << "Evolving group of batches " << i + 1 << "/" << groups.size() << " (" << group_runner->exec_params.batch_directory() << ")";
+		Timer t;
+		group_runner->evolve(merger_trees);
+		release(merger_trees);
+		group_runner = std::move(next_group_runner);
+		LOG(info) << "Group of batches " << i + 1 << "/" << groups.size() << " evolved and written in " << t;
+
+		if (group_runner) {
+			Timer wait_t;
+			merger_trees = next_merger_trees.get();
+			LOG(info) << "Waited " << wait_t << " for the merger trees of the next group of batches";
+		}
+	}
+}
+
+void SharkRunner::impl::run(const std::vector<Options> &models, unsigned int threads) {
+
+	std::vector<MergerTreePtr> merger_trees;
+	std::string trees_key;
+	std::map<int, double> baryons_created;
+	for (std::size_t i = 0; i != models.size(); i++) {
+
+		impl model(models[i], threads);
+		if (model.exec_params.stream_batches > 0) {
+			throw invalid_option("execution.stream_batches cannot be used when running several models");
+		}
+		if (!model.exec_params.checkpoint_directory.empty()) {
+			throw invalid_option("execution.checkpoint_directory cannot be used when running several models");
+		}
+		LOG(info) << "Running model " << i + 1 << "/" << models.size() << " (" << model.exec_params.name_model << ")";
+
+		// The first model imports the trees, as it would if it was run on its own
+		if (i == 0) {
+			merger_trees = model.import_trees(threads);
+			trees_key = model.tree_key();
+			baryons_created = model.all_baryons.baryon_total_created;
+			model.evolve(merger_trees);
+			continue;
+		}
+
+		if (model.tree_key() != trees_key) {
+			std::ostringstream os;
+			os << "Model " << i << " changes options the merger trees depend on, ";
+			os << "it cannot be run together with the rest";
+			throw invalid_option(os.str());
+		}
+
+		// Galaxies and gas from the previous model are discarded,
+		// everything else in the merger trees is reused as is
+		Timer t;
+		omp_static_for(merger_trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
+			for (auto &halo: tree->all_halos()) {
+				halo->reset_baryons();
+			}
+		});
+		model.all_baryons.baryon_total_created = baryons_created;
+		LOG(info) << "Reset baryons in merger trees in " << t;
+
+		model.evolve(merger_trees);
+	}
+}
+
+void SharkRunner::impl::evolve(const std::vector<MergerTreePtr> &merger_trees) {
 
 	/* Create the first generation of galaxies if halo is first appearing.*/
 	LOG(info) << "Creating initial galaxies in central subhalos across all merger trees";
 	GalaxyCreator galaxy_creator(cosmology, gas_cooling_params, simulation_params);
 	galaxy_creator.create_galaxies(merger_trees, all_baryons);
 
+	evolve(merger_trees, simulation_params.min_snapshot);
+}
+
+void SharkRunner::impl::evolve(const std::vector<MergerTreePtr> &merger_trees, int first_snapshot) {
+
 	// Go, go, go!
 	// Note that we evolve galaxies in merger tress in the snapshot range [min, max)
 	// This is because at snapshot "i" we don't evolve galaxies AT snapshot "i",
 	// but rather FROM snapshot "i" TO snapshot "i+1".
-	for(int snapshot = simulation_params.min_snapshot; snapshot <= simulation_params.max_snapshot - 1; snapshot++) {
+	Timer evolution_t;
+	tree_evaluations_per_galaxy.assign(merger_trees.size(), -1);
+	for(int snapshot = first_snapshot; snapshot <= simulation_params.max_snapshot - 1; snapshot++) {
 		evolve_merger_trees(merger_trees, snapshot);
+
+		// Checkpoints are written after the outputs of the snapshots they include
+		auto next_snapshot = snapshot + 1;
+		if (checkpoint && next_snapshot < simulation_params.max_snapshot &&
+		    (next_snapshot - simulation_params.min_snapshot) % exec_params.checkpoint_interval == 0) {
+			writer->schedule(checkpoint->prepare_save(next_snapshot, merger_trees, all_baryons));
+		}
+	}
+
+	// Outputs might still be being written in the background
+	Timer t;
+	writer->finish();
+	LOG(info) << "Waited " << t << " for all output files to be written";
+	if (tracer) {
+		tracer->record(0, "waiting for outputs", t);
+		tracer->write(run_output_filename("trace", ".json"));
+	}
+
+	if (metrics) {
+		metrics_record record;
+		record.add("type", "finish")
+		      .add("first_snapshot", first_snapshot)
+		      .add("evolution", evolution_t.get())
+		      .add("waiting_for_outputs", t.get())
+		      .add("writing_jobs", writer->get_writing_time())
+		      .add("memory", memory_metrics());
+		metrics->write(record);
 	}
 }
 
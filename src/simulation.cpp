@@ -98,16 +98,38 @@ void SimulationParameters::load_simulation_tables(const std::string &redshift_fi
 
 }
 
+SnapshotTimes::SnapshotTimes(const SimulationParameters &sim_params, const Cosmology &cosmology) :
+	first_snapshot(sim_params.redshifts.empty() ? 0 : sim_params.redshifts.begin()->first)
+{
+	auto add_time = [&](double z) {
+		times.push_back({z, cosmology.convert_redshift_to_age(z), 1 / (1 + z), cosmology.hubble_parameter(z)});
+	};
+
+	times.reserve(sim_params.redshifts.size() + 1);
+	int expected_snapshot = first_snapshot;
+	for (auto &pair: sim_params.redshifts) {
+		if (pair.first != expected_snapshot) {
+			std::ostringstream os;
+			os << "snapshot " << expected_snapshot << " is missing from the redshift table";
+			throw invalid_data(os.str());
+		}
+		add_time(pair.second);
+		expected_snapshot++;
+	}
+	add_time(0);
+}
+
 Simulation::Simulation(SimulationParameters parameters, CosmologyPtr cosmology) :
 	parameters(std::move(parameters)),
-	cosmology(std::move(cosmology))
+	cosmology(std::move(cosmology)),
+	snapshot_times(std::make_shared<SnapshotTimes>(this->parameters, *this->cosmology))
 {
 	// no-op
 }
 
 double Simulation::convert_snapshot_to_age(int s){
 
-	return cosmology->convert_redshift_to_age(parameters.redshifts[s]);
+	return snapshot_times->age(s);
 
 }
 
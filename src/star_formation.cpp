@@ -21,12 +21,14 @@
  * @file
  */
 
+#include <array>
 #include <cmath>
 #include <gsl/gsl_errno.h>
 
 #include "logging.h"
 #include "numerical_constants.h"
 #include "star_formation.h"
+#include "timer.h"
 #include "utils.h"
 
 namespace shark {
@@ -45,6 +47,7 @@ StarFormationParameters::StarFormationParameters(const Options &options)
 	options.load("star_formation.model", model, true);
 	options.load("star_formation.nu_sf", nu_sf, true);
 	options.load("star_formation.angular_momentum_transfer", angular_momentum_transfer);
+	options.load("star_formation.tabulate_kernels", tabulate_kernels);
 
 	options.load("star_formation.accuracy_sf_eqs", Accuracy_SFeqs);
 	options.load("star_formation.boost_starburst", boost_starburst);
@@ -90,7 +93,119 @@ StarFormation::StarFormation(StarFormationParameters parameters, RecyclingParame
 	cosmology(std::move(cosmology)),
 	integrator(1000)
 {
-	// no-op
+	if (this->parameters.tabulate_kernels) {
+		kernel_table = make_kernel_table();
+	}
+}
+
+std::shared_ptr<const StarFormationKernelTable> StarFormation::make_kernel_table()
+{
+	using axis = StarFormationKernelTable::axis;
+
+	// All axes are in log10 space. The first one is always the central gas
+	// surface density [Msun/Mpc^2, physical]. BR06 depends on the stellar disk
+	// through the midplane pressure, while the rest depend on the gas metallicity
+	std::array<axis, StarFormationKernelTable::NDIMS> axes;
+	if (parameters.model == StarFormationParameters::BR06) {
+		axes = {{axis {8, 18, 51}, axis {8, 23, 31}, axis {-1.5, 1.5, 13}}};
+	}
+	else {
+		axes = {{axis {8, 18, 201}, axis {-4, 1, 101}, axis {0, 0, 1}}};
+	}
+
+	// Nodes are calculated more precisely than what the table will be checked against
+	Integrator kernel_integrator(1000);
+	auto evaluator = [&](const StarFormationKernelTable::point &x, StarFormationKernelTable::kernels &values) {
+		return exact_kernels(kernel_integrator, x, values);
+	};
+
+	Timer t;
+	auto table = std::make_shared<StarFormationKernelTable>(axes, evaluator, parameters.Accuracy_SFeqs);
+	LOG(info) << "Star formation kernel table built in " << t << ", "
+	          << table->accurate_cell_count() << " out of " << table->cell_count()
+	          << " cells are within the required accuracy of " << parameters.Accuracy_SFeqs;
+	return table;
+}
+
+/**
+ * For an exponential disk the SFR integral scales as sigma_gas0 * re^2 times a
+ * dimensionless kernel (sigma_gas0 * re^3 for the angular momentum integral),
+ * which only depends on a few combinations of the galaxy properties. These are
+ * the coordinates of the kernel table.
+ */
+bool StarFormation::kernel_coordinates(const galaxy_properties_for_integration &props, StarFormationKernelTable::point &x) const
+{
+	if (props.sigma_gas0 <= 0 || props.re <= 0) {
+		return false;
+	}
+	x[0] = std::log10(props.sigma_gas0);
+
+	if (parameters.model == StarFormationParameters::BR06) {
+		if (props.sigma_star0 <= 0 || props.rse <= 0) {
+			return false;
+		}
+		x[1] = std::log10(props.sigma_star0 / props.re);
+		x[2] = std::log10(props.re / props.rse);
+	}
+	else {
+		if (props.zgas <= 0) {
+			return false;
+		}
+		x[1] = std::log10(props.zgas);
+		x[2] = 0;
+	}
+	return true;
+}
+
+bool StarFormation::exact_kernels(Integrator &kernel_integrator, const StarFormationKernelTable::point &x, StarFormationKernelTable::kernels &values) const
+{
+	// A galaxy with unit scale radius with the given coordinates
+	galaxy_properties_for_integration props {std::pow(10., x[0]), 0, 1, 0, 1, false};
+	if (parameters.model == StarFormationParameters::BR06) {
+		props.sigma_star0 = std::pow(10., x[1]) * props.re;
+		props.rse = props.re / std::pow(10., x[2]);
+	}
+	else {
+		props.zgas = std::pow(10., x[1]);
+	}
+
+	struct StarFormationAndProps {
+		const StarFormation *star_formation;
+		galaxy_properties_for_integration *props;
+	};
+
+	auto f_and_f_j = [](double r, void *ctx, std::array<double, 2> &values) {
+		auto *sf_and_props = static_cast<StarFormationAndProps *>(ctx);
+		values[0] = sf_and_props->star_formation->star_formation_rate_surface_density(r, sf_and_props->props);
+		values[1] = r * values[0];
+	};
+
+	StarFormationAndProps sf_and_props = {this, &props};
+	double rmax = 5.0 * props.re;
+	try {
+		auto integrals = kernel_integrator.integrate<2>(f_and_f_j, &sf_and_props, 0, rmax, 0.0, parameters.Accuracy_SFeqs / 10);
+		values[0] = integrals[0] / props.sigma_gas0;
+		values[1] = integrals[1] / props.sigma_gas0;
+	} catch (const gsl_error &) {
+		return false;
+	} catch (const invalid_argument &) {
+		return false;
+	}
+	return true;
+}
+
+bool StarFormation::lookup_kernels(double Sigma_gas, double Sigma_star, double re, double rse, double zgas, bool burst, StarFormationKernelTable::kernels &kernels) const
+{
+	galaxy_properties_for_integration props = {
+		Sigma_gas,
+		Sigma_star,
+		re,
+		rse,
+		zgas/recycleparams.zsun,
+		burst,
+	};
+	StarFormationKernelTable::point kernel_point;
+	return kernel_coordinates(props, kernel_point) && kernel_table->lookup(kernel_point, kernels);
 }
 
 double StarFormation::star_formation_rate(double mcold, double mstar, double rgas, double rstar, double zgas, double z,
@@ -146,29 +261,74 @@ double StarFormation::star_formation_rate(double mcold, double mstar, double rga
 		auto *sf_and_props = static_cast<StarFormationAndProps *>(ctx);
 		return sf_and_props->star_formation->star_formation_rate_surface_density(r, sf_and_props->props);
 	};
+	auto f_j = [](double r, void *ctx) -> double {
+		auto *sf_and_props = static_cast<StarFormationAndProps *>(ctx);
+		return r * sf_and_props->star_formation->star_formation_rate_surface_density(r, sf_and_props->props);
+	};
+
+	// SFR and its angular momentum moment evaluated together, sharing the surface density
+	auto f_and_f_j = [](double r, void *ctx, std::array<double, 2> &values) {
+		auto *sf_and_props = static_cast<StarFormationAndProps *>(ctx);
+		values[0] = sf_and_props->star_formation->star_formation_rate_surface_density(r, sf_and_props->props);
+		values[1] = r * values[0];
+	};
 
 	double rmin = 0;
 	double rmax = 5.0*re;
 
 	StarFormationAndProps sf_and_props = {this, &props};
 
-	double result = 0;
-	try{
-		result = integrator.integrate(f, &sf_and_props, rmin, rmax, 0.0, parameters.Accuracy_SFeqs);
-	} catch (gsl_error &e) {
-		auto gsl_errno = e.get_gsl_errno();
-		std::ostringstream os;
-		os << "SFR integration failed with GSL error number " << gsl_errno << ": ";
-		os << gsl_strerror(gsl_errno) << ", reason=" << e.get_reason();
-		os << ". We'll attempt manual integration now";
-		LOG(warning) << os.str();
+	// Angular momentum transfer is not calculated in the case of starbursts
+	bool calc_jsfr = !burst && parameters.angular_momentum_transfer;
 
-		// Perform manual integration.
-		// TODO: check that error is affordable (i.e., maybe the error is really bad and the
-		// program should stop)
-		result = manual_integral(f, &sf_and_props, rmin, rmax);
+	// Use the tabulated kernels if possible, and integrate otherwise
+	StarFormationKernelTable::kernels kernels;
+	bool tabulated = kernel_table && lookup_kernels(Sigma_gas, Sigma_star, re, rse, zgas, burst, kernels);
+
+	double result = 0;
+	double jSFR = 0;
+	if (tabulated) {
+		result = kernels[0] * Sigma_gas * re * re;
+		jSFR = kernels[1] * Sigma_gas * re * re * re;
+		if (burst) {
+			result *= parameters.boost_starburst;
+		}
+	}
+	else {
+		// React to integration errors by using a way-simpler 4-point manual integration
+		try{
+			if (calc_jsfr) {
+				auto integrals = integrator.integrate<2>(f_and_f_j, &sf_and_props, rmin, rmax, 0.0, parameters.Accuracy_SFeqs);
+				result = integrals[0];
+				jSFR = integrals[1];
+			}
+			else {
+				result = integrator.integrate(f, &sf_and_props, rmin, rmax, 0.0, parameters.Accuracy_SFeqs);
+			}
+		} catch (gsl_error &e) {
+			auto gsl_errno = e.get_gsl_errno();
+			std::ostringstream os;
+			os << "SFR integration failed with GSL error number " << gsl_errno << ": ";
+			os << gsl_strerror(gsl_errno) << ", reason=" << e.get_reason();
+			os << ". We'll attempt manual integration now";
+			LOG(warning) << os.str();
+
+			// Perform manual integration.
+			// TODO: check that error is affordable (i.e., maybe the error is really bad and the
+			// program should stop)
+			result = manual_integral(f, &sf_and_props, rmin, rmax);
+			if (calc_jsfr) {
+				jSFR = manual_integral(f_j, &sf_and_props, rmin, rmax);
+			}
+		}
 	}
 
+	return comoving_rates(mcold, result, jSFR, burst, vgal, jgas, jrate);
+
+}
+
+double StarFormation::comoving_rates(double mcold, double result, double jSFR, bool burst, double vgal, double jgas, double &jrate) const
+{
 	// Avoid negative values.
 	if(result < 0){
 		result = 0.0;
@@ -181,33 +341,6 @@ double StarFormation::star_formation_rate(double mcold, double mstar, double rga
 		// Check whether user wishes to calculate angular momentum transfer from gas to stars.
 		if(parameters.angular_momentum_transfer){
 
-			// TODO: it would be nice to somehow reuse some of the values from the previous integration
-			// in here. At least initially during the first round the integration algorithm will run
-			// over the same set of 'r' that it used during the first round of the previous integration,
-			// so we could save ourselves lots of calculation by storing those values and reusing them here
-			auto f_j = [](double r, void *ctx) -> double {
-				auto *sf_and_props = static_cast<StarFormationAndProps *>(ctx);
-				return r * sf_and_props->star_formation->star_formation_rate_surface_density(r, sf_and_props->props);
-			};
-
-			// React to integration errors by using a way-simpler 4-point manual integration
-			double jSFR;
-			try{
-				jSFR = integrator.integrate(f_j, &sf_and_props, rmin, rmax, 0.0, parameters.Accuracy_SFeqs);
-			} catch (gsl_error &e) {
-				auto gsl_errno = e.get_gsl_errno();
-				std::ostringstream os;
-				os << "jSFR integration failed with GSL error number " << gsl_errno << ": ";
-				os << gsl_strerror(gsl_errno) << ", reason=" << e.get_reason();
-				os << ". We'll attempt manual integration now";
-				LOG(warning) << os.str();
-
-				// Perform manual integration.
-				// TODO: check that error is affordable (i.e., maybe the error is really bad and the
-				// program should stop)
-				jSFR = manual_integral(f_j, &sf_and_props, rmin, rmax);
-			}
-
 			jrate = cosmology->physical_to_comoving_mass(jSFR) * vgal; //assumes a flat rotation curve.
 
 
@@ -240,7 +373,6 @@ double StarFormation::star_formation_rate(double mcold, double mstar, double rga
 	}
 
 	return result;
-
 }
 
 double StarFormation::star_formation_rate_surface_density(double r, void * params) const {
@@ -479,16 +611,38 @@ double StarFormation::molecular_hydrogen(double mcold, double mstar, double rgas
 		auto *sf_and_props = static_cast<StarFormationAndProps *>(ctx);
 		return sf_and_props->star_formation->molecular_surface_density(r, sf_and_props->props);
 	};
+	auto f_j = [](double r, void *ctx) -> double {
+		auto *sf_and_props = static_cast<StarFormationAndProps *>(ctx);
+		return r * sf_and_props->star_formation->molecular_surface_density(r, sf_and_props->props);
+	};
+
+	// Molecular mass and its angular momentum moment evaluated together, sharing the surface density
+	auto f_and_f_j = [](double r, void *ctx, std::array<double, 2> &values) {
+		auto *sf_and_props = static_cast<StarFormationAndProps *>(ctx);
+		values[0] = sf_and_props->star_formation->molecular_surface_density(r, sf_and_props->props);
+		values[1] = r * values[0];
+	};
 
 	double rmin = 0;
 	double rmax = 5.0*re;
 
 	StarFormationAndProps sf_and_props = {this, &props};
 
+	// Angular momentum is not calculated for bulges, or if not requested
+	bool calc_jmol = !bulge && jcalc && parameters.angular_momentum_transfer;
+
 	// React to integration errors by using a way-simpler 4-point manual integration
 	double result = 0;
+	double jmol_integral = 0;
 	try{
-		result = integrator.integrate(f, &sf_and_props, rmin, rmax, 0.0, parameters.Accuracy_SFeqs);
+		if (calc_jmol) {
+			auto integrals = integrator.integrate<2>(f_and_f_j, &sf_and_props, rmin, rmax, 0.0, parameters.Accuracy_SFeqs);
+			result = integrals[0];
+			jmol_integral = integrals[1];
+		}
+		else {
+			result = integrator.integrate(f, &sf_and_props, rmin, rmax, 0.0, parameters.Accuracy_SFeqs);
+		}
 	} catch (gsl_error &e) {
 		auto gsl_errno = e.get_gsl_errno();
 		std::ostringstream os;
@@ -501,6 +655,9 @@ double StarFormation::molecular_hydrogen(double mcold, double mstar, double rgas
 		// TODO: check that error is affordable (i.e., maybe the error is really bad and the
 		// program should stop)
 		result = manual_integral(f, &sf_and_props, rmin, rmax);
+		if (calc_jmol) {
+			jmol_integral = manual_integral(f_j, &sf_and_props, rmin, rmax);
+		}
 	}
 
 	// Avoid negative values.
@@ -515,34 +672,7 @@ double StarFormation::molecular_hydrogen(double mcold, double mstar, double rgas
 		// Check whether user wishes to calculate angular momentum transfer from gas to stars.
 		if(parameters.angular_momentum_transfer){
 
-			// TODO: it would be nice to somehow reuse some of the values from the previous integration
-			// in here. At least initially during the first round the integration algorithm will run
-			// over the same set of 'r' that it used during the first round of the previous integration,
-			// so we could save ourselves lots of calculation by storing those values and reusing them here
-			auto f_j = [](double r, void *ctx) -> double {
-				auto *sf_and_props = static_cast<StarFormationAndProps *>(ctx);
-				return r * sf_and_props->star_formation->molecular_surface_density(r, sf_and_props->props);
-			};
-
-			// React to integration errors by using a way-simpler 4-point manual integration
-			jmol = 0;
-			try{
-				jmol = integrator.integrate(f_j, &sf_and_props, rmin, rmax, 0.0, parameters.Accuracy_SFeqs);
-			} catch (gsl_error &e) {
-				auto gsl_errno = e.get_gsl_errno();
-				std::ostringstream os;
-				os << "jSFR integration failed with GSL error number " << gsl_errno << ": ";
-				os << gsl_strerror(gsl_errno) << ", reason=" << e.get_reason();
-				os << ". We'll attempt manual integration now";
-				LOG(warning) << os.str();
-
-				// Perform manual integration.
-				// TODO: check that error is affordable (i.e., maybe the error is really bad and the
-				// program should stop)
-				jmol = manual_integral(f_j, &sf_and_props, rmin, rmax);
-			}
-
-			jmol = cosmology->physical_to_comoving_mass(jmol) * vgal; //assumes a flat rotation curve.
+			jmol = cosmology->physical_to_comoving_mass(jmol_integral) * vgal; //assumes a flat rotation curve.
 
 			// Avoid negative values.
 			if(jmol < 0){
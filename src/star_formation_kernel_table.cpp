@@ -0,0 +1,252 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * StarFormationKernelTable class implementation
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "exceptions.h"
+#include "star_formation_kernel_table.h"
+
+namespace shark {
+
+constexpr std::size_t StarFormationKernelTable::NDIMS;
+
+StarFormationKernelTable::StarFormationKernelTable(const std::array<axis, NDIMS> &axes, const kernel_evaluator &evaluator, double accuracy) :
+	axes(axes)
+{
+	std::size_t n_nodes = 1;
+	std::size_t total_cells = 1;
+	for (std::size_t d = 0; d != NDIMS; d++) {
+		const auto &ax = axes[d];
+		if (ax.n_nodes == 0 || (ax.n_nodes > 1 && ax.max <= ax.min)) {
+			throw invalid_argument("Invalid axis for star formation kernel table");
+		}
+		steps[d] = ax.n_nodes > 1 ? (ax.max - ax.min) / (ax.n_nodes - 1) : 0;
+		n_cells[d] = std::max(ax.n_nodes - 1, std::size_t(1));
+		n_nodes *= ax.n_nodes;
+		total_cells *= n_cells[d];
+	}
+
+	// Sample the logarithm of the kernels on all nodes; NaN marks a failed evaluation
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	log_values.resize(n_nodes);
+	index node {};
+	for (std::size_t offset = 0; offset != n_nodes; offset++) {
+		point x;
+		for (std::size_t d = 0; d != NDIMS; d++) {
+			x[d] = axes[d].min + node[d] * steps[d];
+		}
+		kernels values;
+		bool valid = evaluator(x, values) && values[0] > 0 && values[1] > 0;
+		log_values[node_offset(node)] = valid ? kernels {std::log(values[0]), std::log(values[1])} : kernels {nan, nan};
+
+		// Increment node index, last dimension first
+		for (std::size_t d = NDIMS; d-- > 0;) {
+			if (++node[d] < axes[d].n_nodes) {
+				break;
+			}
+			node[d] = 0;
+		}
+	}
+
+	// Check the interpolation error at the centre of each cell
+	accurate_cells.resize(total_cells, false);
+	point centre_fraction;
+	for (std::size_t d = 0; d != NDIMS; d++) {
+		centre_fraction[d] = axes[d].n_nodes > 1 ? 0.5 : 0;
+	}
+	index cell {};
+	for (std::size_t offset = 0; offset != total_cells; offset++) {
+		point x;
+		for (std::size_t d = 0; d != NDIMS; d++) {
+			x[d] = axes[d].min + (cell[d] + centre_fraction[d]) * steps[d];
+		}
+		kernels interpolated, exact;
+		if (interpolate(cell, centre_fraction, interpolated) && evaluator(x, exact)) {
+			accurate_cells[cell_offset(cell)] =
+			    std::abs(interpolated[0] - exact[0]) <= accuracy * std::abs(exact[0]) &&
+			    std::abs(interpolated[1] - exact[1]) <= accuracy * std::abs(exact[1]);
+		}
+
+		for (std::size_t d = NDIMS; d-- > 0;) {
+			if (++cell[d] < n_cells[d]) {
+				break;
+			}
+			cell[d] = 0;
+		}
+	}
+
+	// The errors along different axes can cancel out at the centre of a cell,
+	// so the midpoints of its edges are also checked. Each edge is shared by
+	// up to 4 cells, and is skipped if these have all been flagged already
+	for (std::size_t offset = 0; offset != n_nodes; offset++) {
+		for (std::size_t d = 0; d != NDIMS; d++) {
+			if (node[d] + 1 < axes[d].n_nodes) {
+				check_edge(node, d, evaluator, accuracy);
+			}
+		}
+
+		for (std::size_t d = NDIMS; d-- > 0;) {
+			if (++node[d] < axes[d].n_nodes) {
+				break;
+			}
+			node[d] = 0;
+		}
+	}
+}
+
+void StarFormationKernelTable::check_edge(const index &node, std::size_t dim, const kernel_evaluator &evaluator, double accuracy)
+{
+	// Cells containing the edge going from node along dim
+	std::vector<std::size_t> cells {0};
+	for (std::size_t d = 0; d != NDIMS; d++) {
+		std::size_t first = node[d], last = node[d];
+		if (d != dim && axes[d].n_nodes > 1) {
+			first = node[d] > 0 ? node[d] - 1 : 0;
+			last = std::min(node[d], n_cells[d] - 1);
+		}
+		std::vector<std::size_t> offsets;
+		for (auto offset: cells) {
+			for (std::size_t c = first; c <= last; c++) {
+				offsets.push_back(offset * n_cells[d] + c);
+			}
+		}
+		cells = std::move(offsets);
+	}
+	if (std::none_of(cells.begin(), cells.end(), [this](std::size_t offset) { return accurate_cells[offset]; })) {
+		return;
+	}
+
+	// Interpolating at the midpoint only involves the two ends of the edge,
+	// which are valid since the cells were not flagged
+	index upper_node = node;
+	upper_node[dim]++;
+	const auto &lower = log_values[node_offset(node)];
+	const auto &upper = log_values[node_offset(upper_node)];
+	point x;
+	for (std::size_t d = 0; d != NDIMS; d++) {
+		x[d] = axes[d].min + node[d] * steps[d];
+	}
+	x[dim] += 0.5 * steps[dim];
+
+	kernels exact;
+	bool accurate = evaluator(x, exact);
+	for (std::size_t i = 0; accurate && i != 2; i++) {
+		double interpolated = std::exp(0.5 * (lower[i] + upper[i]));
+		accurate = std::abs(interpolated - exact[i]) <= accuracy * std::abs(exact[i]);
+	}
+	if (!accurate) {
+		for (auto offset: cells) {
+			accurate_cells[offset] = false;
+		}
+	}
+}
+
+std::size_t StarFormationKernelTable::accurate_cell_count() const
+{
+	return std::count(accurate_cells.begin(), accurate_cells.end(), true);
+}
+
+std::size_t StarFormationKernelTable::node_offset(const index &node) const
+{
+	std::size_t offset = 0;
+	for (std::size_t d = 0; d != NDIMS; d++) {
+		offset = offset * axes[d].n_nodes + node[d];
+	}
+	return offset;
+}
+
+std::size_t StarFormationKernelTable::cell_offset(const index &cell) const
+{
+	std::size_t offset = 0;
+	for (std::size_t d = 0; d != NDIMS; d++) {
+		offset = offset * n_cells[d] + cell[d];
+	}
+	return offset;
+}
+
+bool StarFormationKernelTable::lookup(const point &x, kernels &values) const
+{
+	index cell;
+	point fraction;
+	for (std::size_t d = 0; d != NDIMS; d++) {
+		const auto &ax = axes[d];
+		if (ax.n_nodes == 1) {
+			cell[d] = 0;
+			fraction[d] = 0;
+			continue;
+		}
+		if (!(x[d] >= ax.min && x[d] <= ax.max)) {
+			return false;
+		}
+		double position = (x[d] - ax.min) / steps[d];
+		cell[d] = std::min(std::size_t(position), ax.n_nodes - 2);
+		fraction[d] = position - cell[d];
+	}
+
+	if (!accurate_cells[cell_offset(cell)]) {
+		return false;
+	}
+	return interpolate(cell, fraction, values);
+}
+
+bool StarFormationKernelTable::interpolate(const index &cell, const point &fraction, kernels &values) const
+{
+	kernels log_result {0, 0};
+
+	// Visit the 2^NDIMS corners of the cell, skipping those on single-node axes
+	for (std::size_t corner = 0; corner != (1 << NDIMS); corner++) {
+		index node;
+		double weight = 1;
+		bool skip = false;
+		for (std::size_t d = 0; d != NDIMS; d++) {
+			bool upper = (corner >> d) & 1;
+			if (upper && axes[d].n_nodes == 1) {
+				skip = true;
+				break;
+			}
+			node[d] = cell[d] + (upper ? 1 : 0);
+			weight *= upper ? fraction[d] : 1 - fraction[d];
+		}
+		if (skip) {
+			continue;
+		}
+
+		const auto &node_values = log_values[node_offset(node)];
+		if (std::isnan(node_values[0])) {
+			return false;
+		}
+		log_result[0] += weight * node_values[0];
+		log_result[1] += weight * node_values[1];
+	}
+
+	values[0] = std::exp(log_result[0]);
+	values[1] = std::exp(log_result[1]);
+	return true;
+}
+
+}  // namespace shark
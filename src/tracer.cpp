@@ -0,0 +1,121 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+/**
+ * @file
+ *
+ * Implementation of the Tracer class
+ */
+
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "exceptions.h"
+#include "logging.h"
+#include "tracer.h"
+
+namespace shark {
+
+constexpr std::int64_t Tracer::NO_ARG;
+
+Tracer::Tracer(unsigned int threads, std::size_t buffer_size) :
+	threads(threads),
+	buffer_size(buffer_size),
+	origin(Timer::clock::now()),
+	lanes(threads + 1)
+{
+	if (buffer_size == 0) {
+		throw invalid_argument("Tracer buffer size must be greater than 0");
+	}
+	for (auto &lane: lanes) {
+		lane.next = 0;
+		lane.wrapped = false;
+	}
+}
+
+void Tracer::write(const std::string &filename) const
+{
+	boost::filesystem::path dirname = boost::filesystem::path(filename).parent_path();
+	if (!dirname.empty() && !boost::filesystem::exists(dirname)) {
+		boost::filesystem::create_directories(dirname);
+	}
+
+	std::ofstream f(filename);
+	if (!f) {
+		std::ostringstream os;
+		os << "Error when opening trace file '" << filename << "': " << strerror(errno);
+		throw exception(os.str());
+	}
+
+	// Timestamps are given in microseconds, with nanosecond precision
+	auto to_us = [](Timer::clock::duration d) {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count() / 1000.;
+	};
+
+	f << std::fixed << std::setprecision(3);
+	f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	f << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"shark\"}}";
+
+	std::size_t n_events = 0, n_dropped = 0;
+	for (unsigned int tid = 0; tid != lanes.size(); tid++) {
+
+		f << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid << ",\"args\":{\"name\":\"";
+		if (tid == writer_lane()) {
+			f << "output writer";
+		}
+		else {
+			f << "thread " << tid;
+		}
+		f << "\"}}";
+
+		// Oldest events first, so viewers see them in order
+		auto &lane = lanes[tid];
+		auto first = lane.next;
+		auto count = lane.events.size();
+		for (std::size_t i = 0; i != count; i++) {
+			auto &e = lane.events[(first + i) % lane.events.size()];
+			f << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+			  << ",\"ts\":" << to_us(e.start - origin) << ",\"dur\":" << to_us(e.end - e.start);
+			if (e.arg != NO_ARG) {
+				f << ",\"args\":{\"arg\":" << e.arg << "}";
+			}
+			f << "}";
+		}
+		n_events += count;
+		if (lane.wrapped) {
+			n_dropped++;
+		}
+	}
+	f << "\n]}\n";
+
+	LOG(info) << "Trace with " << n_events << " events written to " << filename;
+	if (n_dropped > 0) {
+		LOG(warning) << "The trace buffers of " << n_dropped << " thread(s) filled up, their oldest events were dropped. "
+		             << "Increase execution.trace_buffer_size to keep them";
+	}
+}
+
+}  // namespace shark
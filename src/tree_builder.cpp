@@ -22,10 +22,13 @@
  */
 
 #include <algorithm>
+#include <exception>
+#include <functional>
 #include <iomanip>
 #include <iterator>
 #include <memory>
 #include <numeric>
+#include <tuple>
 #include <vector>
 
 #include "cosmology.h"
@@ -38,6 +41,113 @@
 
 namespace shark {
 
+namespace {
+
+/**
+ * Calls @p f on each of @p trees in parallel. Trees have very different sizes,
+ * so they are handed out one by one to whichever thread becomes free first.
+ * If @p f throws, the exception of the first failing tree is rethrown once all
+ * trees have been visited.
+ *
+ * @param trees The trees to visit
+ * @param threads The number of threads to use
+ * @param f A callable that takes a tree and the index of the thread visiting it
+ */
+template <typename Callable>
+void for_each_tree(const std::vector<MergerTreePtr> &trees, unsigned int threads, Callable &&f)
+{
+	std::vector<std::exception_ptr> errors(trees.size());
+	omp_dynamic_for(std::size_t(0), trees.size(), threads, 1, [&](std::size_t i, int thread_idx) {
+		try {
+			f(trees[i], thread_idx);
+		} catch (...) {
+			errors[i] = std::current_exception();
+		}
+	});
+	for (auto &error: errors) {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+}
+
+/**
+ * Collects the main branch ending at @p last into @p branch, from its earliest
+ * element up to @p last.
+ */
+template <typename T, typename MainProgenitor>
+void main_branch(const std::shared_ptr<T> &last, MainProgenitor main_progenitor, std::vector<std::shared_ptr<T>> &branch)
+{
+	branch.clear();
+	for (auto prog = last; prog; prog = main_progenitor(*prog)) {
+		branch.push_back(prog);
+	}
+	std::reverse(branch.begin(), branch.end());
+}
+
+/**
+ * Defines the assembly ages of the halos in a main branch, i.e., the redshifts
+ * at which their main progenitors had, for the first time going backwards in
+ * time, 80% and 50% of their mass.
+ *
+ * Those progenitors are always among the candidates kept while traversing the
+ * branch forward in time: the earlier halos that are less massive than every
+ * other halo after them. Candidates are therefore sorted by increasing mass,
+ * and the latest one under a given mass is found with a binary search.
+ */
+template <typename Redshift>
+void define_assembly_ages(const std::vector<HaloPtr> &branch, Redshift &&redshift, std::vector<std::size_t> &candidates)
+{
+	candidates.clear();
+	for (std::size_t i = 0; i != branch.size(); i++) {
+
+		auto &halo = branch[i];
+		auto define_age = [&](float &age, double fraction) {
+			if (age != 0) {
+				return;
+			}
+			auto threshold = fraction * halo->Mvir;
+			auto it = std::upper_bound(candidates.begin(), candidates.end(), threshold, [&branch](double threshold, std::size_t j) {
+				return threshold < branch[j]->Mvir;
+			});
+			if (it != candidates.begin()) {
+				age = redshift(halo->snapshot - int(i - *std::prev(it)));
+			}
+		};
+		define_age(halo->age_80, 0.8);
+		define_age(halo->age_50, 0.5);
+
+		while (!candidates.empty() && branch[candidates.back()]->Mvir >= halo->Mvir) {
+			candidates.pop_back();
+		}
+		candidates.push_back(i);
+	}
+}
+
+/**
+ * Defines the infall times of the satellite subhalos in a main branch, i.e.,
+ * the redshift at which their main progenitors were last centrals.
+ */
+template <typename Redshift>
+void define_infall_times(const std::vector<SubhaloPtr> &branch, Redshift &&redshift)
+{
+	bool had_central = false;
+	std::size_t last_central = 0;
+	for (std::size_t i = 0; i != branch.size(); i++) {
+		auto &subhalo = branch[i];
+		auto &host_halo = subhalo->host_halo;
+		if (had_central && subhalo->infall_t == 0 && subhalo != host_halo->central_subhalo) {
+			subhalo->infall_t = redshift(host_halo->snapshot - int(i - last_central));
+		}
+		if (subhalo->subhalo_type == Subhalo::CENTRAL) {
+			had_central = true;
+			last_central = i;
+		}
+	}
+}
+
+}  // namespace
+
 TreeBuilder::TreeBuilder(ExecutionParameters exec_params, unsigned int threads) :
 	exec_params(std::move(exec_params)), threads(threads)
 {
@@ -51,16 +161,19 @@ ExecutionParameters &TreeBuilder::get_exec_params()
 	return exec_params;
 }
 
+unsigned int TreeBuilder::get_threads() const
+{
+	return threads;
+}
+
 void TreeBuilder::ensure_trees_are_self_contained(const std::vector<MergerTreePtr> &trees) const
 {
-	omp_static_for(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
-		for (auto &snapshot_and_halos: tree->halos) {
-			for (auto &halo: snapshot_and_halos.second) {
-				if (halo->merger_tree != tree) {
-					std::ostringstream os;
-					os << halo << " is not actually part of " << tree;
-					throw invalid_data(os.str());
-				}
+	for_each_tree(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
+		for (auto &halo: tree->all_halos()) {
+			if (halo->merger_tree != tree) {
+				std::ostringstream os;
+				os << halo << " is not actually part of " << tree;
+				throw invalid_data(os.str());
 			}
 		}
 	});
@@ -110,29 +223,44 @@ std::vector<MergerTreePtr> TreeBuilder::build_trees(const std::vector<HaloPtr> &
 
 	loop_through_halos(halos);
 
+	// After linking, trees are independent of each other, so the passes below
+	// visit them in parallel. Halos were added to trees from the last snapshot
+	// backwards, so they need to be sorted by snapshot first
+	Timer index_t;
+	for_each_tree(trees, threads, [](const MergerTreePtr &tree, int thread_idx) {
+		tree->index_halos();
+	});
+	LOG(info) << "Indexed halos of merger trees by snapshot in " << index_t;
+
 	// Make sure merger trees are fully self-contained
+	Timer self_contained_t;
 	ensure_trees_are_self_contained(trees);
+	LOG(info) << "Checked that merger trees are self-contained in " << self_contained_t;
 
 	if(exec_params.ensure_mass_growth){
 		// Ensure halos only grow in mass.
-		LOG(info) << "Making sure halos only grow in mass";
+		Timer mass_growth_t;
 		ensure_halo_mass_growth(trees, sim_params);
+		LOG(info) << "Made sure halos only grow in mass in " << mass_growth_t;
 	}
 
 	// Redefine angular momentum in the case of interpolated halos.
 	// spin_interpolated_halos(trees, sim_params);
 
 	// Define central subhalos
-	LOG(info) << "Defining central subhalos";
+	Timer central_subhalos_t;
 	define_central_subhalos(trees, sim_params);
+	LOG(info) << "Defined central subhalos in " << central_subhalos_t;
 
 	// Define accretion rate from DM in case we want this.
-	LOG(info) << "Defining accretion rate using cosmology";
+	Timer accretion_rate_t;
 	define_accretion_rate_from_dm(trees, sim_params, gas_cooling_params, *cosmology, AllBaryons);
+	LOG(info) << "Defined accretion rate using cosmology in " << accretion_rate_t;
 
 	// Define halo and subhalos ages and other relevant properties
-	LOG(info) << "Defining ages of halos and subhalos";
+	Timer ages_t;
 	define_ages_halos(trees, sim_params);
+	LOG(info) << "Defined ages of halos and subhalos in " << ages_t;
 
 	return trees;
 }
@@ -185,6 +313,8 @@ void TreeBuilder::link(const SubhaloPtr &parent_shalo, const SubhaloPtr &desc_su
 SubhaloPtr TreeBuilder::define_central_subhalo(HaloPtr &halo, SubhaloPtr &subhalo)
 {
 	// point central subhalo to this subhalo.
+	// It is removed from the satellites below, so the set of subhalos
+	// in the halo (and therefore their mass ordering) doesn't change
 	halo->central_subhalo = subhalo;
 	halo->position = subhalo->position;
 	halo->velocity = subhalo->velocity;
@@ -213,7 +343,7 @@ void TreeBuilder::define_central_subhalos(const std::vector<MergerTreePtr> &tree
 	//This function loops over merger trees and halos to define central galaxies in a self-consistent way. The loop starts at z=0.
 
 	//Loop over trees.
-	omp_static_for(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
+	for_each_tree(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
 		for (int snapshot=sim_params.max_snapshot; snapshot >= sim_params.min_snapshot; snapshot--) {
 
 			for (auto &halo: tree->halos_at(snapshot)) {
@@ -284,7 +414,7 @@ void TreeBuilder::define_central_subhalos(const std::vector<MergerTreePtr> &tree
 	});
 
 	// Make sure each halo has only one central subhalo and that the rest are satellites.
-	omp_static_for(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
+	for_each_tree(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
 		for (int snapshot=sim_params.min_snapshot; snapshot >= sim_params.max_snapshot; snapshot++) {
 
 			for (auto &halo: tree->halos_at(snapshot)) {
@@ -312,7 +442,7 @@ void TreeBuilder::define_central_subhalos(const std::vector<MergerTreePtr> &tree
 void TreeBuilder::ensure_halo_mass_growth(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params){
 
 	//This function loops over merger trees and halos to make sure that descendant halos are at least as massive as their progenitors.
-	omp_static_for(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
+	for_each_tree(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
 		for(int snapshot=sim_params.min_snapshot; snapshot < sim_params.max_snapshot; snapshot++) {
 
 			for(auto &halo: tree->halos_at(snapshot)){
@@ -331,7 +461,7 @@ void TreeBuilder::spin_interpolated_halos(const std::vector<MergerTreePtr> &tree
 	// This has to be done starting from the first snapshot forward so that the angular momentum and concentration are propagated correctly if subhalo is interpolated over many snapshots.
 
 	//Loop over trees.
-	omp_static_for(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
+	for_each_tree(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
 		for (int snapshot=sim_params.max_snapshot; snapshot >=sim_params.min_snapshot; snapshot--) {
 
 			for (auto &halo: tree->halos_at(snapshot)) {
@@ -362,7 +492,7 @@ void TreeBuilder::define_accretion_rate_from_dm(const std::vector<MergerTreePtr>
 
 	//Loop over trees.
 	auto universal_baryon_fraction = cosmology.universal_baryon_fraction();
-	for(auto &tree: trees) {
+	for_each_tree(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
 		for(int snapshot=sim_params.max_snapshot; snapshot >= sim_params.min_snapshot; snapshot--) {
 				for(auto &halo: tree->halos_at(snapshot)){
 
@@ -381,9 +511,11 @@ void TreeBuilder::define_accretion_rate_from_dm(const std::vector<MergerTreePtr>
 					}
 				}
 		}
-	}
+	});
 
 	// Now accummulate baryons staring from the highest redshift.
+	// This is done serially and in tree order, so totals don't depend on the
+	// number of threads, nor on which thread processed which tree above
 	double total_baryon_accreted = 0;
 
 	for(int snapshot=sim_params.min_snapshot; snapshot <= sim_params.max_snapshot; snapshot++) {
@@ -400,47 +532,38 @@ void TreeBuilder::define_accretion_rate_from_dm(const std::vector<MergerTreePtr>
 
 void TreeBuilder::define_ages_halos(const std::vector<MergerTreePtr> &trees, SimulationParameters &sim_params){
 
+	const auto &redshifts = sim_params.redshifts;
+	auto redshift = [&redshifts](int snapshot) {
+		auto it = redshifts.find(snapshot);
+		return it == redshifts.end() ? 0. : it->second;
+	};
+
+	// Halos (and subhalos) are the main progenitor of at most one descendant,
+	// so main branches don't overlap. Each branch is collected once, starting
+	// from its last element, and then traversed forward in time.
+	for_each_tree(trees, threads, [&](const MergerTreePtr &tree, int thread_idx) {
+
+		std::vector<HaloPtr> halo_branch;
+		std::vector<SubhaloPtr> subhalo_branch;
+		std::vector<std::size_t> candidates;
 
-	//Loop over trees.
-	for(auto &tree: trees) {
 		for(int snapshot=sim_params.max_snapshot; snapshot >= sim_params.min_snapshot; snapshot--) {
 				for(auto &halo: tree->halos_at(snapshot)){
 
-					auto prog = halo->main_progenitor();
-
-					/*
-					 * Define assembly ages of halos by going backwards in time and checking when the main progenitors had
-					 * 50% and 80% of the mass of the current halo.
-					 */
-					auto snap = snapshot - 1;
-					while(prog && (halo->age_50 == 0 || halo->age_80 == 0)){
-						if(prog->Mvir <= 0.8* halo->Mvir && halo->age_80 == 0){
-							halo->age_80 = sim_params.redshifts[snap];
-						}
-						if(prog->Mvir <= 0.5* halo->Mvir && halo->age_50 == 0){
-							halo->age_50 = sim_params.redshifts[snap];
-						}
-						snap --;
-						prog = prog->main_progenitor();
+					if (!halo->descendant || halo->descendant->main_progenitor() != halo) {
+						main_branch(halo, std::mem_fn(&Halo::main_progenitor), halo_branch);
+						define_assembly_ages(halo_branch, redshift, candidates);
 					}
 
-					for (auto &subhalo: halo->satellite_subhalos) {
-
-						auto main_prog = subhalo->main();
-						auto snap = snapshot - 1;
-
-						while(main_prog && subhalo->infall_t == 0){
-							if(main_prog->subhalo_type == Subhalo::CENTRAL){
-								subhalo->infall_t = sim_params.redshifts[snap];
-							}
-							snap --;
-							main_prog = main_prog->main();
+					for (auto &subhalo: halo->all_subhalos()) {
+						if (!subhalo->descendant || subhalo->descendant->main() != subhalo) {
+							main_branch(subhalo, std::mem_fn(&Subhalo::main), subhalo_branch);
+							define_infall_times(subhalo_branch, redshift);
 						}
 					}
 				}
 		}
-
-	}
+	});
 
 }
 
@@ -464,27 +587,210 @@ HaloBasedTreeBuilder::HaloBasedTreeBuilder(ExecutionParameters exec_params, unsi
 	// no-op
 }
 
+namespace {
+
+/**
+ * Sorts @p values by chunks in parallel, and then merges the sorted chunks
+ * pairwise. Like std::stable_sort, elements that compare equal keep their
+ * relative order.
+ */
+template <typename T, typename Compare>
+void parallel_stable_sort(std::vector<T> &values, unsigned int threads, Compare comp)
+{
+	std::size_t n_chunks = std::max(1U, std::min<unsigned int>(threads, values.size() / 1000 + 1));
+	std::vector<std::size_t> bounds(n_chunks + 1);
+	for (std::size_t i = 0; i <= n_chunks; i++) {
+		bounds[i] = values.size() * i / n_chunks;
+	}
+
+	auto begin = values.begin();
+	omp_static_for(std::size_t(0), n_chunks, threads, [&](std::size_t i, int thread_idx) {
+		std::stable_sort(begin + bounds[i], begin + bounds[i + 1], comp);
+	});
+	for (std::size_t width = 1; width < n_chunks; width *= 2) {
+		auto n_merges = (n_chunks + 2 * width - 1) / (2 * width);
+		omp_static_for(std::size_t(0), n_merges, threads, [&](std::size_t merge, int thread_idx) {
+			auto first = merge * 2 * width;
+			auto middle = std::min(first + width, n_chunks);
+			auto last = std::min(first + 2 * width, n_chunks);
+			std::inplace_merge(begin + bounds[first], begin + bounds[middle], begin + bounds[last], comp);
+		});
+	}
+}
+
+/**
+ * A flat index of halos by ID, and of subhalos by their halo and ID, looked up
+ * with binary searches. Halos can be marked as ignored, and subhalos as
+ * removed, after which they are not found anymore.
+ */
+class HaloIndex {
+
+public:
+
+	HaloIndex(const std::vector<HaloPtr> &halos, unsigned int threads) :
+		halo_entries(halos.size())
+	{
+		std::vector<std::size_t> subhalo_offsets(halos.size() + 1, 0);
+		for (std::size_t i = 0; i != halos.size(); i++) {
+			subhalo_offsets[i + 1] = subhalo_offsets[i] + halos[i]->subhalo_count();
+		}
+		subhalo_entries.resize(subhalo_offsets.back());
+
+		omp_static_for(std::size_t(0), halos.size(), threads, [&](std::size_t i, int thread_idx) {
+			auto &halo = halos[i];
+			halo_entries[i] = {halo->id, halo};
+			auto offset = subhalo_offsets[i];
+			for (auto &subhalo: halo->all_subhalos()) {
+				subhalo_entries[offset++] = {halo.get(), subhalo->id, subhalo};
+			}
+		});
+
+		parallel_stable_sort(halo_entries, threads, [](const halo_entry &lhs, const halo_entry &rhs) {
+			return lhs.id < rhs.id;
+		});
+		parallel_stable_sort(subhalo_entries, threads, [](const subhalo_entry &lhs, const subhalo_entry &rhs) {
+			return subhalo_key(lhs) < subhalo_key(rhs);
+		});
+
+		ignored_halos.resize(halo_entries.size(), 0);
+		removed_subhalos.resize(subhalo_entries.size(), 0);
+	}
+
+	/**
+	 * Finds the halo with ID @p id. If more than one halo has the same ID,
+	 * the last one given at construction time is found.
+	 *
+	 * @return The halo, or @p nullptr if not found or ignored
+	 */
+	HaloPtr find_halo(Halo::id_t id) const
+	{
+		auto idx = halo_position(id);
+		if (idx < 0 || ignored_halos[idx]) {
+			return nullptr;
+		}
+		return halo_entries[idx].halo;
+	}
+
+	/// Marks the halo with ID @p id as ignored
+	void ignore_halo(Halo::id_t id)
+	{
+		auto idx = halo_position(id);
+		if (idx >= 0) {
+			ignored_halos[idx] = 1;
+		}
+	}
+
+	/**
+	 * Finds the first subhalo with ID @p id in @p halo, in the order given
+	 * by Halo::all_subhalos at construction time.
+	 *
+	 * @return The subhalo, or @p nullptr if not found or removed
+	 */
+	SubhaloPtr find_subhalo(const Halo *halo, Subhalo::id_t id) const
+	{
+		auto key = std::make_tuple(halo, id);
+		auto it = std::lower_bound(subhalo_entries.begin(), subhalo_entries.end(), key, [](const subhalo_entry &entry, const decltype(key) &key) {
+			return subhalo_key(entry) < key;
+		});
+		for (; it != subhalo_entries.end() && subhalo_key(*it) == key; it++) {
+			if (!removed_subhalos[it - subhalo_entries.begin()]) {
+				return it->subhalo;
+			}
+		}
+		return nullptr;
+	}
+
+	/**
+	 * Marks @p subhalo, contained in @p halo, as removed. Different threads
+	 * can remove subhalos of different halos concurrently.
+	 */
+	void remove_subhalo(const Halo *halo, const Subhalo *subhalo)
+	{
+		auto key = std::make_tuple(halo, subhalo->id);
+		auto it = std::lower_bound(subhalo_entries.begin(), subhalo_entries.end(), key, [](const subhalo_entry &entry, const decltype(key) &key) {
+			return subhalo_key(entry) < key;
+		});
+		for (; it != subhalo_entries.end() && subhalo_key(*it) == key; it++) {
+			if (it->subhalo.get() == subhalo) {
+				removed_subhalos[it - subhalo_entries.begin()] = 1;
+			}
+		}
+	}
+
+private:
+
+	struct halo_entry {
+		Halo::id_t id;
+		HaloPtr halo;
+	};
+
+	struct subhalo_entry {
+		const Halo *halo;
+		Subhalo::id_t id;
+		SubhaloPtr subhalo;
+	};
+
+	std::vector<halo_entry> halo_entries;
+	std::vector<subhalo_entry> subhalo_entries;
+	std::vector<char> ignored_halos;
+	std::vector<char> removed_subhalos;
+
+	static std::tuple<const Halo *, Subhalo::id_t> subhalo_key(const subhalo_entry &entry)
+	{
+		return std::make_tuple(entry.halo, entry.id);
+	}
+
+	std::ptrdiff_t halo_position(Halo::id_t id) const
+	{
+		auto it = std::upper_bound(halo_entries.begin(), halo_entries.end(), id, [](Halo::id_t id, const halo_entry &entry) {
+			return id < entry.id;
+		});
+		if (it == halo_entries.begin() || std::prev(it)->id != id) {
+			return -1;
+		}
+		return std::prev(it) - halo_entries.begin();
+	}
+};
+
+/// The links found for the subhalos of a halo, and the outcome of the search
+struct halo_links {
+	std::vector<std::tuple<SubhaloPtr, SubhaloPtr, HaloPtr>> links;
+	bool linked = false;
+	bool ignored = false;
+	std::exception_ptr error;
+};
+
+}  // namespace
+
 void HaloBasedTreeBuilder::loop_through_halos(const std::vector<HaloPtr> &halos)
 {
 
-	// Index all halos by snapshot and by ID, we'll need them later
+	// Index all halos by snapshot, and halos and subhalos by ID,
+	// we'll need them later
+	Timer index_t;
 	std::map<int, std::vector<HaloPtr>> halos_by_snapshot;
-	std::map<Halo::id_t, HaloPtr> halos_by_id;
 	for(const auto &halo: halos) {
 		halos_by_snapshot[halo->snapshot].push_back(halo);
-		halos_by_id[halo->id] = halo;
 	}
+	HaloIndex index(halos, get_threads());
+	LOG(info) << "Indexed " << halos.size() << " Halos and their Subhalos in " << index_t;
 
 	// To find subhalos/halos that correspond to each other, we do the following
 	//  1. Iterate over snapshots in descending order
 	//  2. For each snapshot S we iterate over its halos
 	//  3. For each halo H we iterate over its subhalos
 	//  4. For each subhalo SH we find the halo with subhalo.descendant_halo_id
-	//     (which we globally keep at the halos_by_id map)
+	//     (which we globally keep in the index)
 	//  5. When the descendant halo DH is found, we find the particular subhalo
 	//     DSH inside DH that matches SH's descendant_id
 	//  6. Now we have SH, H, DSH and DH. We link them all together,
 	//     and to their tree
+	//
+	// Steps 3 to 5 only modify H and the index entries of its subhalos, so
+	// halos within a snapshot are searched in parallel. Linking (step 6) also
+	// modifies descendants and trees shared by different halos, so it is done
+	// afterwards, sequentially and in the original halo order, which keeps
+	// the resulting trees independent of the number of threads.
 
 	// Get all snapshots in the Halos and sort them in decreasing order
 	// (but skip the first one, those were already processed and MergerTrees
@@ -504,41 +810,45 @@ void HaloBasedTreeBuilder::loop_through_halos(const std::vector<HaloPtr> &halos)
 
 		LOG(info) << "Linking Halos/Subhalos at snapshot " << snapshot;
 
-		int ignored = 0;
-		for(auto &halo: halos_by_snapshot[snapshot]) {
+		auto &snapshot_halos = halos_by_snapshot[snapshot];
+		std::vector<halo_links> all_links(snapshot_halos.size());
+		omp_dynamic_for(std::size_t(0), snapshot_halos.size(), get_threads(), 100, [&](std::size_t i, int thread_idx) {
 
-			bool halo_linked = false;
-			for(const auto &subhalo: halo->all_subhalos()) {
+			auto &halo = snapshot_halos[i];
+			auto &halo_links = all_links[i];
+			try {
 
-				// this subhalo has no descendants, let's not even try
-				if (!subhalo->has_descendant) {
-					if (LOG_ENABLED(debug)) {
-						LOG(debug) << subhalo << " has no descendant, not following";
+				// Subhalos might be removed from the halo while iterating
+				auto subhalos = halo->all_subhalos();
+				for(const auto &subhalo: subhalos) {
+
+					// this subhalo has no descendants, let's not even try
+					if (!subhalo->has_descendant) {
+						if (LOG_ENABLED(debug)) {
+							LOG(debug) << subhalo << " has no descendant, not following";
+						}
+						halo->remove_subhalo(subhalo);
+						index.remove_subhalo(halo.get(), subhalo.get());
+						continue;
 					}
-					halo->remove_subhalo(subhalo);
-					continue;
-				}
 
-				// if the descendant halo is not found, we don't consider this
-				// halo anymore (and all its progenitors)
-				auto it = halos_by_id.find(subhalo->descendant_halo_id);
-				if (it == halos_by_id.end()) {
-					if (LOG_ENABLED(debug)) {
-						LOG(debug) << subhalo << " points to descendant halo/subhalo "
-						           << subhalo->descendant_halo_id << " / " << subhalo->descendant_id
-						           << ", which doesn't exist. Ignoring this halo and the rest of its progenitors";
+					// if the descendant halo is not found, we don't consider this
+					// halo anymore (and all its progenitors)
+					auto d_halo = index.find_halo(subhalo->descendant_halo_id);
+					if (!d_halo) {
+						if (LOG_ENABLED(debug)) {
+							LOG(debug) << subhalo << " points to descendant halo/subhalo "
+							           << subhalo->descendant_halo_id << " / " << subhalo->descendant_id
+							           << ", which doesn't exist. Ignoring this halo and the rest of its progenitors";
+						}
+						halo_links.ignored = true;
+						break;
 					}
-					halos_by_id.erase(halo->id);
-					ignored++;
-					break;
-				}
 
-				// if the descendant subhalo is not found in the descendant halos'
-				// subhalos then we error
-				bool subhalo_descendant_found = false;
-				const auto &d_halo = halos_by_id[subhalo->descendant_halo_id];
-				for(auto &d_subhalo: d_halo->all_subhalos()) {
-					if (d_subhalo->id == subhalo->descendant_id) {
+					// if the descendant subhalo is not found in the descendant halos'
+					// subhalos then we error
+					auto d_subhalo = index.find_subhalo(d_halo.get(), subhalo->descendant_id);
+					if (d_subhalo) {
 
 						// We support only direct parentage; that is, descendants must be
 						// in the snapshot directly after ours
@@ -549,53 +859,69 @@ void HaloBasedTreeBuilder::loop_through_halos(const std::vector<HaloPtr> &halos)
 							throw invalid_data(os.str());
 						}
 
-						link(subhalo, d_subhalo, halo, d_halo);
-						subhalo_descendant_found = true;
-						halo_linked = true;
-						break;
+						halo_links.links.emplace_back(subhalo, d_subhalo, d_halo);
+						halo_links.linked = true;
 					}
-				}
-				if (!subhalo_descendant_found) {
+					else {
+
+						std::ostringstream os;
+						auto exec_params = get_exec_params();
+						if (exec_params.skip_missing_descendants || exec_params.warn_on_missing_descendants) {
+							os << "Descendant Subhalo id=" << subhalo->descendant_id;
+							os << " for " << subhalo << " (mass: " << subhalo->Mvir << ") not found";
+							os << " in the Subhalo's descendant Halo " << d_halo << std::endl;
+							os << "Subhalos in " << d_halo << ": " << std::endl << "  ";
+							auto &all_subhalos = d_halo->all_subhalos();
+							std::copy(all_subhalos.begin(), all_subhalos.end(),
+									  std::ostream_iterator<SubhaloPtr>(os, "\n  "));
+						}
 
-					std::ostringstream os;
-					auto exec_params = get_exec_params();
-					if (exec_params.skip_missing_descendants || exec_params.warn_on_missing_descendants) {
-						os << "Descendant Subhalo id=" << subhalo->descendant_id;
-						os << " for " << subhalo << " (mass: " << subhalo->Mvir << ") not found";
-						os << " in the Subhalo's descendant Halo " << d_halo << std::endl;
-						os << "Subhalos in " << d_halo << ": " << std::endl << "  ";
-						auto all_subhalos = d_halo->all_subhalos();
-						std::copy(all_subhalos.begin(), all_subhalos.end(),
-								  std::ostream_iterator<SubhaloPtr>(os, "\n  "));
-					}
+						// Users can choose whether to continue in these situations
+						// (with or without a warning) or if it should be considered an error
+						if (!exec_params.skip_missing_descendants) {
+							throw subhalo_not_found(os.str(), subhalo->descendant_id);
+						}
 
-					// Users can choose whether to continue in these situations
-					// (with or without a warning) or if it should be considered an error
-					if (!get_exec_params().skip_missing_descendants) {
-						throw subhalo_not_found(os.str(), subhalo->descendant_id);
+						if (exec_params.warn_on_missing_descendants) {
+							LOG(warning) << os.str();
+						}
+						halo->remove_subhalo(subhalo);
+						index.remove_subhalo(halo.get(), subhalo.get());
 					}
+				}
 
-					if (get_exec_params().warn_on_missing_descendants) {
-						LOG(warning) << os.str();
+				// If no subhalos were linked, this Halo will not have been linked,
+				// meaning that it also needs to be ignored
+				if (!halo_links.ignored && !halo_links.linked) {
+					if (LOG_ENABLED(debug)) {
+						LOG(debug) << halo << " doesn't contain any Subhalo pointing to"
+						           << " descendants, ignoring it (and the rest of its progenitors)";
 					}
-					halo->remove_subhalo(subhalo);
+					halo_links.ignored = true;
 				}
+			} catch (...) {
+				halo_links.error = std::current_exception();
 			}
+		});
 
-			// If no subhalos were linked, this Halo will not have been linked,
-			// meaning that it also needs to be ignored
-			if (!halo_linked) {
-				if (LOG_ENABLED(debug)) {
-					LOG(debug) << halo << " doesn't contain any Subhalo pointing to"
-					           << " descendants, ignoring it (and the rest of its progenitors)";
-				}
-				halos_by_id.erase(halo->id);
+		// Link halos in their original order, and stop at the first error
+		int ignored = 0;
+		for (std::size_t i = 0; i != snapshot_halos.size(); i++) {
+			auto &halo = snapshot_halos[i];
+			auto &halo_links = all_links[i];
+			for (auto &link_info: halo_links.links) {
+				link(std::get<0>(link_info), std::get<1>(link_info), halo, std::get<2>(link_info));
+			}
+			if (halo_links.error) {
+				std::rethrow_exception(halo_links.error);
+			}
+			if (halo_links.ignored) {
+				index.ignore_halo(halo->id);
 				ignored++;
 			}
-
 		}
 
-		auto n_snapshot_halos = halos_by_snapshot[snapshot].size();
+		auto n_snapshot_halos = snapshot_halos.size();
 		if (LOG_ENABLED(debug)) {
 			LOG(debug) << ignored << "/" << n_snapshot_halos << " ("
 			           << std::setprecision(2) << std::setiosflags(std::ios::fixed)
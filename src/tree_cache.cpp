@@ -0,0 +1,383 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Implementation of the TreeCache class
+ */
+
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+
+#include <sys/stat.h>
+
+#include "arena.h"
+#include "binary_buffer.h"
+#include "exceptions.h"
+#include "logging.h"
+#include "timer.h"
+#include "tree_cache.h"
+#include "utils.h"
+
+namespace shark {
+
+constexpr std::uint32_t TreeCache::VERSION;
+
+namespace {
+
+const char MAGIC[8] = {'S', 'H', 'A', 'R', 'K', 'T', 'R', 'E'};
+const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+const std::int64_t NONE = -1;
+
+template <typename T>
+std::int64_t index_of(const std::unordered_map<const T *, std::int64_t> &indices, const std::shared_ptr<T> &object)
+{
+	if (!object) {
+		return NONE;
+	}
+	auto it = indices.find(object.get());
+	if (it == indices.end()) {
+		std::ostringstream os;
+		os << *object << " is referenced from a merger tree, but is not part of any";
+		throw invalid_data(os.str());
+	}
+	return it->second;
+}
+
+template <typename T>
+const std::shared_ptr<T> &object_at(const std::vector<std::shared_ptr<T>> &objects, std::int64_t index)
+{
+	static const std::shared_ptr<T> null;
+	if (index == NONE) {
+		return null;
+	}
+	if (index < 0 || std::uint64_t(index) >= objects.size()) {
+		throw invalid_data("tree cache file references an object out of bounds");
+	}
+	return objects[index];
+}
+
+}  // anonymous namespace
+
+TreeCache::TreeCache(const std::string &directory, std::string key) :
+	key(std::move(key))
+{
+	std::ostringstream os;
+	os << directory << "/trees_" << std::hex << std::setw(16) << std::setfill('0') << fnv1a(this->key) << ".bin";
+	filename = os.str();
+}
+
+std::vector<MergerTreePtr> TreeCache::load(TotalBaryon &AllBaryons) const
+{
+	std::vector<char> contents;
+	if (!read_binary_file(filename, contents)) {
+		LOG(info) << "No cached merger trees found at " << filename;
+		return {};
+	}
+
+	Timer t;
+	buffer_reader reader(std::move(contents));
+
+	// Header; anything unexpected means the file cannot be used
+	char magic[sizeof(MAGIC)];
+	for (auto &c: magic) {
+		c = reader.read<char>();
+	}
+	if (std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+	    reader.read<std::uint32_t>() != VERSION ||
+	    reader.read<std::uint32_t>() != BYTE_ORDER_MARK ||
+	    reader.read_string() != key) {
+		LOG(warning) << "Cached merger trees at " << filename << " were built from different inputs, ignoring them";
+		return {};
+	}
+
+	auto trees = read_merger_trees(reader);
+
+	auto n_snapshots = reader.read<std::uint64_t>();
+	for (std::uint64_t i = 0; i != n_snapshots; i++) {
+		auto snapshot = reader.read<int>();
+		AllBaryons.baryon_total_created[snapshot] = reader.read<double>();
+	}
+
+	if (!reader.finished()) {
+		throw invalid_data("tree cache file " + filename + " has unexpected trailing data");
+	}
+
+	LOG(info) << "Loaded " << trees.size() << " cached merger trees from " << filename << " in " << t;
+	return trees;
+}
+
+void TreeCache::save(const std::vector<MergerTreePtr> &trees, const TotalBaryon &AllBaryons) const
+{
+	Timer t;
+
+	buffer_writer writer;
+	for (auto c: MAGIC) {
+		writer.write(c);
+	}
+	writer.write(VERSION);
+	writer.write(BYTE_ORDER_MARK);
+	writer.write(key);
+
+	write_merger_trees(writer, trees);
+
+	writer.write(std::uint64_t(AllBaryons.baryon_total_created.size()));
+	for (auto &snapshot_and_mass: AllBaryons.baryon_total_created) {
+		writer.write(snapshot_and_mass.first);
+		writer.write(snapshot_and_mass.second);
+	}
+
+	if (!write_binary_file(filename, writer.data())) {
+		LOG(warning) << "Merger trees could not be cached at " << filename;
+		return;
+	}
+
+	LOG(info) << "Cached " << trees.size() << " merger trees at " << filename
+	          << " (" << memory_amount(writer.data().size()) << ") in " << t;
+}
+
+std::vector<MergerTreePtr> read_merger_trees(buffer_reader &reader)
+{
+	auto n_trees = reader.read<std::uint64_t>();
+	auto n_halos = reader.read<std::uint64_t>();
+	auto n_subhalos = reader.read<std::uint64_t>();
+
+	std::vector<MergerTreePtr> trees;
+	std::vector<HaloPtr> halos;
+	std::vector<SubhaloPtr> subhalos;
+	trees.reserve(n_trees);
+	halos.reserve(n_halos);
+	subhalos.reserve(n_subhalos);
+
+	// Objects first, then the links between them. Halos and subhalos are
+	// allocated in tree order, so those of the same tree end up together
+	auto arena = std::make_shared<Arena>();
+	for (std::uint64_t i = 0; i != n_trees; i++) {
+		trees.emplace_back(std::make_shared<MergerTree>(reader.read<MergerTree::id_t>()));
+	}
+	for (std::uint64_t i = 0; i != n_halos; i++) {
+		auto id = reader.read<Halo::id_t>();
+		auto snapshot = reader.read<int>();
+		auto halo = make_arena_shared<Halo>(arena, id, snapshot);
+		reader.read(halo->position);
+		reader.read(halo->velocity);
+		halo->mass_fraction_subhalos = reader.read<float>();
+		halo->Vvir = reader.read<float>();
+		halo->Mvir = reader.read<float>();
+		halo->Mgas = reader.read<float>();
+		halo->concentration = reader.read<float>();
+		halo->lambda = reader.read<float>();
+		halo->age_80 = reader.read<float>();
+		halo->age_50 = reader.read<float>();
+		halos.emplace_back(std::move(halo));
+	}
+	for (std::uint64_t i = 0; i != n_subhalos; i++) {
+		auto id = reader.read<Subhalo::id_t>();
+		auto snapshot = reader.read<int>();
+		auto subhalo = make_arena_shared<Subhalo>(arena, id, snapshot);
+		reader.read(subhalo->position);
+		reader.read(subhalo->velocity);
+		subhalo->has_descendant = reader.read<std::uint8_t>();
+		subhalo->main_progenitor = reader.read<std::uint8_t>();
+		subhalo->IsInterpolated = reader.read<std::uint8_t>();
+		subhalo->descendant_id = reader.read<Subhalo::id_t>();
+		subhalo->descendant_halo_id = reader.read<Subhalo::id_t>();
+		subhalo->descendant_snapshot = reader.read<int>();
+		subhalo->last_snapshot_identified = reader.read<int>();
+		subhalo->subhalo_type = Subhalo::subhalo_type_t(reader.read<std::int32_t>());
+		subhalo->haloID = reader.read<Subhalo::id_t>();
+		subhalo->Vvir = reader.read<float>();
+		subhalo->Mvir = reader.read<float>();
+		subhalo->Mgas = reader.read<float>();
+		reader.read(subhalo->L);
+		subhalo->Vcirc = reader.read<float>();
+		subhalo->concentration = reader.read<float>();
+		subhalo->lambda = reader.read<float>();
+		subhalo->infall_t = reader.read<float>();
+		subhalo->accreted_mass = reader.read<float>();
+		subhalos.emplace_back(std::move(subhalo));
+	}
+
+	for (auto &halo: halos) {
+		auto &tree = object_at(trees, reader.read<std::int64_t>());
+		halo->merger_tree = tree;
+		tree->add_halo(halo);
+		halo->descendant = object_at(halos, reader.read<std::int64_t>());
+		halo->central_subhalo = object_at(subhalos, reader.read<std::int64_t>());
+		auto n_satellites = reader.read<std::uint64_t>();
+		for (std::uint64_t i = 0; i != n_satellites; i++) {
+			halo->satellite_subhalos.push_back(object_at(subhalos, reader.read<std::int64_t>()));
+		}
+		halo->update_subhalo_order();
+		auto n_ascendants = reader.read<std::uint64_t>();
+		for (std::uint64_t i = 0; i != n_ascendants; i++) {
+			halo->ascendants.insert(object_at(halos, reader.read<std::int64_t>()));
+		}
+	}
+	for (auto &subhalo: subhalos) {
+		subhalo->host_halo = object_at(halos, reader.read<std::int64_t>());
+		subhalo->descendant = object_at(subhalos, reader.read<std::int64_t>());
+		auto n_ascendants = reader.read<std::uint64_t>();
+		for (std::uint64_t i = 0; i != n_ascendants; i++) {
+			subhalo->ascendants.push_back(object_at(subhalos, reader.read<std::int64_t>()));
+		}
+	}
+	for (auto &tree: trees) {
+		tree->index_halos();
+	}
+
+	return trees;
+}
+
+void write_merger_trees(buffer_writer &writer, const std::vector<MergerTreePtr> &trees)
+{
+	// Assign an index to every object; halos are stored tree by tree and
+	// snapshot by snapshot, so reading them back preserves their order
+	std::unordered_map<const MergerTree *, std::int64_t> tree_indices;
+	std::unordered_map<const Halo *, std::int64_t> halo_indices;
+	std::unordered_map<const Subhalo *, std::int64_t> subhalo_indices;
+	std::vector<HaloPtr> halos;
+	std::vector<SubhaloPtr> subhalos;
+	for (auto &tree: trees) {
+		tree_indices.emplace(tree.get(), tree_indices.size());
+		for (auto &halo: tree->all_halos()) {
+			halo_indices.emplace(halo.get(), halos.size());
+			halos.push_back(halo);
+			for (auto &subhalo: halo->all_subhalos()) {
+				subhalo_indices.emplace(subhalo.get(), subhalos.size());
+				subhalos.push_back(subhalo);
+			}
+		}
+	}
+
+	writer.write(std::uint64_t(trees.size()));
+	writer.write(std::uint64_t(halos.size()));
+	writer.write(std::uint64_t(subhalos.size()));
+
+	for (auto &tree: trees) {
+		writer.write(tree->id);
+	}
+	for (auto &halo: halos) {
+		writer.write(halo->id);
+		writer.write(halo->snapshot);
+		writer.write(halo->position);
+		writer.write(halo->velocity);
+		writer.write(halo->mass_fraction_subhalos);
+		writer.write(halo->Vvir);
+		writer.write(halo->Mvir);
+		writer.write(halo->Mgas);
+		writer.write(halo->concentration);
+		writer.write(halo->lambda);
+		writer.write(halo->age_80);
+		writer.write(halo->age_50);
+	}
+	for (auto &subhalo: subhalos) {
+		writer.write(subhalo->id);
+		writer.write(subhalo->snapshot);
+		writer.write(subhalo->position);
+		writer.write(subhalo->velocity);
+		writer.write(std::uint8_t(subhalo->has_descendant));
+		writer.write(std::uint8_t(subhalo->main_progenitor));
+		writer.write(std::uint8_t(subhalo->IsInterpolated));
+		writer.write(subhalo->descendant_id);
+		writer.write(subhalo->descendant_halo_id);
+		writer.write(subhalo->descendant_snapshot);
+		writer.write(subhalo->last_snapshot_identified);
+		writer.write(std::int32_t(subhalo->subhalo_type));
+		writer.write(subhalo->haloID);
+		writer.write(subhalo->Vvir);
+		writer.write(subhalo->Mvir);
+		writer.write(subhalo->Mgas);
+		writer.write(subhalo->L);
+		writer.write(subhalo->Vcirc);
+		writer.write(subhalo->concentration);
+		writer.write(subhalo->lambda);
+		writer.write(subhalo->infall_t);
+		writer.write(subhalo->accreted_mass);
+	}
+
+	for (auto &halo: halos) {
+		writer.write(index_of(tree_indices, halo->merger_tree));
+		writer.write(index_of(halo_indices, halo->descendant));
+		writer.write(index_of(subhalo_indices, halo->central_subhalo));
+		writer.write(std::uint64_t(halo->satellite_subhalos.size()));
+		for (auto &subhalo: halo->satellite_subhalos) {
+			writer.write(index_of(subhalo_indices, subhalo));
+		}
+		writer.write(std::uint64_t(halo->ascendants.size()));
+		for (auto &ascendant: halo->ascendants) {
+			writer.write(index_of(halo_indices, ascendant));
+		}
+	}
+	for (auto &subhalo: subhalos) {
+		writer.write(index_of(halo_indices, subhalo->host_halo));
+		writer.write(index_of(subhalo_indices, subhalo->descendant));
+		writer.write(std::uint64_t(subhalo->ascendants.size()));
+		for (auto &ascendant: subhalo->ascendants) {
+			writer.write(index_of(subhalo_indices, ascendant));
+		}
+	}
+}
+
+std::string make_tree_cache_key(const Options &options,
+		const ExecutionParameters &exec_params,
+		const SimulationParameters &sim_params,
+		const DarkMatterHaloParameters &dark_matter_halo_params,
+		const std::vector<std::string> &tree_files)
+{
+	std::ostringstream os;
+	os << std::setprecision(std::numeric_limits<double>::max_digits10);
+
+	// Contents of the tree files are identified by their size and modification time
+	for (auto &tree_file: tree_files) {
+		struct stat file_stat;
+		os << "file " << tree_file;
+		if (stat(tree_file.c_str(), &file_stat) == 0) {
+			os << " " << file_stat.st_size << " " << file_stat.st_mtime;
+		}
+		os << "\n";
+	}
+
+	// Everything else that is used while reading and building the trees
+	for (auto &group: {"simulation", "cosmology", "dark_matter_halo"}) {
+		for (auto &name_and_value: options.get_group(group)) {
+			os << name_and_value.first << " = " << name_and_value.second << "\n";
+		}
+	}
+	for (auto &snapshot_and_redshift: sim_params.redshifts) {
+		os << "redshift " << snapshot_and_redshift.first << " " << snapshot_and_redshift.second << "\n";
+	}
+	os << "last_output_snapshot " << exec_params.last_output_snapshot() << "\n";
+	os << "skip_missing_descendants " << exec_params.skip_missing_descendants << "\n";
+	os << "ensure_mass_growth " << exec_params.ensure_mass_growth << "\n";
+
+	// The seed is only used while building the trees if spins are random
+	if (dark_matter_halo_params.random_lambda) {
+		os << "seed " << exec_params.seed << "\n";
+	}
+
+	return os.str();
+}
+
+}  // namespace shark
@@ -27,15 +27,17 @@
 #include <cctype>
 #include <cerrno>
 #include <cstring>
+#include <fstream>
 #include <functional>
 #include <locale>
 #include <string>
 #include <sstream>
 
-// gethostname
+// gethostname, sysconf, getrusage
 #ifdef _WIN32
 # include <winsock.h>
 #else
+# include <sys/resource.h>
 # include <unistd.h>
 #endif // _WIN32
 
@@ -116,5 +118,36 @@ std::string gethostname()
 	return std::string(the_hostname);
 }
 
+std::size_t current_rss()
+{
+#ifdef __linux__
+	// The second field of statm is the number of resident pages
+	std::ifstream statm("/proc/self/statm");
+	std::size_t size, resident;
+	if (statm >> size >> resident) {
+		return resident * std::size_t(sysconf(_SC_PAGESIZE));
+	}
+#endif // __linux__
+	return 0;
+}
+
+std::size_t peak_rss()
+{
+#ifdef _WIN32
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+# ifdef __APPLE__
+	// macOS reports bytes, everyone else kilobytes
+	return std::size_t(usage.ru_maxrss);
+# else
+	return std::size_t(usage.ru_maxrss) * 1024;
+# endif // __APPLE__
+#endif // _WIN32
+}
+
 
 }  // namespace shark
@@ -0,0 +1,132 @@
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+/**
+ * @file
+ *
+ * Micro-benchmark comparing the cached, mass-ordered subhalo list of halos
+ * against rebuilding and sorting it on every access, as Halo::all_subhalos
+ * used to do.
+ *
+ * Halos are visited as many times per snapshot as the evolution does
+ * (evolution, starbursts, disk instabilities, molecular gas, baryon tracking,
+ * transfer to the next snapshot and output).
+ *
+ * Usage: benchmark_subhalos [n_halos [n_satellites [n_snapshots]]]
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "components.h"
+#include "timer.h"
+#include "utils.h"
+
+using namespace shark;
+
+namespace {
+
+constexpr int VISITS_PER_SNAPSHOT = 10;
+
+std::vector<SubhaloPtr> rebuild_subhalos(const Halo &halo)
+{
+	std::vector<SubhaloPtr> all;
+	if (halo.central_subhalo) {
+		all.push_back(halo.central_subhalo);
+	}
+	all.insert(all.end(), halo.satellite_subhalos.begin(), halo.satellite_subhalos.end());
+	if (all.size() > 1) {
+		std::sort(all.begin(), all.end(), [](const SubhaloPtr &lhs, const SubhaloPtr &rhs) {
+			return lhs->Mvir > rhs->Mvir;
+		});
+	}
+	return all;
+}
+
+template <typename Visitor>
+Timer::duration time_snapshot(const std::vector<HaloPtr> &halos, Visitor &&visit)
+{
+	Timer t;
+	double total = 0;
+	for (int i = 0; i != VISITS_PER_SNAPSHOT; i++) {
+		for (auto &halo: halos) {
+			total += visit(*halo);
+		}
+	}
+	auto duration = t.get();
+
+	// Make sure the work above is not optimised away
+	if (total < 0) {
+		std::cout << total << std::endl;
+	}
+	return duration;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+	std::size_t n_halos = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+	std::size_t n_satellites = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5;
+	int n_snapshots = argc > 3 ? std::atoi(argv[3]) : 10;
+
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<float> mass(1e9, 1e12);
+	std::vector<HaloPtr> halos;
+	halos.reserve(n_halos);
+	for (std::size_t i = 0; i != n_halos; i++) {
+		auto halo = std::make_shared<Halo>(i, 0);
+		for (std::size_t j = 0; j != n_satellites + 1; j++) {
+			auto subhalo = std::make_shared<Subhalo>(i * (n_satellites + 1) + j, 0);
+			subhalo->subhalo_type = (j == 0 ? Subhalo::CENTRAL : Subhalo::SATELLITE);
+			subhalo->Mvir = mass(generator);
+			halo->add_subhalo(std::move(subhalo));
+		}
+		halos.emplace_back(std::move(halo));
+	}
+
+	Timer::duration rebuilt = 0, cached = 0;
+	for (int snapshot = 0; snapshot != n_snapshots; snapshot++) {
+		rebuilt += time_snapshot(halos, [](const Halo &halo) {
+			double mass = 0;
+			for (auto &subhalo: rebuild_subhalos(halo)) {
+				mass += subhalo->Mvir;
+			}
+			return mass;
+		});
+		cached += time_snapshot(halos, [](const Halo &halo) {
+			double mass = 0;
+			for (auto &subhalo: halo.all_subhalos()) {
+				mass += subhalo->Mvir;
+			}
+			return mass;
+		});
+	}
+
+	std::cout << n_halos << " halos with " << n_satellites << " satellites each, "
+	          << VISITS_PER_SNAPSHOT << " visits per snapshot" << std::endl;
+	std::cout << "Rebuilt subhalo lists: " << ns_time(rebuilt / n_snapshots) << " per snapshot" << std::endl;
+	std::cout << "Cached subhalo lists:  " << ns_time(cached / n_snapshots) << " per snapshot" << std::endl;
+	std::cout << "Saving:                " << ns_time((rebuilt - cached) / n_snapshots) << " per snapshot" << std::endl;
+	return 0;
+}
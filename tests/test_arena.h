@@ -0,0 +1,92 @@
+//
+// Arena allocator unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <cxxtest/TestSuite.h>
+
+#include "arena.h"
+#include "components.h"
+
+using namespace shark;
+
+class TestArena : public CxxTest::TestSuite
+{
+
+public:
+
+	void test_alignment()
+	{
+		Arena arena(64);
+		auto c = static_cast<char *>(arena.allocate(1, 1));
+		auto d = static_cast<char *>(arena.allocate(sizeof(double), alignof(double)));
+		TS_ASSERT_EQUALS(reinterpret_cast<std::uintptr_t>(d) % alignof(double), 0);
+		TS_ASSERT_LESS_THAN(c, d);
+		TS_ASSERT_EQUALS(arena.capacity(), 64);
+
+		// Allocations not fitting in the current chunk go to a new one,
+		// and big ones get a chunk of their own
+		arena.allocate(60, 1);
+		TS_ASSERT_EQUALS(arena.capacity(), 128);
+		arena.allocate(100, 1);
+		TS_ASSERT_EQUALS(arena.capacity(), 228);
+	}
+
+	void test_contiguous_objects()
+	{
+		auto arena = std::make_shared<Arena>();
+		auto subhalo1 = make_arena_shared<Subhalo>(arena, 1, 0);
+		auto subhalo2 = make_arena_shared<Subhalo>(arena, 2, 0);
+		TS_ASSERT_EQUALS(subhalo1->id, 1);
+		TS_ASSERT_EQUALS(subhalo2->id, 2);
+		auto distance = reinterpret_cast<char *>(subhalo2.get()) - reinterpret_cast<char *>(subhalo1.get());
+		TS_ASSERT_LESS_THAN(0, distance);
+		TS_ASSERT_LESS_THAN(distance, std::ptrdiff_t(2 * sizeof(Subhalo)));
+	}
+
+	void test_bulk_release()
+	{
+		auto arena = std::make_shared<Arena>();
+		std::weak_ptr<Arena> weak_arena = arena;
+		auto galaxy = make_arena_shared<Galaxy>(arena, 1);
+		galaxy->history.resize(10);
+		std::weak_ptr<Galaxy> weak_galaxy = galaxy;
+		arena.reset();
+
+		// Objects keep their arena alive until they are all gone
+		// (including the reference counts held by weak pointers)
+		TS_ASSERT(!weak_arena.expired());
+		galaxy.reset();
+		TS_ASSERT(weak_galaxy.expired());
+		TS_ASSERT(!weak_arena.expired());
+		weak_galaxy.reset();
+		TS_ASSERT(weak_arena.expired());
+	}
+
+	void test_without_arena()
+	{
+		auto galaxy = make_arena_shared<Galaxy>(ArenaPtr(), 3);
+		TS_ASSERT_EQUALS(galaxy->id, 3);
+	}
+
+};
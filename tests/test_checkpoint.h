@@ -0,0 +1,173 @@
+//
+// Checkpoint unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdio>
+
+#include <cxxtest/TestSuite.h>
+
+#include "checkpoint.h"
+#include "components.h"
+#include "exceptions.h"
+
+using namespace shark;
+
+class TestCheckpoint : public CxxTest::TestSuite
+{
+
+private:
+
+	HaloPtr add_halo(const MergerTreePtr &tree, Halo::id_t id, int snapshot)
+	{
+		auto halo = std::make_shared<Halo>(id, snapshot);
+		auto subhalo = std::make_shared<Subhalo>(id * 10, snapshot);
+		subhalo->host_halo = halo;
+		subhalo->Mvir = 1;
+		halo->add_subhalo(std::move(subhalo));
+		halo->merger_tree = tree;
+		tree->add_halo(halo);
+		return halo;
+	}
+
+	// A tree with a halo at snapshots 0 and 1, whose central subhalos
+	// are linked, and with some evolving state in the later one
+	MergerTreePtr make_tree(TotalBaryon &AllBaryons)
+	{
+		auto tree = std::make_shared<MergerTree>(3);
+		auto progenitor = add_halo(tree, 1, 0);
+		auto descendant = add_halo(tree, 2, 1);
+		progenitor->descendant = descendant;
+		descendant->ascendants.insert(progenitor);
+		progenitor->central_subhalo->descendant = descendant->central_subhalo;
+		descendant->central_subhalo->ascendants.push_back(progenitor->central_subhalo);
+
+		progenitor->central_subhalo->hot_halo_gas.mass = 10;
+		descendant->cooling_rate = 0.5;
+		auto &subhalo = descendant->central_subhalo;
+		subhalo->hot_halo_gas.mass = 2;
+		subhalo->ejected_galaxy_gas.mass_metals = 0.25;
+		subhalo->cooling_subhalo_tracking.integral = 3e6;
+		subhalo->cooling_subhalo_tracking.rheat = 0.1;
+
+		auto central = std::make_shared<Galaxy>(4);
+		central->disk_gas.mass = 3;
+		central->disk_gas.sAM = 0.7f;
+		central->smbh.macc_hh = 0.01f;
+		central->history.push_back({1, 2, 3, 4, 5, 6, 0});
+		central->molecular_gas.j_mol = 0.125;
+		auto satellite = std::make_shared<Galaxy>(5);
+		satellite->galaxy_type = Galaxy::TYPE2;
+		satellite->tmerge = 2.5;
+		satellite->interaction.minor_mergers = 1;
+		subhalo->galaxies = {central, satellite};
+
+		AllBaryons.baryon_total_created[0] = 0.3;
+		AllBaryons.mstars.resize(1);
+		AllBaryons.mstars[0].mass = 4;
+		AllBaryons.major_mergers = {2};
+		return tree;
+	}
+
+	void remove_files(const Checkpoint &checkpoint)
+	{
+		std::remove(checkpoint.get_trees_filename().c_str());
+		std::remove(checkpoint.get_state_filename().c_str());
+	}
+
+public:
+
+	void test_round_trip()
+	{
+		TotalBaryon baryons;
+		Checkpoint checkpoint(".", "round trip");
+		checkpoint.prepare_save(1, {make_tree(baryons)}, baryons)();
+
+		std::vector<MergerTreePtr> trees;
+		TotalBaryon loaded_baryons;
+		Checkpoint other_checkpoint(".", "round trip");
+		TS_ASSERT_EQUALS(other_checkpoint.load(trees, loaded_baryons), 1);
+		remove_files(checkpoint);
+
+		TS_ASSERT_EQUALS(trees.size(), 1);
+		TS_ASSERT_EQUALS(loaded_baryons.baryon_total_created, baryons.baryon_total_created);
+		TS_ASSERT_EQUALS(loaded_baryons.mstars.size(), 1);
+		TS_ASSERT_EQUALS(loaded_baryons.mstars[0].mass, 4);
+		TS_ASSERT_EQUALS(loaded_baryons.major_mergers, std::vector<int>{2});
+
+		// Halos before the checkpoint's snapshot are not evolved anymore
+		auto progenitor = trees[0]->halos_at(0)[0];
+		TS_ASSERT_EQUALS(progenitor->central_subhalo->hot_halo_gas.mass, 0);
+
+		auto descendant = trees[0]->halos_at(1)[0];
+		TS_ASSERT_EQUALS(descendant->cooling_rate, 0.5);
+		TS_ASSERT_EQUALS(progenitor->descendant, descendant);
+		auto &subhalo = descendant->central_subhalo;
+		TS_ASSERT_EQUALS(subhalo->hot_halo_gas.mass, 2);
+		TS_ASSERT_EQUALS(subhalo->ejected_galaxy_gas.mass_metals, 0.25);
+		TS_ASSERT_EQUALS(subhalo->cooling_subhalo_tracking.integral, 3e6);
+		TS_ASSERT_EQUALS(subhalo->cooling_subhalo_tracking.rheat, 0.1);
+
+		TS_ASSERT_EQUALS(subhalo->galaxies.size(), 2);
+		auto central = subhalo->galaxies[0];
+		TS_ASSERT_EQUALS(central->id, 4);
+		TS_ASSERT_EQUALS(central->galaxy_type, Galaxy::CENTRAL);
+		TS_ASSERT_EQUALS(central->disk_gas.mass, 3);
+		TS_ASSERT_EQUALS(central->disk_gas.sAM, 0.7f);
+		TS_ASSERT_EQUALS(central->smbh.macc_hh, 0.01f);
+		TS_ASSERT_EQUALS(central->history.size(), 1);
+		TS_ASSERT_EQUALS(central->history[0].sfr_z_bulge_diskins, 6);
+		TS_ASSERT_EQUALS(central->molecular_gas.j_mol, 0.125);
+		auto satellite = subhalo->galaxies[1];
+		TS_ASSERT_EQUALS(satellite->id, 5);
+		TS_ASSERT_EQUALS(satellite->galaxy_type, Galaxy::TYPE2);
+		TS_ASSERT_EQUALS(satellite->tmerge, 2.5);
+		TS_ASSERT_EQUALS(satellite->interaction.minor_mergers, 1);
+	}
+
+	void test_trees_written_once()
+	{
+		TotalBaryon baryons;
+		auto tree = make_tree(baryons);
+		Checkpoint checkpoint(".", "trees written once");
+		checkpoint.prepare_save(0, {tree}, baryons)();
+
+		// Later checkpoints only update the state file
+		std::remove(checkpoint.get_trees_filename().c_str());
+		checkpoint.prepare_save(1, {tree}, baryons)();
+		std::vector<MergerTreePtr> trees;
+		TS_ASSERT_THROWS(checkpoint.load(trees, baryons), invalid_data);
+		TS_ASSERT(trees.empty());
+		remove_files(checkpoint);
+	}
+
+	void test_different_key()
+	{
+		TotalBaryon baryons;
+		Checkpoint checkpoint(".", "some inputs");
+		checkpoint.prepare_save(1, {make_tree(baryons)}, baryons)();
+
+		std::vector<MergerTreePtr> trees;
+		Checkpoint other_checkpoint(".", "some other inputs");
+		TS_ASSERT_EQUALS(other_checkpoint.load(trees, baryons), -1);
+		TS_ASSERT(trees.empty());
+		remove_files(checkpoint);
+	}
+
+};
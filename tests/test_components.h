@@ -22,6 +22,7 @@
 #include <cxxtest/TestSuite.h>
 
 #include <functional>
+#include <memory>
 
 #include "components.h"
 #include "exceptions.h"
@@ -155,4 +156,130 @@ public:
 		_test_valid_satellite_galaxy_composition("122222C", false);
 	}
 
+	void test_subhalo_order()
+	{
+		auto halo = std::make_shared<Halo>(1, 0);
+		std::vector<SubhaloPtr> subhalos;
+		for (auto mass: {1.f, 5.f, 3.f, 5.f}) {
+			auto subhalo = make_subhalo("", subhalos.empty() ? Subhalo::CENTRAL : Subhalo::SATELLITE);
+			subhalo->Mvir = mass;
+			subhalos.push_back(subhalo);
+			halo->add_subhalo(std::move(subhalo));
+		}
+
+		// Ordered by decreasing mass; equal masses keep their insertion order
+		std::vector<SubhaloPtr> expected {subhalos[1], subhalos[3], subhalos[2], subhalos[0]};
+		TS_ASSERT(halo->all_subhalos() == expected);
+		TS_ASSERT_EQUALS(&halo->all_subhalos(), &halo->all_subhalos());
+
+		halo->remove_subhalo(subhalos[3]);
+		halo->remove_subhalo(subhalos[0]);
+		expected = {subhalos[1], subhalos[2]};
+		TS_ASSERT(halo->all_subhalos() == expected);
+
+		// Direct modifications require an explicit update
+		subhalos[2]->Mvir = 10;
+		halo->central_subhalo = subhalos[0];
+		halo->update_subhalo_order();
+		expected = {subhalos[2], subhalos[1], subhalos[0]};
+		TS_ASSERT(halo->all_subhalos() == expected);
+	}
+
+	void test_reset_baryons()
+	{
+		auto halo = std::make_shared<Halo>(1, 0);
+		auto subhalo = make_subhalo("C22", Subhalo::CENTRAL);
+		subhalo->Mvir = 10;
+		subhalo->hot_halo_gas.mass = 1;
+		subhalo->lost_galaxy_gas.mass_metals = 0.1;
+		subhalo->cooling_subhalo_tracking.integral = 2;
+		halo->add_subhalo(std::move(subhalo));
+		halo->cooling_rate = 3;
+
+		halo->reset_baryons();
+		TS_ASSERT_EQUALS(halo->galaxy_count(), 0);
+		TS_ASSERT_EQUALS(halo->total_baryon_mass(), 0);
+		TS_ASSERT_EQUALS(halo->cooling_rate, 0);
+		TS_ASSERT_EQUALS(halo->central_subhalo->lost_galaxy_gas.mass_metals, 0);
+		TS_ASSERT_EQUALS(halo->central_subhalo->cooling_subhalo_tracking.integral, 0);
+
+		// Dark matter properties are untouched
+		TS_ASSERT_EQUALS(halo->central_subhalo->Mvir, 10);
+		TS_ASSERT_EQUALS(halo->Mvir, 10);
+	}
+
+	void test_merger_tree_halos()
+	{
+		auto halos_of = [](const MergerTree::halo_range &range) {
+			return std::vector<HaloPtr>(range.begin(), range.end());
+		};
+
+		auto tree = std::make_shared<MergerTree>(1);
+		std::vector<HaloPtr> halos;
+		for (auto snapshot: {2, 2, 4}) {
+			halos.push_back(std::make_shared<Halo>(halos.size(), snapshot));
+			tree->add_halo(halos.back());
+		}
+
+		// Halos added in snapshot order are indexed right away
+		std::vector<HaloPtr> expected {halos[0], halos[1]};
+		TS_ASSERT(halos_of(tree->halos_at(2)) == expected);
+		TS_ASSERT(tree->halos_at(0).empty());
+		TS_ASSERT(tree->halos_at(3).empty());
+		TS_ASSERT(tree->halos_at(5).empty());
+		expected = {halos[2]};
+		TS_ASSERT(halos_of(tree->halos_at(4)) == expected);
+		TS_ASSERT(halos_of(tree->halos_at_last_snapshot()) == expected);
+		TS_ASSERT(halos_of(tree->halos_since(3)) == expected);
+
+		// Otherwise they need to be indexed again, keeping their order
+		// within each snapshot
+		for (auto snapshot: {1, 2}) {
+			halos.push_back(std::make_shared<Halo>(halos.size(), snapshot));
+			tree->add_halo(halos.back());
+		}
+		TS_ASSERT_THROWS(tree->halos_at(2), const invalid_data &);
+		TS_ASSERT_THROWS(tree->halos_since(0), const invalid_data &);
+		TS_ASSERT_THROWS(tree->all_halos(), const invalid_data &);
+		TS_ASSERT_THROWS(tree->halos_at_last_snapshot(), const invalid_data &);
+		tree->index_halos();
+		expected = {halos[3], halos[0], halos[1], halos[4], halos[2]};
+		TS_ASSERT(halos_of(tree->all_halos()) == expected);
+		TS_ASSERT(halos_of(tree->halos_since(0)) == expected);
+		expected = {halos[0], halos[1], halos[4]};
+		TS_ASSERT(halos_of(tree->halos_at(2)) == expected);
+		TS_ASSERT_EQUALS(tree->halos_at(1).size(), 1);
+		TS_ASSERT_EQUALS(tree->halos_at(1)[0], halos[3]);
+	}
+
+	void test_release_merger_tree()
+	{
+		auto tree = std::make_shared<MergerTree>(1);
+		auto progenitor = std::make_shared<Halo>(1, 0);
+		auto descendant = std::make_shared<Halo>(2, 1);
+		for (auto &halo: {progenitor, descendant}) {
+			auto subhalo = make_subhalo("C", Subhalo::CENTRAL);
+			subhalo->host_halo = halo;
+			halo->add_subhalo(std::move(subhalo));
+			halo->merger_tree = tree;
+			tree->add_halo(halo);
+		}
+		progenitor->descendant = descendant;
+		descendant->ascendants.insert(progenitor);
+		progenitor->central_subhalo->descendant = descendant->central_subhalo;
+		descendant->central_subhalo->ascendants.push_back(progenitor->central_subhalo);
+
+		std::weak_ptr<MergerTree> weak_tree = tree;
+		std::weak_ptr<Halo> weak_halo = progenitor;
+		std::weak_ptr<Subhalo> weak_subhalo = descendant->central_subhalo;
+		progenitor.reset();
+		descendant.reset();
+
+		tree->release();
+		tree.reset();
+		TS_ASSERT(weak_tree.expired());
+		TS_ASSERT(weak_halo.expired());
+		TS_ASSERT(weak_subhalo.expired());
+	}
+
 };
\ No newline at end of file
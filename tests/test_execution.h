@@ -19,8 +19,12 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 //
 
+#include <string>
+#include <vector>
+
 #include <cxxtest/TestSuite.h>
 
+#include "exceptions.h"
 #include "execution.h"
 
 using namespace shark;
@@ -30,16 +34,21 @@ class TestSubhalos : public CxxTest::TestSuite
 
 private:
 
-	void assert_output_snapshots(const std::string &snapshots, std::set<int> expected_snapshots, int expected_last_snapshot)
+	Options make_options(const std::string &snapshots, const std::string &batches)
 	{
 		Options opts {};
 		opts.add("execution.output_format = hdf5");
 		opts.add("execution.output_directory = .");
-		opts.add("execution.simulation_batches = 0");
+		opts.add(std::string("execution.simulation_batches = ") + batches);
 		opts.add("execution.ode_solver_precision = 0.5");
 		opts.add("execution.name_model = test");
 		opts.add(std::string("execution.output_snapshots = ") + snapshots);
-		ExecutionParameters params {opts};
+		return opts;
+	}
+
+	void assert_output_snapshots(const std::string &snapshots, std::set<int> expected_snapshots, int expected_last_snapshot)
+	{
+		ExecutionParameters params {make_options(snapshots, "0")};
 
 		TS_ASSERT_EQUALS(params.output_snapshots, expected_snapshots);
 		TS_ASSERT_EQUALS(params.last_output_snapshot(), expected_last_snapshot);
@@ -60,4 +69,55 @@ public:
 		assert_output_snapshots("199 0 199", {0, 199}, 199);
 		assert_output_snapshots("0 199", {0, 199}, 199);
 	}
+
+	void test_batch_groups()
+	{
+		using groups_t = std::vector<std::vector<unsigned int>>;
+		auto opts = make_options("199", "0-4");
+		ExecutionParameters params {opts};
+		TS_ASSERT_EQUALS(params.batch_groups(), groups_t({{0, 1, 2, 3, 4}}));
+		TS_ASSERT_EQUALS(params.batch_directory(), "multiple_batches");
+
+		opts.add("execution.stream_batches = 2");
+		params = ExecutionParameters {opts};
+		TS_ASSERT_EQUALS(params.batch_groups(), groups_t({{0, 1}, {2, 3}, {4}}));
+		TS_ASSERT_EQUALS(params.batch_directory(), "0_1_2_3_4");
+
+		opts.add("execution.stream_batches = 5");
+		params = ExecutionParameters {opts};
+		TS_ASSERT_EQUALS(params.batch_groups(), groups_t({{0, 1, 2, 3, 4}}));
+
+		// Each group is run with its own batches, as SharkRunner does when
+		// streaming, and is written into its own batch directory
+		opts.add("execution.stream_batches = 2");
+		std::vector<std::string> group_directories;
+		for (auto &group: ExecutionParameters {opts}.batch_groups()) {
+			Options group_opts(opts);
+			std::string batches;
+			for (auto batch: group) {
+				batches += " " + std::to_string(batch);
+			}
+			group_opts.add("execution.simulation_batches =" + batches);
+			group_directories.push_back(ExecutionParameters {group_opts}.batch_directory());
+		}
+		TS_ASSERT_EQUALS(group_directories, std::vector<std::string>({"0_1", "2_3", "4"}));
+
+		opts.add("execution.simulation_batches = 7");
+		params = ExecutionParameters {opts};
+		TS_ASSERT_EQUALS(params.batch_directory(), "7");
+	}
+
+	void test_checkpoint_requires_seed()
+	{
+		auto opts = make_options("199", "0");
+		opts.add("execution.checkpoint_directory = .");
+		TS_ASSERT_THROWS(ExecutionParameters {opts}, invalid_option);
+
+		opts.add("execution.seed = 123");
+		ExecutionParameters params {opts};
+		TS_ASSERT_EQUALS(params.checkpoint_directory, ".");
+
+		opts.add("execution.stream_batches = 1");
+		TS_ASSERT_THROWS(ExecutionParameters {opts}, invalid_option);
+	}
 };
\ No newline at end of file
@@ -0,0 +1,74 @@
+//
+// Galaxy profiler unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "exceptions.h"
+#include "galaxy_profiler.h"
+
+using namespace shark;
+
+class TestGalaxyProfiler : public CxxTest::TestSuite
+{
+
+public:
+
+	void test_log_histogram()
+	{
+		std::vector<double> values {0, 1, 2, 9.9, 10, 150, -1};
+		auto histogram = make_log_histogram(values, 1);
+		TS_ASSERT_EQUALS(histogram.non_positive, 2);
+		TS_ASSERT_EQUALS(histogram.counts, (std::vector<std::uint64_t> {3, 1, 1}));
+		TS_ASSERT_EQUALS(histogram.bin_edges.size(), 4);
+		TS_ASSERT_DELTA(histogram.bin_edges.front(), 1, 1e-12);
+		TS_ASSERT_DELTA(histogram.bin_edges.back(), 1000, 1e-9);
+
+		histogram = make_log_histogram(values, 2);
+		TS_ASSERT_EQUALS(histogram.counts, (std::vector<std::uint64_t> {2, 1, 1, 0, 1}));
+		TS_ASSERT_DELTA(histogram.bin_edges[1], 3.1622776601683795, 1e-12);
+	}
+
+	void test_log_histogram_without_positive_values()
+	{
+		auto histogram = make_log_histogram({0, 0}, 10);
+		TS_ASSERT_EQUALS(histogram.non_positive, 2);
+		TS_ASSERT(histogram.counts.empty());
+		TS_ASSERT(histogram.bin_edges.empty());
+		TS_ASSERT_THROWS(make_log_histogram({1}, 0), const invalid_argument &);
+	}
+
+	void test_top_share()
+	{
+		std::vector<double> values(100, 1);
+		values[42] = 99;
+		TS_ASSERT_DELTA(top_share(values, 0.01), 0.5, 1e-12);
+		TS_ASSERT_DELTA(top_share(values, 0.02), 100. / 198, 1e-12);
+		TS_ASSERT_DELTA(top_share(values, 1), 1, 1e-12);
+
+		// At least one value is always considered
+		TS_ASSERT_DELTA(top_share({1, 3}, 0.01), 0.75, 1e-12);
+		TS_ASSERT_EQUALS(top_share({}, 0.01), 0);
+		TS_ASSERT_EQUALS(top_share({0, 0}, 0.01), 0);
+	}
+
+};
@@ -24,6 +24,7 @@
 #include <cxxtest/TestSuite.h>
 
 #include <boost/filesystem.hpp>
+#include "hdf5/deferred_writer.h"
 #include "hdf5/reader.h"
 #include "hdf5/writer.h"
 
@@ -122,6 +123,30 @@ public:
 		TS_ASSERT_EQUALS(doubles, hdf5_doubles);
 	}
 
+	void test_deferred_writes()
+	{
+		// Reference data
+		std::vector<int> integers {1, 2, 3, 4};
+		double a_double = 1;
+
+		hdf5::DeferredWriter writer("test.hdf5");
+		writer.write_dataset("group/integers", integers);
+		writer.write_dataset("group/double", a_double);
+		writer.write_attribute("group/attribute", a_double);
+
+		// Nothing is written until requested, and values are frozen
+		// at the time they were given
+		TS_ASSERT(!fs::exists(fs::path("test.hdf5")));
+		integers.push_back(5);
+		a_double = 2;
+		writer.write();
+
+		auto reader = get_reader();
+		TS_ASSERT_EQUALS(reader.read_dataset_v<int>("group/integers"), (std::vector<int>{1, 2, 3, 4}));
+		TS_ASSERT_EQUALS(reader.read_dataset<double>("group/double"), 1.);
+		TS_ASSERT_EQUALS(reader.read_attribute<double>("group/attribute"), 1.);
+	}
+
 	void test_wrong_attribute_writes()
 	{
 		// Single-named attributes are not supported
@@ -0,0 +1,112 @@
+//
+// Integrator unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <array>
+#include <cmath>
+
+#include <cxxtest/TestSuite.h>
+
+#include "integrator.h"
+
+using namespace shark;
+
+class TestIntegrator : public CxxTest::TestSuite
+{
+
+private:
+
+	// x * exp(-x), whose integral over [0, b] is 1 - (1 + b) * exp(-b)
+	static double exp_disk(double x, void *)
+	{
+		return x * std::exp(-x);
+	}
+
+	// x^2 * exp(-x), whose integral over [0, b] is 2 - (2 + 2b + b^2) * exp(-b)
+	static double exp_disk_moment(double x, void *)
+	{
+		return x * exp_disk(x, nullptr);
+	}
+
+	static void exp_disk_and_moment(double x, void *, std::array<double, 2> &values)
+	{
+		values[0] = exp_disk(x, nullptr);
+		values[1] = exp_disk_moment(x, nullptr);
+	}
+
+	// A narrow Lorentzian centred at 0.3 and its first moment, which need many
+	// more intervals around the peak than anywhere else
+	static void lorentzian_and_moment(double x, void *, std::array<double, 2> &values)
+	{
+		const double width = 1e-4;
+		values[0] = width / ((x - 0.3) * (x - 0.3) + width * width);
+		values[1] = x * values[0];
+	}
+
+public:
+
+	void test_vector_integration()
+	{
+		const double b = 5;
+		const double expected_disk = 1 - (1 + b) * std::exp(-b);
+		const double expected_moment = 2 - (2 + 2 * b + b * b) * std::exp(-b);
+
+		for (double epsrel: {1e-2, 1e-5, 1e-8}) {
+			Integrator integrator(1000);
+			auto integrals = integrator.integrate<2>(exp_disk_and_moment, nullptr, 0, b, 0, epsrel);
+			TS_ASSERT_DELTA(expected_disk, integrals[0], expected_disk * epsrel);
+			TS_ASSERT_DELTA(expected_moment, integrals[1], expected_moment * epsrel);
+			TS_ASSERT_LESS_THAN(std::size_t(0), integrator.get_num_intervals());
+
+			// The scalar integrations agree within tolerances
+			double disk = integrator.integrate(exp_disk, nullptr, 0, b, 0, epsrel);
+			double moment = integrator.integrate(exp_disk_moment, nullptr, 0, b, 0, epsrel);
+			TS_ASSERT_DELTA(disk, integrals[0], expected_disk * epsrel);
+			TS_ASSERT_DELTA(moment, integrals[1], expected_moment * epsrel);
+		}
+	}
+
+	void test_peaked_integrand()
+	{
+		const double width = 1e-4;
+		const double b = 5;
+		const double expected = std::atan((b - 0.3) / width) + std::atan(0.3 / width);
+		const double expected_moment = 0.3 * expected + width / 2 * std::log(((b - 0.3) * (b - 0.3) + width * width) / (0.3 * 0.3 + width * width));
+
+		for (double epsrel: {1e-3, 1e-6, 1e-9}) {
+			Integrator integrator(1000);
+			auto integrals = integrator.integrate<2>(lorentzian_and_moment, nullptr, 0, b, 0, epsrel);
+			TS_ASSERT_DELTA(expected, integrals[0], expected * epsrel);
+			TS_ASSERT_DELTA(expected_moment, integrals[1], expected_moment * epsrel);
+			TS_ASSERT_LESS_THAN(std::size_t(10), integrator.get_num_intervals());
+		}
+	}
+
+	void test_zero_integrand()
+	{
+		Integrator integrator(1000);
+		auto integrals = integrator.integrate<2>([](double, void *, std::array<double, 2> &values) {
+			values = {0, 0};
+		}, nullptr, 0, 1, 0, 1e-3);
+		TS_ASSERT_EQUALS(0, integrals[0]);
+		TS_ASSERT_EQUALS(0, integrals[1]);
+		TS_ASSERT_EQUALS(std::size_t(1), integrator.get_num_intervals());
+	}
+};
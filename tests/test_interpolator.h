@@ -0,0 +1,106 @@
+//
+// Interpolator unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <random>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "exceptions.h"
+#include "gas_cooling.h"
+#include "interpolator.h"
+#include "options.h"
+
+using namespace shark;
+
+class TestGridInterpolator : public CxxTest::TestSuite
+{
+
+private:
+
+	void assert_same_as_interpolator(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &z)
+	{
+		Interpolator reference(x, y, z);
+		GridInterpolator interpolator(x, y, z);
+
+		// Grid points, including the corners
+		for (auto xi: x) {
+			for (auto yj: y) {
+				TS_ASSERT_DELTA(interpolator.get(xi, yj), reference.get(xi, yj), 1e-12);
+			}
+		}
+
+		// Random points, some of them outside the grid
+		std::mt19937 generator(1);
+		double x_range = x.back() - x.front();
+		double y_range = y.back() - y.front();
+		std::uniform_real_distribution<double> x_dist(x.front() - 0.1 * x_range, x.back() + 0.1 * x_range);
+		std::uniform_real_distribution<double> y_dist(y.front() - 0.1 * y_range, y.back() + 0.1 * y_range);
+		for (int i = 0; i != 100000; i++) {
+			auto xi = x_dist(generator);
+			auto yi = y_dist(generator);
+			TS_ASSERT_DELTA(interpolator.get(xi, yi), reference.get(xi, yi), 1e-12);
+		}
+	}
+
+	void assert_same_as_interpolator(GasCoolingParameters::LambdaCoolingModel lambdamodel)
+	{
+		Options opts {};
+		opts.add("gas_cooling.model = croton06");
+		opts.add(std::string("gas_cooling.lambdamodel = ") + (lambdamodel == GasCoolingParameters::CLOUDY ? "cloudy" : "sutherland"));
+		GasCoolingParameters params {opts};
+		auto &table = params.cooling_table;
+		assert_same_as_interpolator(table.get_temperatures(), table.get_metallicities(), table.get_lambda());
+	}
+
+public:
+
+	void test_irregular_grid()
+	{
+		std::vector<double> x {0, 0.001, 0.01, 0.0316, 0.1, 0.316, 1, 3.16};
+		std::vector<double> y {-1, 0, 0.5, 2};
+		std::vector<double> z;
+		for (auto yj: y) {
+			for (auto xi: x) {
+				z.push_back(xi * xi - 3 * yj + xi * yj);
+			}
+		}
+		assert_same_as_interpolator(x, y, z);
+	}
+
+	void test_cloudy_cooling_tables()
+	{
+		assert_same_as_interpolator(GasCoolingParameters::CLOUDY);
+	}
+
+	void test_sutherland_cooling_tables()
+	{
+		assert_same_as_interpolator(GasCoolingParameters::SUTHERLAND);
+	}
+
+	void test_invalid_grid()
+	{
+		TS_ASSERT_THROWS(GridInterpolator({0}, {0, 1}, {0, 0}), const invalid_argument &);
+		TS_ASSERT_THROWS(GridInterpolator({0, 1, 1}, {0, 1}, {0, 0, 0, 0, 0, 0}), const invalid_argument &);
+		TS_ASSERT_THROWS(GridInterpolator({0, 1}, {0, 1}, {0, 0, 0}), const invalid_argument &);
+	}
+
+};
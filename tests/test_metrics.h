@@ -0,0 +1,93 @@
+//
+// Execution metrics unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "metrics.h"
+#include "utils.h"
+
+using namespace shark;
+
+class TestMetrics : public CxxTest::TestSuite
+{
+
+public:
+
+	void test_record()
+	{
+		metrics_record nested;
+		nested.add("count", 3).add("ratio", 0.5);
+
+		metrics_record record;
+		record.add("type", "snapshot")
+		      .add("flag", true)
+		      .add("values", std::vector<long> {1, -2, 3})
+		      .add("nan", std::nan(""))
+		      .add("nested", nested);
+		TS_ASSERT_EQUALS(record.str(), R"({"type":"snapshot","flag":true,"values":[1,-2,3],"nan":null,"nested":{"count":3,"ratio":0.5}})");
+		TS_ASSERT_EQUALS(metrics_record().str(), "{}");
+	}
+
+	void test_record_strings_and_precision()
+	{
+		metrics_record record;
+		record.add("s", std::string("a \"quoted\"\\path\n\x01"))
+		      .add("third", 1. / 3);
+		TS_ASSERT_EQUALS(record.str(), R"({"s":"a \"quoted\"\\path\n\u0001","third":0.33333333333333331})");
+	}
+
+	void test_writer_appends()
+	{
+		std::string filename = "test_metrics.jsonl";
+		std::remove(filename.c_str());
+		for (int i = 0; i != 2; i++) {
+			MetricsWriter writer(filename);
+			metrics_record record;
+			record.add("run", i);
+			writer.write(record);
+		}
+
+		std::ifstream f(filename);
+		std::string line;
+		std::vector<std::string> lines;
+		while (std::getline(f, line)) {
+			lines.push_back(line);
+		}
+		TS_ASSERT_EQUALS(lines, (std::vector<std::string> {R"({"run":0})", R"({"run":1})"}));
+		std::remove(filename.c_str());
+	}
+
+	void test_rss()
+	{
+#ifdef __linux__
+		TS_ASSERT_LESS_THAN(0, current_rss());
+		TS_ASSERT_LESS_THAN_EQUALS(current_rss(), peak_rss());
+#endif // __linux__
+	}
+
+};
@@ -0,0 +1,222 @@
+//
+// ODE solver unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <array>
+#include <cmath>
+
+#include <cxxtest/TestSuite.h>
+
+#include "cash_karp_ode_solver.h"
+#include "exceptions.h"
+#include "ode_solver.h"
+
+using namespace shark;
+
+// y0' = -y0, y1' = y0 - y1; i.e., y0 = exp(-t), y1 = t * exp(-t) for y(0) = (1, 0)
+static int decay_chain(double t, const double y[], double f[], void *)
+{
+	f[0] = -y[0];
+	f[1] = y[0] - y[1];
+	return 0;
+}
+
+struct decay_chain_functor {
+	int operator()(double t, const std::array<double, 2> &y, std::array<double, 2> &f) const
+	{
+		return decay_chain(t, y.data(), f.data(), nullptr);
+	}
+};
+
+// Like decay_chain, but with a different decay rate on each lane
+struct decay_chain_batch_functor {
+	using lanes = std::array<double, 4>;
+	lanes rates;
+	int operator()(const std::array<bool, 4> &, std::size_t n_lanes, const lanes &, const std::array<lanes, 2> &y, std::array<lanes, 2> &f) const
+	{
+		for (std::size_t l = 0; l != n_lanes; l++) {
+			f[0][l] = -rates[l] * y[0][l];
+			f[1][l] = rates[l] * y[0][l] - y[1][l];
+		}
+		return 0;
+	}
+};
+
+// y' jumps from 0 to a huge value at t = 0.5. The error estimate of steps
+// across the jump stays too big regardless of their size, so solvers
+// eventually give up just before the jump
+static int jump(double t, const double y[], double f[], void *)
+{
+	f[0] = t < 0.5 ? 0 : 1e200;
+	return 0;
+}
+
+struct jump_functor {
+	int operator()(double t, const std::array<double, 1> &y, std::array<double, 1> &f) const
+	{
+		return jump(t, y.data(), f.data(), nullptr);
+	}
+};
+
+// jump on the first lane, and exponential decay on the second one
+struct jump_batch_functor {
+	using lanes = std::array<double, 2>;
+	int operator()(const std::array<bool, 2> &active, std::size_t, const lanes &t, const std::array<lanes, 1> &y, std::array<lanes, 1> &f) const
+	{
+		if (active[0]) {
+			jump(t[0], &y[0][0], &f[0][0], nullptr);
+		}
+		if (active[1]) {
+			f[0][1] = -y[0][1];
+		}
+		return 0;
+	}
+};
+
+struct failing_functor {
+	int operator()(double, const std::array<double, 1> &, std::array<double, 1> &) const
+	{
+		return 1;
+	}
+};
+
+class TestODESolver : public CxxTest::TestSuite
+{
+
+private:
+
+	template <std::size_t N, typename Functor>
+	void assert_same_as_gsl(ODESolver::ode_evaluator system, Functor functor, const std::array<double, N> &y0, double precision, double delta_t)
+	{
+		auto y_gsl = y0;
+		ODESolver gsl_solver(system, N, precision, nullptr);
+		gsl_solver.evolve(y_gsl, delta_t);
+
+		auto y = y0;
+		auto solver = make_cash_karp_ode_solver<N>(functor, precision);
+		solver.evolve(y, delta_t);
+
+		TS_ASSERT_EQUALS(gsl_solver.num_evaluations(), solver.num_evaluations());
+		TS_ASSERT_EQUALS(gsl_solver.num_rejected_steps(), solver.num_rejected_steps());
+		for (std::size_t i = 0; i != N; i++) {
+			TS_ASSERT_DELTA(y[i], y_gsl[i], std::abs(y_gsl[i]) * 1e-10);
+		}
+	}
+
+	void assert_same_as_gsl(double precision, double delta_t)
+	{
+		assert_same_as_gsl<2>(decay_chain, decay_chain_functor(), {1, 0}, precision, delta_t);
+	}
+
+public:
+
+	void test_analytic_solution()
+	{
+		for (double delta_t: {0.01, 0.5, 3.}) {
+			std::array<double, 2> y {1, 0};
+			auto solver = make_cash_karp_ode_solver<2>(decay_chain_functor(), 1e-6);
+			solver.evolve(y, delta_t);
+			TS_ASSERT_DELTA(y[0], std::exp(-delta_t), std::exp(-delta_t) * 1e-5);
+			TS_ASSERT_DELTA(y[1], delta_t * std::exp(-delta_t), delta_t * std::exp(-delta_t) * 1e-5);
+			TS_ASSERT_LESS_THAN(std::size_t(0), solver.num_evaluations());
+		}
+	}
+
+	void test_same_as_gsl()
+	{
+		assert_same_as_gsl(0.05, 0.5);
+		assert_same_as_gsl(0.05, 3);
+		assert_same_as_gsl(1e-6, 0.5);
+		assert_same_as_gsl(1e-6, 3);
+
+		// Both give up at the same point when steps cannot get any smaller
+		assert_same_as_gsl<1>(jump, jump_functor(), {1}, 1e-6, 1);
+	}
+
+	void test_batch_same_as_scalar()
+	{
+		decay_chain_batch_functor batch_functor {{1, 10, 0.1, 100}};
+		std::array<std::array<double, 4>, 2> y {{{1, 2, 3, 4}, {0, 0, 1, 1}}};
+
+		// Only the first three lanes are in use
+		auto batch_solver = make_batched_cash_karp_ode_solver<2, 4>(batch_functor, 1e-6);
+		batch_solver.evolve(y, 3, 2);
+		TS_ASSERT_EQUALS(4, y[0][3]);
+		TS_ASSERT_EQUALS(1, y[1][3]);
+
+		for (std::size_t lane = 0; lane != 3; lane++) {
+			double rate = batch_functor.rates[lane];
+			auto functor = [rate](double t, const std::array<double, 2> &y, std::array<double, 2> &f) {
+				f[0] = -rate * y[0];
+				f[1] = rate * y[0] - y[1];
+				return 0;
+			};
+			std::array<double, 2> y_scalar {double(lane + 1), lane < 2 ? 0. : 1.};
+			auto solver = make_cash_karp_ode_solver<2>(functor, 1e-6);
+			solver.evolve(y_scalar, 2);
+
+			TS_ASSERT_EQUALS(solver.num_evaluations(), batch_solver.num_evaluations(lane));
+			TS_ASSERT_EQUALS(solver.num_rejected_steps(), batch_solver.num_rejected_steps(lane));
+			TS_ASSERT_DELTA(y_scalar[0], y[0][lane], std::abs(y_scalar[0]) * 1e-14);
+			TS_ASSERT_DELTA(y_scalar[1], y[1][lane], std::abs(y_scalar[1]) * 1e-14);
+		}
+	}
+
+	void test_rejected_steps()
+	{
+		// The first step spans the whole integration, which is far too big
+		std::array<double, 2> y {1, 0};
+		auto solver = make_cash_karp_ode_solver<2>(decay_chain_functor(), 1e-6);
+		solver.evolve(y, 3);
+		TS_ASSERT_LESS_THAN(std::size_t(0), solver.num_rejected_steps());
+
+		// Counts are reset on each evolution
+		auto rejected_steps = solver.num_rejected_steps();
+		y = {1, 0};
+		solver.evolve(y, 3);
+		TS_ASSERT_EQUALS(rejected_steps, solver.num_rejected_steps());
+	}
+
+	void test_step_too_small()
+	{
+		// Integration stops with the values of the last step before the jump
+		std::array<double, 1> y {1};
+		auto solver = make_cash_karp_ode_solver<1>(jump_functor(), 1e-6);
+		solver.evolve(y, 1);
+		TS_ASSERT_EQUALS(1, y[0]);
+		TS_ASSERT_LESS_THAN(std::size_t(0), solver.num_evaluations());
+
+		// Only the lane with the jump stops early
+		std::array<std::array<double, 2>, 1> y_batch {{{1, 1}}};
+		auto batch_solver = make_batched_cash_karp_ode_solver<1, 2>(jump_batch_functor(), 1e-6);
+		batch_solver.evolve(y_batch, 2, 1);
+		TS_ASSERT_EQUALS(1, y_batch[0][0]);
+		TS_ASSERT_DELTA(y_batch[0][1], std::exp(-1.), std::exp(-1.) * 1e-5);
+		TS_ASSERT_EQUALS(solver.num_evaluations(), batch_solver.num_evaluations(0));
+		TS_ASSERT_EQUALS(solver.num_rejected_steps(), batch_solver.num_rejected_steps(0));
+	}
+
+	void test_evaluator_error()
+	{
+		std::array<double, 1> y {1};
+		auto solver = make_cash_karp_ode_solver<1>(failing_functor(), 0.05);
+		TS_ASSERT_THROWS(solver.evolve(y, 1), const math_error &);
+	}
+};
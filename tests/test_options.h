@@ -117,4 +117,17 @@ public:
 		_test_invalid_option_name("Group.snake_case");
 	}
 
+	void test_get_group()
+	{
+		Options opts;
+		opts.add("group.a = 1");
+		opts.add("group.b = 2");
+		opts.add("group_b.a = 3");
+		opts.add("groupc.a = 4");
+		opts.add("other.group = 5");
+		Options::options_t expected {{"group.a", "1"}, {"group.b", "2"}};
+		TS_ASSERT_EQUALS(expected, opts.get_group("group"));
+		TS_ASSERT(opts.get_group("missing").empty());
+	}
+
 };
\ No newline at end of file
@@ -0,0 +1,108 @@
+//
+// Philox random engine unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <array>
+#include <cstdint>
+#include <random>
+
+#include <cxxtest/TestSuite.h>
+
+#include "philox_engine.h"
+
+using namespace shark;
+
+class TestPhiloxEngine : public CxxTest::TestSuite
+{
+
+private:
+
+	void assert_known_answer(std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key, std::array<std::uint32_t, 4> expected)
+	{
+		auto result = philox4x32_10(counter, key);
+		for (int i = 0; i != 4; i++) {
+			TS_ASSERT_EQUALS(expected[i], result[i]);
+		}
+	}
+
+public:
+
+	void test_known_answers()
+	{
+		// Taken from the Random123 known-answer tests
+		assert_known_answer({{0, 0, 0, 0}}, {{0, 0}},
+		                    {{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}});
+		assert_known_answer({{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}}, {{0xffffffff, 0xffffffff}},
+		                    {{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}});
+		assert_known_answer({{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}}, {{0xa4093822, 0x299f31d0}},
+		                    {{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}});
+	}
+
+	void test_same_stream_same_numbers()
+	{
+		philox_engine g1(123, HALO_LAMBDA, 1000000000001, 4);
+		philox_engine g2(123, HALO_LAMBDA, 1000000000001, 4);
+		for (int i = 0; i != 100; i++) {
+			TS_ASSERT_EQUALS(g1(), g2());
+		}
+	}
+
+	void test_different_streams_different_numbers()
+	{
+		philox_engine reference(123, HALO_LAMBDA, 1, 0);
+		std::array<philox_engine, 5> others {{
+			{124, HALO_LAMBDA, 1, 0},
+			{123, GALAXY_ORBITS, 1, 0},
+			{123, HALO_LAMBDA, 2, 0},
+			{123, HALO_LAMBDA, std::uint64_t(1) << 32 | 1, 0},
+			{123, HALO_LAMBDA, 1, 1}
+		}};
+		auto first = reference();
+		for (auto &other: others) {
+			TS_ASSERT_DIFFERS(first, other());
+		}
+	}
+
+	void test_discard()
+	{
+		philox_engine g1(1, MERGING_TIMESCALE, 2, 3);
+		philox_engine g2(1, MERGING_TIMESCALE, 2, 3);
+		for (int i = 0; i != 7; i++) {
+			g1();
+		}
+		g2.discard(7);
+		TS_ASSERT_EQUALS(g1(), g2());
+	}
+
+	void test_std_distribution()
+	{
+		philox_engine generator(1, GALAXY_ORBITS, 2);
+		std::uniform_real_distribution<double> distribution(0, 1);
+		double sum = 0;
+		const int n = 100000;
+		for (int i = 0; i != n; i++) {
+			auto x = distribution(generator);
+			TS_ASSERT(x >= 0 && x < 1);
+			sum += x;
+		}
+		TS_ASSERT_DELTA(0.5, sum / n, 0.01);
+	}
+
+};
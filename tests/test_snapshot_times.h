@@ -0,0 +1,107 @@
+//
+// Snapshot times unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <cxxtest/TestSuite.h>
+
+#include "cosmology.h"
+#include "exceptions.h"
+#include "options.h"
+#include "simulation.h"
+
+using namespace shark;
+
+class TestSnapshotTimes : public CxxTest::TestSuite
+{
+
+private:
+
+	const std::string redshift_file {"test_snapshot_times_redshifts.txt"};
+
+	SimulationParameters make_sim_params(const std::string &redshifts)
+	{
+		std::ofstream f(redshift_file);
+		f << redshifts;
+		f.close();
+
+		Options opts {};
+		opts.add("simulation.volume = 1");
+		opts.add("simulation.lbox = 1");
+		opts.add("simulation.tot_n_subvolumes = 1");
+		opts.add("simulation.min_snapshot = 10");
+		opts.add("simulation.max_snapshot = 12");
+		opts.add("simulation.tree_files_prefix = tree.");
+		opts.add("simulation.redshift_file = " + redshift_file);
+		SimulationParameters sim_params {opts};
+		std::remove(redshift_file.c_str());
+		return sim_params;
+	}
+
+	Cosmology make_cosmology()
+	{
+		Options opts {};
+		opts.add("cosmology.omega_m = 0.3121");
+		opts.add("cosmology.omega_b = 0.0491");
+		opts.add("cosmology.omega_l = 0.6879");
+		opts.add("cosmology.n_s = 0.9653");
+		opts.add("cosmology.sigma8 = 0.8150");
+		opts.add("cosmology.hubble_h = 0.6751");
+		return Cosmology {CosmologicalParameters {opts}};
+	}
+
+public:
+
+	void test_table()
+	{
+		auto cosmology = make_cosmology();
+		SnapshotTimes times {make_sim_params("10 3.0\n11 2.0\n12 1.0\n13 0.5\n"), cosmology};
+
+		double redshifts[] = {3.0, 2.0, 1.0, 0.5};
+		for (int snapshot = 10; snapshot != 14; snapshot++) {
+			double z = redshifts[snapshot - 10];
+			TS_ASSERT_EQUALS(times.redshift(snapshot), z);
+			TS_ASSERT_EQUALS(times.age(snapshot), cosmology.convert_redshift_to_age(z));
+			TS_ASSERT_EQUALS(times.expansion_factor(snapshot), 1 / (1 + z));
+			TS_ASSERT_EQUALS(times.hubble_parameter(snapshot), cosmology.hubble_parameter(z));
+		}
+		TS_ASSERT_EQUALS(times.delta_t(11), times.age(12) - times.age(11));
+		TS_ASSERT_LESS_THAN(0, times.delta_t(11));
+
+		// Snapshots after the last one are at the present
+		TS_ASSERT_EQUALS(times.present_age(), cosmology.convert_redshift_to_age(0));
+		TS_ASSERT_EQUALS(times.redshift(14), 0);
+		TS_ASSERT_EQUALS(times.age(20), times.present_age());
+		TS_ASSERT_EQUALS(times.delta_t(13), times.present_age() - times.age(13));
+
+		TS_ASSERT_THROWS(times.age(9), const invalid_argument &);
+	}
+
+	void test_missing_snapshot()
+	{
+		auto cosmology = make_cosmology();
+		auto sim_params = make_sim_params("10 3.0\n11 2.0\n13 0.5\n");
+		TS_ASSERT_THROWS(SnapshotTimes(sim_params, cosmology), const invalid_data &);
+	}
+
+};
@@ -0,0 +1,144 @@
+//
+// Star formation kernel table unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cmath>
+
+#include <cxxtest/TestSuite.h>
+
+#include "star_formation_kernel_table.h"
+
+using namespace shark;
+
+class TestStarFormationKernelTable : public CxxTest::TestSuite
+{
+
+private:
+
+	using table_t = StarFormationKernelTable;
+	using axis = table_t::axis;
+
+	// Kernels whose logarithm is linear, and therefore exactly interpolated
+	static bool log_linear_kernels(const table_t::point &x, table_t::kernels &values)
+	{
+		values[0] = std::exp(x[0] + 2 * x[1] - x[2]);
+		values[1] = std::exp(3 * x[0]);
+		return true;
+	}
+
+	// Kernels whose logarithm curves in opposite directions along the first two
+	// axes, so that the interpolation errors cancel out at the centre of cells
+	// with equal steps, but not along their edges
+	static bool saddle_kernels(const table_t::point &x, table_t::kernels &values)
+	{
+		values[0] = values[1] = std::exp(x[0] * x[0] - x[1] * x[1]);
+		return true;
+	}
+
+public:
+
+	void test_exact_interpolation()
+	{
+		table_t table({{axis {0, 1, 11}, axis {-1, 1, 5}, axis {2, 3, 3}}}, log_linear_kernels, 1e-6);
+		TS_ASSERT_EQUALS(10 * 4 * 2, table.cell_count());
+		TS_ASSERT_EQUALS(table.cell_count(), table.accurate_cell_count());
+
+		for (auto x: {table_t::point {0, -1, 2}, table_t::point {0.33, 0.1, 2.7}, table_t::point {1, 1, 3}}) {
+			table_t::kernels values, expected;
+			log_linear_kernels(x, expected);
+			TS_ASSERT(table.lookup(x, values));
+			TS_ASSERT_DELTA(expected[0], values[0], expected[0] * 1e-12);
+			TS_ASSERT_DELTA(expected[1], values[1], expected[1] * 1e-12);
+		}
+
+		table_t::kernels values;
+		TS_ASSERT(!table.lookup({-0.1, 0, 2.5}, values));
+		TS_ASSERT(!table.lookup({0.5, 1.1, 2.5}, values));
+		TS_ASSERT(!table.lookup({0.5, 0, NAN}, values));
+	}
+
+	void test_single_node_axis()
+	{
+		table_t table({{axis {0, 1, 11}, axis {-1, 1, 5}, axis {0, 0, 1}}}, log_linear_kernels, 1e-6);
+		TS_ASSERT_EQUALS(10 * 4, table.cell_count());
+
+		// The value on the last axis is ignored
+		table_t::kernels values, expected;
+		log_linear_kernels({0.5, 0.5, 0}, expected);
+		TS_ASSERT(table.lookup({0.5, 0.5, 100}, values));
+		TS_ASSERT_DELTA(expected[0], values[0], expected[0] * 1e-12);
+	}
+
+	void test_inaccurate_cells()
+	{
+		// Non-linear in log space, so only fine enough tables are accurate
+		auto kernels = [](const table_t::point &x, table_t::kernels &values) {
+			values[0] = values[1] = std::exp(x[0] * x[0]);
+			return true;
+		};
+		table_t coarse({{axis {0, 10, 3}, axis {0, 0, 1}, axis {0, 0, 1}}}, kernels, 0.01);
+		TS_ASSERT_EQUALS(0, coarse.accurate_cell_count());
+		table_t::kernels values;
+		TS_ASSERT(!coarse.lookup({5, 0, 0}, values));
+
+		table_t fine({{axis {0, 1, 101}, axis {0, 0, 1}, axis {0, 0, 1}}}, kernels, 0.01);
+		TS_ASSERT_EQUALS(fine.cell_count(), fine.accurate_cell_count());
+		TS_ASSERT(fine.lookup({0.5, 0, 0}, values));
+		TS_ASSERT_DELTA(std::exp(0.25), values[0], std::exp(0.25) * 0.01);
+	}
+
+	void test_edge_errors()
+	{
+		// Errors of 1/16 in log space at the middle of every edge
+		table_t coarse({{axis {0, 2, 5}, axis {0, 2, 5}, axis {0, 0, 1}}}, saddle_kernels, 0.01);
+		TS_ASSERT_EQUALS(0, coarse.accurate_cell_count());
+
+		// Errors of 1/1600, which are fine; lookups halfway between nodes,
+		// where they are the largest, agree with the exact kernels
+		const double accuracy = 0.01;
+		table_t fine({{axis {0, 2, 41}, axis {0, 2, 41}, axis {0, 0, 1}}}, saddle_kernels, accuracy);
+		TS_ASSERT_EQUALS(fine.cell_count(), fine.accurate_cell_count());
+		for (int i = 0; i != 81; i++) {
+			for (int j = 0; j != 81; j++) {
+				table_t::point x {i * 0.025, j * 0.025, 0};
+				table_t::kernels values, expected;
+				saddle_kernels(x, expected);
+				TS_ASSERT(fine.lookup(x, values));
+				TS_ASSERT_DELTA(expected[0], values[0], expected[0] * accuracy);
+				TS_ASSERT_DELTA(expected[1], values[1], expected[1] * accuracy);
+			}
+		}
+	}
+
+	void test_failed_evaluations()
+	{
+		// Nodes with x[0] == 0.5 cannot be evaluated
+		auto kernels = [](const table_t::point &x, table_t::kernels &values) {
+			return std::abs(x[0] - 0.5) > 1e-9 && log_linear_kernels(x, values);
+		};
+		table_t table({{axis {0, 1, 11}, axis {0, 0, 1}, axis {0, 0, 1}}}, kernels, 1e-6);
+		TS_ASSERT_EQUALS(8, table.accurate_cell_count());
+
+		table_t::kernels values;
+		TS_ASSERT(!table.lookup({0.45, 0, 0}, values));
+		TS_ASSERT(!table.lookup({0.55, 0, 0}, values));
+		TS_ASSERT(table.lookup({0.35, 0, 0}, values));
+	}
+};
@@ -0,0 +1,124 @@
+//
+// Tracer unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <cxxtest/TestSuite.h>
+
+#include "exceptions.h"
+#include "tracer.h"
+
+using namespace shark;
+
+class TestTracer : public CxxTest::TestSuite
+{
+
+private:
+
+	std::string write_and_read(const Tracer &tracer)
+	{
+		std::string filename = "test_tracer.json";
+		tracer.write(filename);
+		std::ifstream f(filename);
+		std::ostringstream os;
+		os << f.rdbuf();
+		std::remove(filename.c_str());
+		return os.str();
+	}
+
+	std::size_t count(const std::string &s, const std::string &what)
+	{
+		std::size_t n = 0;
+		for (auto pos = s.find(what); pos != std::string::npos; pos = s.find(what, pos + 1)) {
+			n++;
+		}
+		return n;
+	}
+
+public:
+
+	void test_events()
+	{
+		Tracer tracer(2, 10);
+		Timer t;
+		tracer.record(0, "tree", t, 7);
+		tracer.record(1, "galaxy evolution", t);
+		tracer.record(tracer.writer_lane(), "writing job", t);
+
+		auto trace = write_and_read(tracer);
+		TS_ASSERT_EQUALS(trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["), 0);
+		TS_ASSERT_EQUALS(count(trace, "\"ph\":\"X\""), 3);
+		TS_ASSERT_EQUALS(count(trace, "\"ph\":\"M\""), 4);
+		TS_ASSERT_DIFFERS(trace.find("\"name\":\"tree\",\"ph\":\"X\",\"pid\":0,\"tid\":0,"), std::string::npos);
+		TS_ASSERT_DIFFERS(trace.find("\"args\":{\"arg\":7}"), std::string::npos);
+		TS_ASSERT_DIFFERS(trace.find("\"name\":\"galaxy evolution\",\"ph\":\"X\",\"pid\":0,\"tid\":1,"), std::string::npos);
+		TS_ASSERT_DIFFERS(trace.find("\"args\":{\"name\":\"output writer\"}"), std::string::npos);
+		TS_ASSERT_EQUALS(count(trace, "\"args\":{\"arg\""), 1);
+	}
+
+	void test_ring_buffer()
+	{
+		Tracer tracer(1, 3);
+		Timer t;
+		for (int i = 0; i != 5; i++) {
+			tracer.record(0, "halo", t, i);
+		}
+
+		// Only the last three events are kept, oldest first
+		auto trace = write_and_read(tracer);
+		TS_ASSERT_EQUALS(count(trace, "\"name\":\"halo\""), 3);
+		TS_ASSERT_EQUALS(trace.find("\"arg\":0}"), std::string::npos);
+		TS_ASSERT_EQUALS(trace.find("\"arg\":1}"), std::string::npos);
+		auto pos2 = trace.find("\"arg\":2}");
+		auto pos3 = trace.find("\"arg\":3}");
+		auto pos4 = trace.find("\"arg\":4}");
+		TS_ASSERT_DIFFERS(pos2, std::string::npos);
+		TS_ASSERT_LESS_THAN(pos2, pos3);
+		TS_ASSERT_LESS_THAN(pos3, pos4);
+		TS_ASSERT_DIFFERS(pos4, std::string::npos);
+	}
+
+	void test_partially_filled_buffer()
+	{
+		// Buffers grow as needed, and keep events in order until full
+		Tracer tracer(1, 1000000);
+		Timer t;
+		for (int i = 0; i != 3; i++) {
+			tracer.record(0, "halo", t, i);
+		}
+
+		auto trace = write_and_read(tracer);
+		TS_ASSERT_EQUALS(count(trace, "\"name\":\"halo\""), 3);
+		auto pos0 = trace.find("\"arg\":0}");
+		TS_ASSERT_DIFFERS(pos0, std::string::npos);
+		TS_ASSERT_LESS_THAN(pos0, trace.find("\"arg\":1}"));
+		TS_ASSERT_LESS_THAN(trace.find("\"arg\":1}"), trace.find("\"arg\":2}"));
+	}
+
+	void test_invalid_buffer_size()
+	{
+		TS_ASSERT_THROWS(Tracer(1, 0), const invalid_argument &);
+	}
+
+};
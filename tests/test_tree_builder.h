@@ -0,0 +1,364 @@
+//
+// Tree builder unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2018
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <cxxtest/TestSuite.h>
+
+#include "components.h"
+#include "cosmology.h"
+#include "exceptions.h"
+#include "execution.h"
+#include "gas_cooling.h"
+#include "options.h"
+#include "simulation.h"
+#include "tree_builder.h"
+
+using namespace shark;
+
+class TestTreeBuilder : public CxxTest::TestSuite
+{
+
+private:
+
+	/// Exposes the linking step of HaloBasedTreeBuilder
+	class linking_tree_builder : public HaloBasedTreeBuilder {
+	public:
+		using HaloBasedTreeBuilder::HaloBasedTreeBuilder;
+		using HaloBasedTreeBuilder::loop_through_halos;
+		using HaloBasedTreeBuilder::link;
+		using HaloBasedTreeBuilder::define_accretion_rate_from_dm;
+		using HaloBasedTreeBuilder::define_ages_halos;
+	};
+
+	static constexpr int MAX_SNAPSHOT = 30;
+
+	ExecutionParameters make_exec_params(bool skip_missing_descendants)
+	{
+		Options opts {};
+		opts.add("execution.output_format = hdf5");
+		opts.add("execution.output_directory = .");
+		opts.add("execution.simulation_batches = 0");
+		opts.add("execution.ode_solver_precision = 0.5");
+		opts.add("execution.name_model = test");
+		opts.add("execution.output_snapshots = 2");
+		opts.add(std::string("execution.skip_missing_descendants = ") + (skip_missing_descendants ? "true" : "false"));
+		opts.add("execution.warn_on_missing_descendants = false");
+		return ExecutionParameters {opts};
+	}
+
+	HaloPtr make_halo(std::vector<HaloPtr> &halos, Halo::id_t id, int snapshot)
+	{
+		auto halo = std::make_shared<Halo>(id, snapshot);
+		halos.push_back(halo);
+		return halo;
+	}
+
+	SubhaloPtr make_subhalo(const HaloPtr &halo, Subhalo::id_t id, float mass, Halo::id_t descendant_halo_id = -1, Subhalo::id_t descendant_id = -1)
+	{
+		auto subhalo = std::make_shared<Subhalo>(id, halo->snapshot);
+		subhalo->Mvir = mass;
+		subhalo->subhalo_type = halo->subhalo_count() == 0 ? Subhalo::CENTRAL : Subhalo::SATELLITE;
+		subhalo->has_descendant = descendant_halo_id != -1;
+		subhalo->descendant_halo_id = descendant_halo_id;
+		subhalo->descendant_id = descendant_id;
+		halo->add_subhalo(SubhaloPtr(subhalo));
+		return subhalo;
+	}
+
+	SimulationParameters make_sim_params()
+	{
+		std::string redshift_file {"test_tree_builder_redshifts.txt"};
+		std::ofstream f(redshift_file);
+		for (int snapshot = 0; snapshot <= MAX_SNAPSHOT; snapshot++) {
+			f << snapshot << " " << MAX_SNAPSHOT - snapshot + 0.5 * (snapshot % 3) << "\n";
+		}
+		f.close();
+
+		Options opts {};
+		opts.add("simulation.volume = 1");
+		opts.add("simulation.lbox = 1");
+		opts.add("simulation.tot_n_subvolumes = 1");
+		opts.add("simulation.min_snapshot = 0");
+		opts.add("simulation.max_snapshot = " + std::to_string(MAX_SNAPSHOT));
+		opts.add("simulation.tree_files_prefix = tree.");
+		opts.add("simulation.redshift_file = " + redshift_file);
+		SimulationParameters sim_params {opts};
+		std::remove(redshift_file.c_str());
+		return sim_params;
+	}
+
+	Cosmology make_cosmology()
+	{
+		Options opts {};
+		opts.add("cosmology.omega_m = 0.3121");
+		opts.add("cosmology.omega_b = 0.0491");
+		opts.add("cosmology.omega_l = 0.6879");
+		opts.add("cosmology.n_s = 0.9653");
+		opts.add("cosmology.sigma8 = 0.8150");
+		opts.add("cosmology.hubble_h = 0.6751");
+		return Cosmology {CosmologicalParameters {opts}};
+	}
+
+	// Random trees spanning snapshots [0, MAX_SNAPSHOT], whose halos have
+	// between one and three subhalos, and between zero and two progenitors.
+	// Subhalos are randomly linked to the subhalos of the descendant halo,
+	// and only some of them are main progenitors.
+	std::vector<MergerTreePtr> make_random_trees(linking_tree_builder &builder, std::mt19937 &rng, int n_trees)
+	{
+		std::vector<MergerTreePtr> trees;
+		Halo::id_t halo_id = 0;
+		Subhalo::id_t subhalo_id = 0;
+		for (int tree_id = 0; tree_id != n_trees; tree_id++) {
+			auto tree = std::make_shared<MergerTree>(tree_id);
+			trees.push_back(tree);
+
+			auto make_halo = [&](int snapshot) {
+				auto halo = std::make_shared<Halo>(halo_id++, snapshot);
+				auto n_subhalos = 1 + rng() % 3;
+				for (unsigned int i = 0; i != n_subhalos; i++) {
+					auto subhalo = std::make_shared<Subhalo>(subhalo_id++, snapshot);
+					subhalo->subhalo_type = i == 0 ? Subhalo::CENTRAL : Subhalo::SATELLITE;
+					subhalo->Mvir = (rng() % 1000) / 10.f;
+					subhalo->host_halo = halo;
+					halo->add_subhalo(std::move(subhalo));
+				}
+				halo->Mvir = (rng() % 1000) / 10.f;
+				halo->merger_tree = tree;
+				tree->add_halo(halo);
+				return halo;
+			};
+
+			std::vector<HaloPtr> descendants {make_halo(MAX_SNAPSHOT)};
+			for (int snapshot = MAX_SNAPSHOT - 1; snapshot >= 0; snapshot--) {
+				std::vector<HaloPtr> progenitors;
+				for (auto &descendant: descendants) {
+					auto n_progenitors = descendants.size() > 200 ? rng() % 2 : (rng() % 5 == 0 ? 0 : 1 + rng() % 2);
+					for (unsigned int i = 0; i != n_progenitors; i++) {
+						auto halo = make_halo(snapshot);
+						auto &descendant_subhalos = descendant->all_subhalos();
+						for (auto &subhalo: halo->all_subhalos()) {
+							auto &descendant_subhalo = descendant_subhalos[rng() % descendant_subhalos.size()];
+							subhalo->main_progenitor = (rng() % 4 != 0);
+							builder.link(subhalo, descendant_subhalo, halo, descendant);
+						}
+						progenitors.push_back(halo);
+					}
+				}
+				descendants = std::move(progenitors);
+			}
+			tree->index_halos();
+		}
+		return trees;
+	}
+
+	void release(std::vector<MergerTreePtr> &trees)
+	{
+		for (auto &tree: trees) {
+			tree->release();
+		}
+	}
+
+	void _test_linking(unsigned int threads)
+	{
+		std::vector<HaloPtr> halos;
+		auto root = make_halo(halos, 200, 2);
+		auto s20 = make_subhalo(root, 20, 10);
+		auto s21 = make_subhalo(root, 21, 5);
+		auto tree = std::make_shared<MergerTree>(0);
+		root->merger_tree = tree;
+		tree->add_halo(root);
+
+		// Two halos merging into the root, one pointing to a missing halo,
+		// and one pointing to an existing halo but a missing subhalo
+		auto h100 = make_halo(halos, 100, 1);
+		auto s10 = make_subhalo(h100, 10, 8, 200, 20);
+		auto s11 = make_subhalo(h100, 11, 4, 200, 21);
+		auto s14 = make_subhalo(h100, 14, 1);
+		auto h101 = make_halo(halos, 101, 1);
+		auto s12 = make_subhalo(h101, 12, 2, 200, 20);
+		auto h102 = make_halo(halos, 102, 1);
+		make_subhalo(h102, 13, 1, 999, 99);
+		auto h103 = make_halo(halos, 103, 1);
+		make_subhalo(h103, 15, 1, 200, 99);
+
+		// Progenitors of linked and ignored halos
+		auto h50 = make_halo(halos, 50, 0);
+		auto s5 = make_subhalo(h50, 5, 3, 100, 10);
+		auto h51 = make_halo(halos, 51, 0);
+		make_subhalo(h51, 6, 1, 102, 13);
+
+		linking_tree_builder builder(make_exec_params(true), threads);
+		builder.loop_through_halos(halos);
+
+		TS_ASSERT(s10->descendant == s20);
+		TS_ASSERT(s11->descendant == s21);
+		TS_ASSERT(s12->descendant == s20);
+		TS_ASSERT(s5->descendant == s10);
+		std::vector<SubhaloPtr> expected_ascendants {s10, s12};
+		TS_ASSERT(s20->ascendants == expected_ascendants);
+		TS_ASSERT(h100->descendant == root);
+		TS_ASSERT(h101->descendant == root);
+		TS_ASSERT(h50->descendant == h100);
+
+		// Subhalos without descendants are removed
+		TS_ASSERT_EQUALS(h100->subhalo_count(), 2);
+		TS_ASSERT(!s14->descendant);
+
+		// Ignored halos, and their progenitors, are not part of the tree
+		for (auto &halo: {h102, h103, h51}) {
+			TS_ASSERT(!halo->descendant);
+			TS_ASSERT(!halo->merger_tree);
+		}
+		tree->index_halos();
+		TS_ASSERT_EQUALS(tree->halos_at(1).size(), 2);
+		TS_ASSERT_EQUALS(tree->halos_at(0).size(), 1);
+		tree->release();
+	}
+
+public:
+
+	void test_linking()
+	{
+		_test_linking(1);
+	}
+
+	void test_parallel_linking()
+	{
+		_test_linking(4);
+	}
+
+	void test_missing_descendant_subhalo()
+	{
+		std::vector<HaloPtr> halos;
+		auto root = make_halo(halos, 200, 2);
+		make_subhalo(root, 20, 10);
+		root->merger_tree = std::make_shared<MergerTree>(0);
+		auto halo = make_halo(halos, 100, 1);
+		make_subhalo(halo, 10, 8, 200, 21);
+
+		linking_tree_builder builder(make_exec_params(false), 2);
+		TS_ASSERT_THROWS(builder.loop_through_halos(halos), const subhalo_not_found &);
+	}
+
+	void test_accretion_rate_independent_of_threads()
+	{
+		auto sim_params = make_sim_params();
+		auto cosmology = make_cosmology();
+		Options opts {};
+		opts.add("gas_cooling.model = croton06");
+		opts.add("gas_cooling.lambdamodel = cloudy");
+		GasCoolingParameters gas_cooling_params {opts};
+
+		std::vector<std::map<int, double>> totals;
+		for (unsigned int threads: {1, 3, 8}) {
+			std::mt19937 rng(7);
+			linking_tree_builder builder(make_exec_params(true), threads);
+			auto trees = make_random_trees(builder, rng, 40);
+			TotalBaryon all_baryons;
+			builder.define_accretion_rate_from_dm(trees, sim_params, gas_cooling_params, cosmology, all_baryons);
+			totals.push_back(all_baryons.baryon_total_created);
+			release(trees);
+		}
+
+		TS_ASSERT_EQUALS(totals[0].size(), std::size_t(MAX_SNAPSHOT + 1));
+		TS_ASSERT(totals[0] == totals[1]);
+		TS_ASSERT(totals[0] == totals[2]);
+		TS_ASSERT_LESS_THAN(0, totals[0].rbegin()->second);
+	}
+
+
+	void test_ages_and_infall_times()
+	{
+		auto sim_params = make_sim_params();
+		auto redshift = [&sim_params](int snapshot) {
+			auto it = sim_params.redshifts.find(snapshot);
+			return it == sim_params.redshifts.end() ? 0. : it->second;
+		};
+
+		std::mt19937 rng(3);
+		for (int i = 0; i != 10; i++) {
+
+			linking_tree_builder builder(make_exec_params(true), 4);
+			auto trees = make_random_trees(builder, rng, 5);
+
+			// Expected values walk the main progenitors of each halo and
+			// satellite subhalo individually
+			std::map<HaloPtr, std::pair<float, float>> expected_ages;
+			std::map<SubhaloPtr, float> expected_infall_times;
+			for (auto &tree: trees) {
+				for (auto &halo: tree->all_halos()) {
+					float age_50 = 0, age_80 = 0;
+					auto snapshot = halo->snapshot - 1;
+					for (auto progenitor = halo->main_progenitor(); progenitor && (age_50 == 0 || age_80 == 0); progenitor = progenitor->main_progenitor(), snapshot--) {
+						if (progenitor->Mvir <= 0.8 * halo->Mvir && age_80 == 0) {
+							age_80 = redshift(snapshot);
+						}
+						if (progenitor->Mvir <= 0.5 * halo->Mvir && age_50 == 0) {
+							age_50 = redshift(snapshot);
+						}
+					}
+					expected_ages[halo] = {age_50, age_80};
+
+					for (auto &subhalo: halo->satellite_subhalos) {
+						float infall_t = 0;
+						auto snapshot = halo->snapshot - 1;
+						for (auto main = subhalo->main(); main && infall_t == 0; main = main->main(), snapshot--) {
+							if (main->subhalo_type == Subhalo::CENTRAL) {
+								infall_t = redshift(snapshot);
+							}
+						}
+						expected_infall_times[subhalo] = infall_t;
+					}
+				}
+			}
+
+			builder.define_ages_halos(trees, sim_params);
+
+			// Make sure the random trees actually exercise both calculations
+			auto nonzero = [](float value) { return value != 0; };
+			TS_ASSERT(std::any_of(expected_ages.begin(), expected_ages.end(), [&](const std::pair<const HaloPtr, std::pair<float, float>> &entry) {
+				return nonzero(entry.second.first) && nonzero(entry.second.second);
+			}));
+			TS_ASSERT(std::any_of(expected_infall_times.begin(), expected_infall_times.end(), [&](const std::pair<const SubhaloPtr, float> &entry) {
+				return nonzero(entry.second);
+			}));
+
+			for (auto &entry: expected_ages) {
+				auto &halo = entry.first;
+				TS_ASSERT_EQUALS(entry.second.first, halo->age_50);
+				TS_ASSERT_EQUALS(entry.second.second, halo->age_80);
+				TS_ASSERT_EQUALS(0, halo->central_subhalo->infall_t);
+			}
+			for (auto &entry: expected_infall_times) {
+				TS_ASSERT_EQUALS(entry.second, entry.first->infall_t);
+			}
+
+			release(trees);
+		}
+	}
+};
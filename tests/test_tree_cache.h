@@ -0,0 +1,163 @@
+//
+// Tree cache unit tests
+//
+// ICRAR - International Centre for Radio Astronomy Research
+// (c) UWA - The University of Western Australia, 2017
+// Copyright by UWA (in the framework of the ICRAR)
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdio>
+#include <fstream>
+
+#include <cxxtest/TestSuite.h>
+
+#include "components.h"
+#include "exceptions.h"
+#include "tree_cache.h"
+
+using namespace shark;
+
+class TestTreeCache : public CxxTest::TestSuite
+{
+
+private:
+
+	SubhaloPtr add_subhalo(const HaloPtr &halo, Subhalo::id_t id, Subhalo::subhalo_type_t subhalo_type, float mvir)
+	{
+		auto subhalo = std::make_shared<Subhalo>(id, halo->snapshot);
+		subhalo->subhalo_type = subhalo_type;
+		subhalo->Mvir = mvir;
+		subhalo->L = {1, 2, 3};
+		subhalo->accreted_mass = mvir / 10;
+		subhalo->host_halo = halo;
+		halo->add_subhalo(SubhaloPtr(subhalo));
+		return subhalo;
+	}
+
+	// A tree with a single halo at snapshot 1, whose central subhalo has two
+	// progenitors living in two different halos at snapshot 0
+	MergerTreePtr make_tree(TotalBaryon &AllBaryons)
+	{
+		auto tree = std::make_shared<MergerTree>(7);
+		auto halo = std::make_shared<Halo>(10, 1);
+		auto prog1 = std::make_shared<Halo>(5, 0);
+		auto prog2 = std::make_shared<Halo>(6, 0);
+
+		auto central = add_subhalo(halo, 100, Subhalo::CENTRAL, 3);
+		auto satellite = add_subhalo(halo, 101, Subhalo::SATELLITE, 0.5);
+		auto prog1_central = add_subhalo(prog1, 50, Subhalo::CENTRAL, 2);
+		auto prog2_central = add_subhalo(prog2, 60, Subhalo::CENTRAL, 1);
+		halo->age_50 = 0.5;
+		halo->central_subhalo->lambda = 0.03f;
+		satellite->infall_t = 1.5;
+		prog1_central->main_progenitor = true;
+		prog1_central->has_descendant = true;
+		prog1_central->descendant_id = 100;
+		prog1_central->descendant_halo_id = 10;
+
+		for (auto &prog: {prog1_central, prog2_central}) {
+			prog->descendant = central;
+			central->ascendants.push_back(prog);
+		}
+		for (auto &prog: {prog1, prog2}) {
+			prog->descendant = halo;
+			halo->ascendants.insert(prog);
+		}
+		for (auto &h: {prog1, prog2, halo}) {
+			h->merger_tree = tree;
+			tree->add_halo(h);
+		}
+
+		AllBaryons.baryon_total_created[0] = 0.3;
+		AllBaryons.baryon_total_created[1] = 0.4;
+		return tree;
+	}
+
+public:
+
+	void test_round_trip()
+	{
+		TotalBaryon baryons;
+		TreeCache cache(".", "round trip");
+		cache.save({make_tree(baryons)}, baryons);
+
+		TotalBaryon loaded_baryons;
+		auto trees = cache.load(loaded_baryons);
+		std::remove(cache.get_filename().c_str());
+
+		TS_ASSERT_EQUALS(trees.size(), 1);
+		auto &tree = trees[0];
+		TS_ASSERT_EQUALS(tree->id, 7);
+		TS_ASSERT_EQUALS(tree->halos_at(0).size(), 2);
+		TS_ASSERT_EQUALS(tree->halos_at(1).size(), 1);
+		TS_ASSERT_EQUALS(baryons.baryon_total_created, loaded_baryons.baryon_total_created);
+
+		auto halo = tree->halos_at(1)[0];
+		TS_ASSERT_EQUALS(halo->id, 10);
+		TS_ASSERT_EQUALS(halo->merger_tree, tree);
+		TS_ASSERT_EQUALS(halo->Mvir, 3.5);
+		TS_ASSERT_EQUALS(halo->age_50, 0.5);
+		TS_ASSERT_EQUALS(halo->ascendants.size(), 2);
+		TS_ASSERT(!halo->descendant);
+
+		auto central = halo->central_subhalo;
+		TS_ASSERT_EQUALS(central->id, 100);
+		TS_ASSERT_EQUALS(central->host_halo, halo);
+		TS_ASSERT_EQUALS(central->lambda, 0.03f);
+		TS_ASSERT_EQUALS(central->L.y, 2);
+		TS_ASSERT_EQUALS(central->accreted_mass, 0.3f);
+		TS_ASSERT_EQUALS(central->ascendants.size(), 2);
+		TS_ASSERT_EQUALS(halo->satellite_subhalos.size(), 1);
+		TS_ASSERT_EQUALS(halo->satellite_subhalos[0]->subhalo_type, Subhalo::SATELLITE);
+		TS_ASSERT_EQUALS(halo->satellite_subhalos[0]->infall_t, 1.5);
+
+		// Links are restored in both directions, and main() still works
+		auto main_prog = central->main();
+		TS_ASSERT(main_prog);
+		TS_ASSERT_EQUALS(main_prog->id, 50);
+		TS_ASSERT_EQUALS(main_prog->descendant, central);
+		TS_ASSERT_EQUALS(main_prog->descendant_halo_id, 10);
+		TS_ASSERT_EQUALS(main_prog->host_halo->descendant, halo);
+		TS_ASSERT_EQUALS(halo->main_progenitor(), main_prog->host_halo);
+	}
+
+	void test_different_key()
+	{
+		TotalBaryon baryons;
+		TreeCache cache(".", "some inputs");
+		cache.save({make_tree(baryons)}, baryons);
+
+		TotalBaryon loaded_baryons;
+		TreeCache other_cache(".", "some other inputs");
+		TS_ASSERT_DIFFERS(cache.get_filename(), other_cache.get_filename());
+		TS_ASSERT(other_cache.load(loaded_baryons).empty());
+		TS_ASSERT(loaded_baryons.baryon_total_created.empty());
+		std::remove(cache.get_filename().c_str());
+	}
+
+	void test_truncated_file()
+	{
+		TreeCache cache(".", "truncated");
+		{
+			std::ofstream f(cache.get_filename(), std::ios::binary);
+			f << "SHA";
+		}
+		TotalBaryon baryons;
+		TS_ASSERT_THROWS(cache.load(baryons), invalid_data);
+		std::remove(cache.get_filename().c_str());
+	}
+
+};